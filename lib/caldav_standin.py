@@ -0,0 +1,168 @@
+#!/usr/bin/env python3
+"""Stand-in CalDAV server for trying caldav:// feeds against.
+
+Serves every .ics file in a directory as one calendar collection and
+answers RFC 6578 sync-collection REPORTs. Tokens count changes to the
+directory, so editing, adding or removing a file between syncs shows up
+as a changed or deleted resource on the next one.
+
+    lib/caldav_standin.py --dir some/ics/files --port 8080
+
+and set the feed url to caldav://<host>:8080/cal/
+
+--page-size N truncates sync responses (507) to exercise paging, and
+--forget makes the server reject tokens older than the newest one.
+"""
+
+import argparse
+import hashlib
+import os
+import re
+import threading
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from xml.sax.saxutils import escape
+
+TOKEN_PREFIX = "http://caldav-standin/sync/"
+
+
+class Collection:
+    def __init__(self, directory):
+        self.directory = directory
+        self.lock = threading.Lock()
+        self.generation = 0
+        self.files = {}    # name -> digest
+        self.changed = {}  # name -> generation it last changed (or vanished)
+        self.scan()
+
+    def scan(self):
+        with self.lock:
+            current = {}
+            for name in sorted(os.listdir(self.directory)):
+                if name.endswith(".ics"):
+                    with open(os.path.join(self.directory, name), "rb") as f:
+                        current[name] = hashlib.sha1(f.read()).hexdigest()
+            touched = [n for n in current if self.files.get(n) != current[n]]
+            touched += [n for n in self.files if n not in current]
+            if touched:
+                self.generation += 1
+                for name in touched:
+                    self.changed[name] = self.generation
+            self.files = current
+            return self.generation
+
+    def since(self, generation):
+        with self.lock:
+            # from nothing, things deleted before now were never seen
+            names = [n for n, g in self.changed.items()
+                     if g > generation and (generation or n in self.files)]
+            return sorted(names, key=lambda n: (self.changed[n], n))
+
+
+class Handler(BaseHTTPRequestHandler):
+    # HTTP/1.0, like the clock asks for: no chunking, close when done
+    protocol_version = "HTTP/1.0"
+
+    def log_message(self, fmt, *args):
+        if not self.server.quiet:
+            super().log_message(fmt, *args)
+
+    def reply(self, code, body, content_type="application/xml; charset=utf-8"):
+        data = body.encode("utf-8")
+        self.send_response(code)
+        self.send_header("Content-Type", content_type)
+        self.send_header("Content-Length", str(len(data)))
+        self.end_headers()
+        self.wfile.write(data)
+
+    def do_GET(self):
+        name = os.path.basename(self.path)
+        path = os.path.join(self.server.collection.directory, name)
+        if not name.endswith(".ics") or not os.path.isfile(path):
+            self.reply(404, "not found", "text/plain")
+            return
+        with open(path, encoding="utf-8") as f:
+            self.reply(200, f.read(), "text/calendar")
+
+    def do_REPORT(self):
+        length = int(self.headers.get("Content-Length", 0))
+        request = self.rfile.read(length).decode("utf-8")
+        if "sync-collection" not in request:
+            self.reply(501, "only sync-collection is supported", "text/plain")
+            return
+        collection = self.server.collection
+        newest = collection.scan()
+
+        match = re.search(r"<(?:\w+:)?sync-token>([^<]*)</", request)
+        token = match.group(1).strip() if match else ""
+        if token:
+            if not token.startswith(TOKEN_PREFIX):
+                self.invalid_token()
+                return
+            generation = int(token[len(TOKEN_PREFIX):].split(".")[0])
+            if generation > newest or (self.server.forget and generation < newest):
+                self.invalid_token()
+                return
+            names = collection.since(generation)
+            # a token from a truncated page remembers how far it got
+            skip = int(token.split(".")[1]) if "." in token[len(TOKEN_PREFIX):] else 0
+        else:
+            generation = 0
+            names = collection.since(0)
+            skip = 0
+
+        names = names[skip:]
+        truncated = self.server.page_size and len(names) > self.server.page_size
+        if truncated:
+            names = names[:self.server.page_size]
+            next_token = "%s%d.%d" % (TOKEN_PREFIX, generation, skip + len(names))
+        else:
+            next_token = "%s%d" % (TOKEN_PREFIX, newest)
+
+        base = self.path if self.path.endswith("/") else self.path + "/"
+        out = ['<?xml version="1.0" encoding="utf-8"?>',
+               '<d:multistatus xmlns:d="DAV:" xmlns:c="urn:ietf:params:xml:ns:caldav">']
+        for name in names:
+            href = escape(base + name)
+            path = os.path.join(collection.directory, name)
+            if not os.path.isfile(path):
+                out.append("<d:response><d:href>%s</d:href>"
+                           "<d:status>HTTP/1.1 404 Not Found</d:status></d:response>" % href)
+                continue
+            with open(path, encoding="utf-8") as f:
+                data = f.read()
+            out.append("<d:response><d:href>%s</d:href><d:propstat><d:prop>"
+                       "<d:getetag>\"%s\"</d:getetag>"
+                       "<c:calendar-data>%s</c:calendar-data>"
+                       "</d:prop><d:status>HTTP/1.1 200 OK</d:status></d:propstat></d:response>"
+                       % (href, collection.files[name], escape(data)))
+        if truncated:
+            out.append("<d:response><d:href>%s</d:href>"
+                       "<d:status>HTTP/1.1 507 Insufficient Storage</d:status></d:response>" % escape(base))
+        out.append("<d:sync-token>%s</d:sync-token></d:multistatus>" % next_token)
+        self.reply(207, "\n".join(out))
+
+    def invalid_token(self):
+        self.reply(403, '<?xml version="1.0" encoding="utf-8"?>'
+                        '<d:error xmlns:d="DAV:"><d:valid-sync-token/></d:error>')
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--dir", required=True, help="directory of .ics files, one event each")
+    parser.add_argument("--port", type=int, default=8080)
+    parser.add_argument("--page-size", type=int, default=0)
+    parser.add_argument("--forget", action="store_true")
+    parser.add_argument("--quiet", action="store_true")
+    args = parser.parse_args()
+
+    server = ThreadingHTTPServer(("", args.port), Handler)
+    server.collection = Collection(args.dir)
+    server.page_size = args.page_size
+    server.forget = args.forget
+    server.quiet = args.quiet
+    print("serving %s on port %d" % (args.dir, args.port))
+    server.serve_forever()
+
+
+if __name__ == "__main__":
+    main()
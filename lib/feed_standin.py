@@ -0,0 +1,170 @@
+#!/usr/bin/env python3
+"""Records feed responses once, and replays them under network profiles.
+
+    lib/feed_standin.py record https://example.com/cal.ics recordings/work.rec
+    lib/feed_standin.py serve --dir recordings --port 8090
+
+A recording is one JSON line with the status and headers, then the body
+exactly as it came. Served at /<profile>/<name>, so /dsl/work replays
+recordings/work.rec over a DSL-like link, and the same recordings can be
+compared across profiles (see tools/feedreplay.cpp). Profiles:
+
+    lan      2 ms to first byte, unlimited
+    wifi     20 ms, 250 kB/s
+    dsl      60 ms, 100 kB/s
+    mobile   150 ms, 40 kB/s, 1400 byte writes
+    drip     300 ms, 4 kB/s, 64 byte writes
+    stall    like wifi, but stops for 5 s halfway
+
+If-None-Match and If-Modified-Since matching the recording get a 304. A
+request in HTTP/1.1 gets a chunked body, one chunk per write; the clock
+asks in HTTP/1.0 and gets it plain. Redirects replay as recorded. --cert
+and --key serve https.
+"""
+
+import argparse
+import json
+import os
+import ssl
+import time
+import urllib.parse
+import http.client
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+# name: (latency s, bytes/s or 0 for unlimited, write size, stall s)
+PROFILES = {
+    "lan": (0.002, 0, 16384, 0),
+    "wifi": (0.020, 250000, 4096, 0),
+    "dsl": (0.060, 100000, 4096, 0),
+    "mobile": (0.150, 40000, 1400, 0),
+    "drip": (0.300, 4000, 64, 0),
+    "stall": (0.020, 250000, 4096, 5),
+}
+
+# hop-by-hop, or redone on replay
+SKIP_HEADERS = {"connection", "transfer-encoding", "content-length", "keep-alive", "date"}
+
+
+def record(url, out):
+    # one request, no redirects followed, so a 3xx is kept as it was
+    parts = urllib.parse.urlsplit(url)
+    conn_class = http.client.HTTPSConnection if parts.scheme == "https" else http.client.HTTPConnection
+    conn = conn_class(parts.netloc, timeout=60)
+    path = parts.path or "/"
+    if parts.query:
+        path += "?" + parts.query
+    conn.request("GET", path, headers={"User-Agent": "ESP32HTTPClient"})
+    response = conn.getresponse()
+    body = response.read()
+    headers = [[k, v] for k, v in response.getheaders() if k.lower() not in SKIP_HEADERS]
+    with open(out, "wb") as f:
+        f.write(json.dumps({"url": url, "status": response.status, "headers": headers}).encode() + b"\n")
+        f.write(body)
+    print("%s: %d, %d bytes" % (out, response.status, len(body)))
+
+
+def load(path):
+    with open(path, "rb") as f:
+        head = json.loads(f.readline())
+        return head["status"], head["headers"], f.read()
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+
+    def log_message(self, fmt, *args):
+        if not self.server.quiet:
+            super().log_message(fmt, *args)
+
+    def do_GET(self):
+        parts = self.path.strip("/").split("/", 1)
+        path = os.path.join(self.server.dir, parts[-1] + ".rec") if len(parts) == 2 else ""
+        if parts[0] not in PROFILES or not os.path.isfile(path):
+            self.send_error(404)
+            return
+        latency, rate, write_size, stall = PROFILES[parts[0]]
+        status, headers, body = load(path)
+        time.sleep(latency)
+
+        recorded = {k.lower(): v for k, v in headers}
+        etag = recorded.get("etag")
+        modified = recorded.get("last-modified")
+        if status == 200 and ((etag and self.headers.get("If-None-Match") == etag) or
+                              (modified and self.headers.get("If-Modified-Since") == modified)):
+            self.send_response(304)
+            for k, v in headers:
+                if k.lower() in ("etag", "last-modified"):
+                    self.send_header(k, v)
+            self.send_header("Content-Length", "0")
+            self.end_headers()
+            return
+
+        chunked = self.request_version == "HTTP/1.1"
+        self.send_response(status)
+        for k, v in headers:
+            self.send_header(k, v)
+        if chunked:
+            self.send_header("Transfer-Encoding", "chunked")
+        else:
+            self.send_header("Content-Length", str(len(body)))
+            self.close_connection = True
+        self.end_headers()
+
+        sent = 0
+        started = time.monotonic()
+        stall_at = len(body) // 2 if stall else -1
+        while sent < len(body):
+            if 0 <= stall_at <= sent:
+                time.sleep(stall)
+                started += stall
+                stall_at = -1
+            end = sent + write_size
+            if stall_at > sent:
+                end = min(end, stall_at)
+            piece = body[sent:end]
+            if chunked:
+                self.wfile.write(b"%x\r\n%s\r\n" % (len(piece), piece))
+            else:
+                self.wfile.write(piece)
+            self.wfile.flush()
+            sent += len(piece)
+            if rate:
+                ahead = sent / rate - (time.monotonic() - started)
+                if ahead > 0:
+                    time.sleep(ahead)
+        if chunked:
+            self.wfile.write(b"0\r\n\r\n")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    sub = parser.add_subparsers(dest="command", required=True)
+    rec = sub.add_parser("record", help="save one response from a url")
+    rec.add_argument("url")
+    rec.add_argument("out")
+    serve = sub.add_parser("serve", help="replay a directory of recordings")
+    serve.add_argument("--dir", required=True)
+    serve.add_argument("--port", type=int, default=8090)
+    serve.add_argument("--cert")
+    serve.add_argument("--key")
+    serve.add_argument("--quiet", action="store_true")
+    args = parser.parse_args()
+
+    if args.command == "record":
+        record(args.url, args.out)
+        return
+    server = ThreadingHTTPServer(("", args.port), Handler)
+    server.dir = args.dir
+    server.quiet = args.quiet
+    scheme = "http"
+    if args.cert:
+        context = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+        context.load_cert_chain(args.cert, args.key)
+        server.socket = context.wrap_socket(server.socket, server_side=True)
+        scheme = "https"
+    print("replaying %s on %s://*:%d/<%s>/<name>" % (args.dir, scheme, args.port, "|".join(PROFILES)))
+    server.serve_forever()
+
+
+if __name__ == "__main__":
+    main()
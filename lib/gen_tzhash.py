@@ -0,0 +1,117 @@
+#!/usr/bin/env python3
+"""Generates the perfect hash of zone names src/tzhash.cpp looks TZIDs up in.
+
+    lib/gen_tzhash.py src/fallback_timezones.ics lib/windows_zones.txt src/tzhash_table.h
+
+The keys are every zone in the .ics (from dump_tzurl.pl) and every alias in
+the aliases file, each naming the zone's number in the packed zones
+(lib/pack_timezones.py numbers them in byte order of their names). A key's
+bucket comes from one FNV-1a hash, and the bucket's displacement seeds a
+second that gives its slot, so a lookup is two hashes and one compare.
+Run it again after changing either input.
+"""
+
+import argparse
+import re
+import sys
+
+FNV_OFFSET = 0x811c9dc5
+FNV_PRIME = 0x01000193
+RELEASE = re.compile(r"^PRODID:.*Olson (\S+)//", re.M)
+
+
+# must match tzhash() in src/tzhash.cpp
+def fnv(seed, key):
+    h = FNV_OFFSET ^ seed
+    for b in key:
+        h = ((h ^ b) * FNV_PRIME) & 0xffffffff
+    return h
+
+
+def read_aliases(path, zones):
+    aliases = {}
+    with open(path, encoding="utf-8") as f:
+        for n, line in enumerate(f, 1):
+            line = line.rstrip("\n")
+            if not line or line.startswith("#"):
+                continue
+            alias, _, zone = line.partition("\t")
+            if zone not in zones:
+                sys.exit("%s:%d: %s isn't one of the zones" % (path, n, zone))
+            if alias in zones or alias in aliases:
+                sys.exit("%s:%d: %s is already a key" % (path, n, alias))
+            aliases[alias] = zone
+    return aliases
+
+
+def build(keys, num_slots, num_buckets):
+    buckets = [[] for _ in range(num_buckets)]
+    for key in keys:
+        buckets[fnv(0, key) % num_buckets].append(key)
+    displace = [0] * num_buckets
+    slots = [None] * num_slots
+    for b in sorted(range(num_buckets), key=lambda b: -len(buckets[b])):
+        if not buckets[b]:
+            break
+        for d in range(1, 0x10000):
+            taken = [fnv(d, key) % num_slots for key in buckets[b]]
+            if len(set(taken)) == len(taken) and all(slots[s] is None for s in taken):
+                break
+        else:
+            return None
+        displace[b] = d
+        for key, s in zip(buckets[b], taken):
+            slots[s] = key
+    return displace, slots
+
+
+def c_string(s):
+    return '"%s"' % s.replace("\\", "\\\\").replace('"', '\\"')
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("ics")
+    parser.add_argument("aliases")
+    parser.add_argument("out")
+    args = parser.parse_args()
+    with open(args.ics, encoding="utf-8") as f:
+        text = f.read()
+    release = RELEASE.search(text)
+    if not release:
+        sys.exit("no Olson release in the PRODID")
+    names = sorted(set(re.findall(r"^TZID:([^\r\n]*)", text, re.M)), key=lambda n: n.encode())
+    number = {name: i for i, name in enumerate(names)}
+    aliases = read_aliases(args.aliases, number)
+
+    keys = {name.encode(): number[name] for name in names}
+    keys.update({alias.encode(): number[zone] for alias, zone in aliases.items()})
+    num_slots = len(keys) + len(keys) // 8
+    num_buckets = (len(keys) + 3) // 4
+    table = build(sorted(keys), num_slots, num_buckets)
+    if not table:
+        sys.exit("no displacement fits; try more slots")
+    displace, slots = table
+
+    out = ["// generated by lib/gen_tzhash.py from %s and %s, don't edit" % (args.ics, args.aliases),
+           "#define TZHASH_RELEASE %s" % c_string(release.group(1)),
+           "#define TZHASH_ZONES %d" % len(names),
+           "#define TZHASH_BUCKETS %d" % num_buckets,
+           "#define TZHASH_SLOTS %d" % num_slots,
+           "",
+           "static const uint16_t tzhash_displace[TZHASH_BUCKETS] = {"]
+    for i in range(0, num_buckets, 12):
+        out.append("    " + " ".join("%d," % d for d in displace[i:i + 12]))
+    out += ["};", "", "static const tzhash_slot tzhash_slots[TZHASH_SLOTS] = {"]
+    for key in slots:
+        out.append("    {%s, %d}," % (c_string(key.decode()), keys[key]) if key else "    {NULL, 0},")
+    out += ["};", "", "static const char *const tzhash_names[TZHASH_ZONES] = {"]
+    out += ["    %s," % c_string(name) for name in names]
+    out += ["};", ""]
+    with open(args.out, "w") as f:
+        f.write("\n".join(out))
+    print("%d zones, %d aliases: %d slots, %d buckets" % (len(names), len(aliases), num_slots, num_buckets))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,124 @@
+#!/usr/bin/env python3
+"""Stand-in OTA server for trying resumable downloads against.
+
+Serves one image at every path ending in .img, with Range and If-Range
+support, and can misbehave the way a flaky network does:
+
+    lib/ota_standin.py --image .pio/build/ttgo-t-watch/firmware.bin \\
+        --port 8000 --drop-after 300000 --stall 3
+
+and build with -DOTA_URL='"http://<host>:8000/ota/from/%s.img"'.
+
+--drop-after N cuts every response off after N body bytes, so an image
+only arrives over several resumed requests. --stall S pauses S seconds
+halfway through each response, --rate limits bytes/s, and --no-range
+ignores Range headers so the client has to start over. --delta serves a
+patch from tools/deltac instead, to clients that accept one.
+"""
+
+import argparse
+import hashlib
+import re
+import socket
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+CHUNK = 4096
+DELTA_CONTENT_TYPE = "application/vnd.clockthing.delta"
+
+
+class Handler(BaseHTTPRequestHandler):
+    # HTTP/1.0, like the clock asks for: no chunking, close when done
+    protocol_version = "HTTP/1.0"
+
+    def log_message(self, fmt, *args):
+        if not self.server.quiet:
+            super().log_message(fmt, *args)
+
+    def do_GET(self):
+        if not self.path.endswith(".img"):
+            self.send_error(404)
+            return
+        image = self.server.image
+        etag = self.server.etag
+        content_type = "application/octet-stream"
+        first = 0
+        if self.server.delta and DELTA_CONTENT_TYPE in self.headers.get("Accept", ""):
+            image = self.server.delta
+            etag = None
+            content_type = DELTA_CONTENT_TYPE
+
+        match = re.fullmatch(r"bytes=(\d+)-", self.headers.get("Range", ""))
+        if_range = self.headers.get("If-Range")
+        if match and etag and not self.server.no_range and (if_range is None or if_range == etag):
+            first = int(match.group(1))
+            if first >= len(image):
+                self.send_response(416)
+                self.send_header("Content-Range", "bytes */%d" % len(image))
+                self.end_headers()
+                return
+            self.send_response(206)
+            self.send_header("Content-Range", "bytes %d-%d/%d" % (first, len(image) - 1, len(image)))
+        else:
+            self.send_response(200)
+        self.send_header("Content-Type", content_type)
+        self.send_header("Content-Length", str(len(image) - first))
+        if etag:
+            self.send_header("ETag", etag)
+        self.end_headers()
+
+        body = image[first:]
+        limit = self.server.drop_after or len(body)
+        stall_at = min(len(body), limit) // 2 if self.server.stall else -1
+        sent = 0
+        started = time.monotonic()
+        while sent < len(body):
+            if sent >= limit:
+                # drop it on the floor without a clean close
+                self.connection.setsockopt(socket.SOL_SOCKET, socket.SO_LINGER, b"\x01\0\0\0\0\0\0\0")
+                self.close_connection = True
+                self.log_message("dropped after %d bytes", sent)
+                return
+            if 0 <= stall_at <= sent:
+                time.sleep(self.server.stall)
+                stall_at = -1
+            n = min(CHUNK, len(body) - sent, limit - sent)
+            self.wfile.write(body[sent:sent + n])
+            sent += n
+            if self.server.rate:
+                ahead = sent / self.server.rate - (time.monotonic() - started)
+                if ahead > 0:
+                    time.sleep(ahead)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--image", required=True, help="the app image to serve")
+    parser.add_argument("--port", type=int, default=8000)
+    parser.add_argument("--drop-after", type=int, default=0)
+    parser.add_argument("--stall", type=float, default=0)
+    parser.add_argument("--rate", type=int, default=0)
+    parser.add_argument("--no-range", action="store_true")
+    parser.add_argument("--delta", help="a patch from the running image to --image")
+    parser.add_argument("--quiet", action="store_true")
+    args = parser.parse_args()
+
+    server = ThreadingHTTPServer(("", args.port), Handler)
+    with open(args.image, "rb") as f:
+        server.image = f.read()
+    server.etag = '"%s"' % hashlib.sha1(server.image).hexdigest()
+    server.delta = None
+    if args.delta:
+        with open(args.delta, "rb") as f:
+            server.delta = f.read()
+    server.drop_after = args.drop_after
+    server.stall = args.stall
+    server.rate = args.rate
+    server.no_range = args.no_range
+    server.quiet = args.quiet
+    print("serving %s (%d bytes) on port %d" % (args.image, len(server.image), args.port))
+    server.serve_forever()
+
+
+if __name__ == "__main__":
+    main()
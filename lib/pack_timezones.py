@@ -0,0 +1,133 @@
+#!/usr/bin/env python3
+"""Packs src/fallback_timezones.ics (from dump_tzurl.pl) for embedding.
+
+    lib/pack_timezones.py src/fallback_timezones.ics src/fallback_timezones.tzp
+
+Zones share most of their STANDARD/DAYLIGHT blocks, and their header
+lines only differ by name, so the pack keeps each distinct block once and
+each zone as its name and a list of blocks; src/tzpack.cpp expands it back
+into the same text as it's parsed. The layout is described in
+src/tzpack.h. The result is checked to expand to exactly the input.
+
+The same file is the database the clock downloads to SPIFFS (src/tzdb.h),
+served with a .sha256 beside it:
+
+    lib/pack_timezones.py --sha256 zones.ics tz.tzp
+"""
+
+import argparse
+import hashlib
+import re
+import struct
+import sys
+import zlib
+
+MAGIC = b"TZP1"
+VERSION = 2
+HEADER = struct.Struct("<4sHHHHIII8s")
+RECORD = struct.Struct("<BBB")
+RELEASE = re.compile(r"^PRODID:.*Olson (\S+)//", re.M)
+
+# must match zone_pieces in src/tzpack.cpp
+ZONE_HEAD = re.compile(r"BEGIN:VTIMEZONE\nTZID:(?P<name>[^\n]*)\n(?P<extra>(?:(?!LAST-MODIFIED:)[^\n]*\n)*)"
+                       r"LAST-MODIFIED:(?P<modified>[^\n]*)\nTZURL:(?P<url>[^\n]*)\nX-LIC-LOCATION:(?P<location>[^\n]*)\n")
+BLOCK = re.compile(r"BEGIN:(STANDARD|DAYLIGHT)\n.*?END:\1\n", re.S)
+ZONE_END = "END:VTIMEZONE\n"
+
+
+def expand(prologue, modified, url_prefix, epilogue, blocks, zones):
+    out = [prologue]
+    for name, extra, refs in zones:
+        out.append("BEGIN:VTIMEZONE\nTZID:%s\n%sLAST-MODIFIED:%s\nTZURL:%s%s\nX-LIC-LOCATION:%s\n"
+                   % (name, extra, modified, url_prefix, name, name))
+        out.extend(blocks[i] for i in refs)
+        out.append(ZONE_END)
+    out.append(epilogue)
+    return "".join(out)
+
+
+def pack(text):
+    text = text.replace("\r\n", "\n")
+    first = text.index("BEGIN:VTIMEZONE\n")
+    last = text.rindex(ZONE_END) + len(ZONE_END)
+    prologue, epilogue = text[:first], text[last:]
+    modified = url_prefix = None
+    blocks, block_index, zones = [], {}, []
+    at = first
+    while at < last:
+        head = ZONE_HEAD.match(text, at)
+        if not head:
+            sys.exit("zone at %d doesn't fit the template" % at)
+        name = head.group("name")
+        url = head.group("url")
+        if head.group("location") != name or not url.endswith(name):
+            sys.exit("%s: TZURL or X-LIC-LOCATION doesn't follow the name" % name)
+        if modified is None:
+            modified, url_prefix = head.group("modified"), url[:-len(name)]
+        if (modified, url_prefix) != (head.group("modified"), url[:-len(name)]):
+            sys.exit("%s: LAST-MODIFIED or TZURL differs from the other zones" % name)
+        at = head.end()
+        refs = []
+        while True:
+            block = BLOCK.match(text, at)
+            if not block:
+                break
+            if block.group(0) not in block_index:
+                block_index[block.group(0)] = len(blocks)
+                blocks.append(block.group(0))
+            refs.append(block_index[block.group(0)])
+            at = block.end()
+        if not text.startswith(ZONE_END, at):
+            sys.exit("%s: unexpected lines in zone" % name)
+        at += len(ZONE_END)
+        zones.append((name, head.group("extra"), refs))
+
+    if expand(prologue, modified, url_prefix, epilogue, blocks, zones) != text:
+        sys.exit("packed zones don't expand to the input")
+
+    release = RELEASE.search(prologue)
+    if not release or len(release.group(1)) >= 8:
+        sys.exit("no Olson release in the PRODID")
+    strings = b"".join(s.encode() + b"\0" for s in (prologue, modified, url_prefix, epilogue))
+    block_data = b""
+    offsets = []
+    for block in blocks:
+        offsets.append(len(block_data))
+        block_data += block.encode()
+    zone_data = b""
+    zone_offsets = {}
+    for name, extra, refs in zones:
+        if len(name.encode()) >= 64 or len(extra.encode()) > 255 or len(refs) > 255:
+            sys.exit("%s: name, extra lines or blocks too long for a record" % name)
+        zone_offsets[name.encode()] = len(zone_data)
+        zone_data += RECORD.pack(len(name.encode()), len(extra.encode()), len(refs)) + name.encode() + extra.encode()
+        zone_data += b"".join(struct.pack("<H", r) for r in refs)
+    if len(block_data) > 0xffff or len(zone_data) > 0xffff or len(blocks) > 0xffff or len(zones) > 0xffff:
+        sys.exit("too many blocks or zones for 16-bit offsets")
+    # in byte order, as src/tzpack.cpp looks them up
+    index = b"".join(struct.pack("<H", zone_offsets[name]) for name in sorted(zone_offsets))
+    payload = (strings + b"".join(struct.pack("<H", o) for o in offsets) + index + block_data + zone_data)
+    header = HEADER.pack(MAGIC, VERSION, len(zones), len(blocks), len(strings), len(block_data), len(zone_data),
+                         zlib.crc32(payload), release.group(1).encode())
+    return header + payload, len(zones), len(blocks)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("ics")
+    parser.add_argument("out")
+    parser.add_argument("--sha256", action="store_true", help="also write OUT.sha256 for the clock's download")
+    args = parser.parse_args()
+    with open(args.ics, encoding="utf-8") as f:
+        text = f.read()
+    packed, num_zones, num_blocks = pack(text)
+    with open(args.out, "wb") as f:
+        f.write(packed)
+    if args.sha256:
+        with open(args.out + ".sha256", "w") as f:
+            f.write(hashlib.sha256(packed).hexdigest() + "\n")
+    print("%d zones, %d distinct blocks: %d bytes from %d" % (num_zones, num_blocks, len(packed), len(text)))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,27 @@
+#include "bundle.h"
+#include <string.h>
+
+uint32_t bundle_crc32(uint32_t crc, const void *data, size_t len)
+{
+  const uint8_t *p = (const uint8_t *)data;
+  crc = ~crc;
+  while (len--)
+  {
+    crc ^= *p++;
+    for (int k = 0; k < 8; ++k)
+    {
+      crc = (crc >> 1) ^ (0xedb88320u & (0 - (crc & 1)));
+    }
+  }
+  return ~crc;
+}
+
+bool bundle_header_valid(const bundle_header &h)
+{
+  return memcmp(h.magic, BUNDLE_MAGIC, sizeof(h.magic)) == 0 &&
+         h.version == BUNDLE_VERSION &&
+         h.header_size == sizeof(bundle_header) &&
+         h.num_offsets <= BUNDLE_MAX_OFFSETS &&
+         h.num_alarms <= BUNDLE_MAX_ALARMS &&
+         h.window_start <= h.window_end;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Pre-expanded alarm bundle, made from an ics feed by tools/feedc so the
+// clock doesn't need to parse RFC 5545 at all. Served with
+// BUNDLE_CONTENT_TYPE from a feed url it replaces the feed.
+//
+// Layout, little-endian like both ends: a bundle_header, num_offsets
+// bundle_offsets, then num_alarms bundle_alarms, sorted by start. crc is
+// CRC-32 of everything after the header. Records are laid out like
+// tz_offset and alarm_entry with a 64-bit time_t, so they can be read
+// straight into place.
+#define BUNDLE_MAGIC "CTAB"
+#define BUNDLE_VERSION 1
+#define BUNDLE_CONTENT_TYPE "application/vnd.clockthing.alarms"
+#define BUNDLE_MAX_OFFSETS 16
+#define BUNDLE_MAX_ALARMS 1000
+
+struct bundle_header
+{
+  char magic[4];
+  uint16_t version;
+  uint16_t header_size;
+  int64_t window_start;
+  int64_t window_end;
+  uint16_t num_offsets;
+  uint16_t num_alarms;
+  uint32_t crc;
+};
+
+struct bundle_offset
+{
+  int64_t start;
+  int32_t offset;
+  uint8_t name[8];
+  uint32_t reserved;
+};
+
+struct bundle_alarm
+{
+  int64_t start;
+  uint8_t name[20];
+  uint32_t reserved;
+};
+
+static_assert(sizeof(bundle_header) == 32, "bundle header layout");
+static_assert(sizeof(bundle_offset) == 24, "bundle offset layout");
+static_assert(sizeof(bundle_alarm) == 32, "bundle alarm layout");
+
+uint32_t bundle_crc32(uint32_t crc, const void *data, size_t len);
+
+// checks everything in the header that can be checked before the payload
+bool bundle_header_valid(const bundle_header &h);
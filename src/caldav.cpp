@@ -0,0 +1,809 @@
+#include "caldav.h"
+#include "expand.h"
+#include "feedcache.h"
+#include "istream_record.h"
+#include "tzdb.h"
+#include "tls.h"
+#include <HTTPClient.h>
+#include <SPIFFS.h>
+#include <algorithm>
+#include <vector>
+
+// servers may truncate a sync with a 507, we ask again for the rest
+#define MAX_SYNC_PAGES 8
+
+// How far each index has been expanded, so a refresh only expands the
+// window's new tail, of the records with alarms in it (src/feedcache.h).
+// In RAM only, and started over whenever a sync changes the index.
+struct index_expansion
+{
+  bool valid;
+  uint32_t filter_crc;
+  time_t parsed_at; // of the feed_status alarms it goes with
+  time_t end;       // every alarm before this is in them
+  uint32_t zones_at, zones_length; // the record the offsets come from
+  std::vector<feedcache_series> series;
+};
+
+static index_expansion expansions[MAX_FEEDS];
+
+struct caldav_change
+{
+  uint32_t href;
+  uint32_t offset; // calendar data in the .new file
+  uint32_t length;
+  bool deleted;
+};
+
+static uint32_t fnv1a(const char *s)
+{
+  uint32_t h = 2166136261u;
+  while (*s)
+  {
+    h = (h ^ (uint8_t)*s++) * 16777619u;
+  }
+  return h;
+}
+
+bool is_caldav_url(const char *url)
+{
+  return strncmp(url, "caldav://", 9) == 0 || strncmp(url, "caldavs://", 10) == 0;
+}
+
+// Just enough of a streaming XML reader for a DAV:multistatus: element names
+// without their namespace prefix, and the text inside the few we care about.
+// calendar-data goes straight to a file, so an initial sync doesn't need to
+// fit in RAM.
+class multistatus_reader
+{
+public:
+  multistatus_reader(Stream &in, File &out, std::vector<caldav_change> &changes)
+      : in(in), out(out), changes(changes), bytes(0), truncated(0), in_len(0), in_pos(0), out_len(0)
+  {
+    sync_token[0] = 0;
+  }
+
+  bool run();
+
+  Stream &in;
+  File &out;
+  std::vector<caldav_change> &changes;
+  uint32_t bytes;
+  int truncated;
+  char sync_token[256];
+
+protected:
+  int next();
+  void emit(char c);
+  void emit_entity(const char *entity);
+  void flush();
+  void open(const char *name);
+  void close(const char *name);
+
+  uint8_t in_buf[256];
+  size_t in_len, in_pos;
+  uint8_t out_buf[256];
+  size_t out_len;
+
+  enum
+  {
+    TEXT_NONE,
+    TEXT_BUFFER,
+    TEXT_FILE
+  } target;
+  char text[256];
+  size_t text_len;
+
+  int in_propstat;
+  int response_status, propstat_status;
+  char href[256];
+  uint32_t data_offset, data_length;
+  bool has_data, data_ok;
+};
+
+int multistatus_reader::next()
+{
+  if (in_pos == in_len)
+  {
+    size_t want = in.available();
+    want = want ? std::min(want, sizeof(in_buf)) : 1;
+    in_len = in.readBytes(in_buf, want);
+    in_pos = 0;
+    if (in_len == 0)
+    {
+      return -1;
+    }
+    bytes += in_len;
+  }
+  return in_buf[in_pos++];
+}
+
+void multistatus_reader::flush()
+{
+  if (out_len)
+  {
+    out.write(out_buf, out_len);
+    out_len = 0;
+  }
+}
+
+void multistatus_reader::emit(char c)
+{
+  if (target == TEXT_FILE)
+  {
+    out_buf[out_len++] = c;
+    ++data_length;
+    if (out_len == sizeof(out_buf))
+    {
+      flush();
+    }
+  }
+  else if (target == TEXT_BUFFER && text_len < sizeof(text) - 1)
+  {
+    text[text_len++] = c;
+  }
+}
+
+void multistatus_reader::emit_entity(const char *entity)
+{
+  if (strcmp(entity, "lt") == 0)
+    emit('<');
+  else if (strcmp(entity, "gt") == 0)
+    emit('>');
+  else if (strcmp(entity, "amp") == 0)
+    emit('&');
+  else if (strcmp(entity, "quot") == 0)
+    emit('"');
+  else if (strcmp(entity, "apos") == 0)
+    emit('\'');
+  else if (entity[0] == '#')
+  {
+    long c = entity[1] == 'x' ? strtol(entity + 2, NULL, 16) : strtol(entity + 1, NULL, 10);
+    // calendar data is UTF-8; anything past ASCII arrives as raw bytes
+    if (c > 0 && c < 0x80)
+      emit(c);
+  }
+}
+
+static int status_code(const char *status)
+{
+  // "HTTP/1.1 404 Not Found"
+  const char *http = strstr(status, "HTTP/");
+  const char *space = http ? strchr(http, ' ') : NULL;
+  return space ? atoi(space + 1) : 0;
+}
+
+void multistatus_reader::open(const char *name)
+{
+  if (strcmp(name, "response") == 0)
+  {
+    response_status = propstat_status = 0;
+    href[0] = 0;
+    has_data = data_ok = false;
+    in_propstat = 0;
+  }
+  else if (strcmp(name, "propstat") == 0)
+  {
+    in_propstat = 1;
+    propstat_status = 0;
+  }
+  else if (strcmp(name, "href") == 0 || strcmp(name, "status") == 0 || strcmp(name, "sync-token") == 0)
+  {
+    target = TEXT_BUFFER;
+    text_len = 0;
+  }
+  else if (strcmp(name, "calendar-data") == 0 || strcmp(name, "calendar-timezone") == 0)
+  {
+    target = TEXT_FILE;
+    data_offset = out.position() + out_len;
+    data_length = 0;
+  }
+}
+
+void multistatus_reader::close(const char *name)
+{
+  text[text_len] = 0;
+  if (strcmp(name, "href") == 0)
+  {
+    if (!href[0])
+    {
+      strlcpy(href, text, sizeof(href));
+    }
+  }
+  else if (strcmp(name, "status") == 0)
+  {
+    (in_propstat ? propstat_status : response_status) = status_code(text);
+  }
+  else if (strcmp(name, "sync-token") == 0)
+  {
+    strlcpy(sync_token, text, sizeof(sync_token));
+  }
+  else if (strcmp(name, "calendar-data") == 0 || strcmp(name, "calendar-timezone") == 0)
+  {
+    has_data = data_length > 0;
+  }
+  else if (strcmp(name, "propstat") == 0)
+  {
+    data_ok |= has_data && propstat_status == 200;
+    has_data = false;
+    in_propstat = 0;
+  }
+  else if (strcmp(name, "response") == 0)
+  {
+    if (response_status == 507)
+    {
+      truncated = 1;
+    }
+    else if (response_status == 404 && href[0])
+    {
+      changes.push_back({fnv1a(href), 0, 0, true});
+    }
+    else if (data_ok && href[0])
+    {
+      changes.push_back({fnv1a(href), data_offset, data_length, false});
+    }
+  }
+  target = TEXT_NONE;
+  text_len = 0;
+}
+
+bool multistatus_reader::run()
+{
+  char tag[128];
+  char entity[12];
+  target = TEXT_NONE;
+  text_len = 0;
+  int c;
+  while ((c = next()) >= 0)
+  {
+    if (c == '&')
+    {
+      size_t n = 0;
+      while ((c = next()) >= 0 && c != ';' && n < sizeof(entity) - 1)
+      {
+        entity[n++] = c;
+      }
+      entity[n] = 0;
+      emit_entity(entity);
+      continue;
+    }
+    if (c != '<')
+    {
+      emit(c);
+      continue;
+    }
+
+    size_t n = 0;
+    while ((c = next()) >= 0 && c != '>')
+    {
+      if (n < sizeof(tag) - 1)
+      {
+        tag[n++] = c;
+      }
+      if (n == 8 && strncmp(tag, "![CDATA[", 8) == 0)
+      {
+        // raw text up to ]]>
+        int brackets = 0;
+        while ((c = next()) >= 0)
+        {
+          if (c == '>' && brackets >= 2)
+          {
+            break;
+          }
+          if (c == ']')
+          {
+            ++brackets;
+            continue;
+          }
+          for (; brackets > 0; --brackets)
+          {
+            emit(']');
+          }
+          emit(c);
+        }
+        n = 0;
+        break;
+      }
+      if (n == 3 && strncmp(tag, "!--", 3) == 0)
+      {
+        int dashes = 0;
+        while ((c = next()) >= 0 && !(c == '>' && dashes >= 2))
+        {
+          dashes = c == '-' ? dashes + 1 : 0;
+        }
+        n = 0;
+        break;
+      }
+    }
+    if (c < 0)
+    {
+      break;
+    }
+    if (n == 0 || tag[0] == '?' || tag[0] == '!')
+    {
+      continue;
+    }
+    tag[n] = 0;
+
+    bool closing = tag[0] == '/';
+    bool empty = tag[n - 1] == '/';
+    char *name = tag + closing;
+    name[strcspn(name, " \t\r\n/")] = 0;
+    char *colon = strchr(name, ':');
+    if (colon)
+    {
+      name = colon + 1;
+    }
+    if (!closing)
+    {
+      open(name);
+    }
+    if (closing || empty)
+    {
+      if (target == TEXT_FILE)
+      {
+        flush();
+      }
+      close(name);
+    }
+  }
+  flush();
+  return c < 0 && target == TEXT_NONE;
+}
+
+static void index_path(char *out, size_t len, size_t feed, const char *ext)
+{
+  snprintf(out, len, "/cal%u.%s", feed, ext);
+}
+
+// the token file holds the url it belongs to, then the token
+static void load_token(size_t feed, const char *url, char *token, size_t len)
+{
+  char path[16];
+  token[0] = 0;
+  index_path(path, sizeof(path), feed, "tok");
+  File f = SPIFFS.open(path, "r");
+  if (!f)
+  {
+    return;
+  }
+  String saved_url = f.readStringUntil('\n');
+  String saved_token = f.readStringUntil('\n');
+  f.close();
+  // a token without its index would build one from a delta alone
+  index_path(path, sizeof(path), feed, "idx");
+  if (saved_url == url && SPIFFS.exists(path))
+  {
+    strlcpy(token, saved_token.c_str(), len);
+  }
+}
+
+static void save_token(size_t feed, const char *url, const char *token)
+{
+  char path[16];
+  index_path(path, sizeof(path), feed, "tok");
+  File f = SPIFFS.open(path, "w");
+  f.printf("%s\n%s\n", url, token);
+  f.close();
+}
+
+// The collection's zone (CALDAV:calendar-timezone), which no event's own
+// calendar data says, into /calN.tz: a VCALENDAR with just X-WR-TIMEZONE,
+// so the zone comes from the zone pack like a feed's. Empty if the server
+// has none. False, and the file left as it was, if the server couldn't say.
+static bool fetch_zone(const char *url, size_t feed)
+{
+  char tmp_path[16], path[16];
+  index_path(tmp_path, sizeof(tmp_path), feed, "tzn");
+  index_path(path, sizeof(path), feed, "tz");
+  File tmp = SPIFFS.open(tmp_path, "w");
+  if (!tmp)
+  {
+    return false;
+  }
+  std::vector<caldav_change> found;
+  int code;
+  {
+    TlsClient tls;
+    HTTPClient http;
+    http.useHTTP10(true);
+    if (!http_begin(http, tls, url))
+    {
+      tmp.close();
+      SPIFFS.remove(tmp_path);
+      return false;
+    }
+    http.addHeader("Depth", "0");
+    http.addHeader("Content-Type", "application/xml; charset=utf-8");
+    code = http.sendRequest("PROPFIND", "<?xml version=\"1.0\" encoding=\"utf-8\"?>"
+                                        "<d:propfind xmlns:d=\"DAV:\" xmlns:c=\"urn:ietf:params:xml:ns:caldav\">"
+                                        "<d:prop><c:calendar-timezone/></d:prop></d:propfind>");
+    if (code == 207)
+    {
+      multistatus_reader *reader = new multistatus_reader(http.getStream(), tmp, found);
+      if (!reader->run())
+      {
+        code = 0;
+      }
+      delete reader;
+    }
+  }
+  tmp.close();
+  if (code != 207)
+  {
+    Serial.printf("caldav: no calendar-timezone, %d\n", code);
+    SPIFFS.remove(tmp_path);
+    return false;
+  }
+
+  char tzid[64] = "";
+  if (!found.empty() && !found[0].deleted)
+  {
+    tmp = SPIFFS.open(tmp_path, "r");
+    tmp.seek(found[0].offset);
+    istream_record lines(tmp, found[0].length);
+    uICAL::string l;
+    while (!tzid[0] && lines.readuntil(l, '\n'))
+    {
+      if (strncmp(l.c_str(), "TZID:", 5) == 0)
+      {
+        strlcpy(tzid, l.c_str() + 5, sizeof(tzid));
+        tzid[strcspn(tzid, "\r")] = 0;
+      }
+    }
+    tmp.close();
+  }
+  SPIFFS.remove(tmp_path);
+  File zone = SPIFFS.open(path, "w");
+  if (!zone)
+  {
+    return false;
+  }
+  if (tzid[0])
+  {
+    zone.printf("BEGIN:VCALENDAR\r\nVERSION:2.0\r\nX-WR-TIMEZONE:%s\r\nEND:VCALENDAR\r\n", tzid);
+  }
+  zone.close();
+  Serial.printf("caldav: collection zone %s\n", tzid[0] ? tzid : "(none)");
+  return true;
+}
+
+static int sync_report(const char *url, const char *token, File &news, std::vector<caldav_change> &changes,
+                       multistatus_reader **result)
+{
+  TlsClient tls;
+  HTTPClient http;
+  http.useHTTP10(true);
+  if (!http_begin(http, tls, url))
+  {
+    return -1;
+  }
+  http.addHeader("Depth", "0");
+  http.addHeader("Content-Type", "application/xml; charset=utf-8");
+  String body = "<?xml version=\"1.0\" encoding=\"utf-8\"?>"
+                "<d:sync-collection xmlns:d=\"DAV:\" xmlns:c=\"urn:ietf:params:xml:ns:caldav\">"
+                "<d:sync-token>";
+  body += token; // tokens are URIs, nothing here needs escaping
+  body += "</d:sync-token><d:sync-level>1</d:sync-level>"
+          "<d:prop><d:getetag/><c:calendar-data/></d:prop>"
+          "</d:sync-collection>";
+  int code = http.sendRequest("REPORT", body);
+  if (code != 207)
+  {
+    return code;
+  }
+  multistatus_reader *reader = new multistatus_reader(http.getStream(), news, changes);
+  if (!reader->run())
+  {
+    delete reader;
+    return 0;
+  }
+  *result = reader;
+  return code;
+}
+
+// copies len bytes from in's position to out; false if either comes up short
+static bool copy_bytes(File &in, File &out, uint32_t len)
+{
+  uint8_t buf[256];
+  while (len)
+  {
+    size_t n = in.read(buf, std::min((size_t)len, sizeof(buf)));
+    if (n == 0 || out.write(buf, n) != n)
+    {
+      return false;
+    }
+    len -= n;
+  }
+  return true;
+}
+
+// rewrites the index without anything touched by changes, then appends the
+// new calendar data; the last change to an href wins. False, and the old
+// index kept, if any of it couldn't be written: a delta sync won't send
+// what's lost again.
+static bool apply_changes(size_t feed, bool full, std::vector<caldav_change> &changes)
+{
+  char idx_path[16], tmp_path[16], new_path[16];
+  index_path(idx_path, sizeof(idx_path), feed, "idx");
+  index_path(tmp_path, sizeof(tmp_path), feed, "tmp");
+  index_path(new_path, sizeof(new_path), feed, "new");
+
+  std::stable_sort(changes.begin(), changes.end(), [](const caldav_change &a, const caldav_change &b)
+                   { return a.href < b.href; });
+
+  // the records move, and what's in them changes
+  expansions[feed].valid = false;
+  File tmp = SPIFFS.open(tmp_path, "w");
+  if (!tmp)
+  {
+    return false;
+  }
+  bool ok = true;
+  File idx;
+  if (!full)
+  {
+    idx = SPIFFS.open(idx_path, "r");
+  }
+  while (ok && idx && idx.available())
+  {
+    uint32_t header[2]; // href hash, length
+    if (idx.read((uint8_t *)header, sizeof(header)) != sizeof(header))
+    {
+      ok = false;
+      break;
+    }
+    caldav_change key = {header[0], 0, 0, false};
+    bool touched = std::binary_search(changes.begin(), changes.end(), key, [](const caldav_change &a, const caldav_change &b)
+                                      { return a.href < b.href; });
+    if (touched)
+    {
+      idx.seek(header[1], SeekCur);
+      continue;
+    }
+    ok = tmp.write((uint8_t *)header, sizeof(header)) == sizeof(header) && copy_bytes(idx, tmp, header[1]);
+  }
+  if (idx)
+  {
+    idx.close();
+  }
+
+  File news = SPIFFS.open(new_path, "r");
+  for (size_t i = 0; ok && i < changes.size(); ++i)
+  {
+    const caldav_change &ch = changes[i];
+    if (ch.deleted || (i + 1 < changes.size() && changes[i + 1].href == ch.href))
+    {
+      continue;
+    }
+    uint32_t header[2] = {ch.href, ch.length};
+    ok = tmp.write((uint8_t *)header, sizeof(header)) == sizeof(header) && news.seek(ch.offset) &&
+         copy_bytes(news, tmp, ch.length);
+  }
+  news.close();
+  tmp.close();
+  SPIFFS.remove(new_path);
+  if (!ok)
+  {
+    SPIFFS.remove(tmp_path);
+    return false;
+  }
+  SPIFFS.remove(idx_path);
+  return SPIFFS.rename(tmp_path, idx_path);
+}
+
+// the calendar of the record at at, for its zones
+static uICAL::Calendar_ptr read_zones(File &idx, uint32_t at, uint32_t length, uICAL::TZMap_ptr &tzmap,
+                                      zone_lookup &zones, time_t now, const event_filter &filter,
+                                      alarm_collector &alarms)
+{
+  filter_stats none = {0, 0, 0};
+  try
+  {
+    idx.seek(at);
+    istream_record record(idx, length);
+    return expand_calendar(record, tzmap, now, now, filter, alarms, none, &zones);
+  }
+  catch (uICAL::Error ex)
+  {
+    return nullptr;
+  }
+}
+
+// Every record is a series. If f's alarms are of the last expansion of
+// this index, only the series with alarms in the window's new tail are
+// expanded; otherwise all of them.
+static feed_result expand_index(feed_status &f, size_t feed, time_t now, const event_filter &filter)
+{
+  char idx_path[16];
+  index_path(idx_path, sizeof(idx_path), feed, "idx");
+  File idx = SPIFFS.open(idx_path, "r");
+
+  index_expansion &w = expansions[feed];
+  uint32_t filter_crc = filter.crc();
+  bool ours = idx && w.valid && w.filter_crc == filter_crc && f.parsed_at && f.parsed_at == w.parsed_at;
+  time_t end = now + 86400 * EXPAND_DAYS;
+  uICAL::TZMap_ptr tzmap = uICAL::new_ptr<uICAL::TZMap>();
+  zone_lookup zones(tzdb_load_zone);
+  uICAL::Calendar_ptr cal = nullptr;
+  size_t expanded = 0;
+  int failed = 0;
+  if (ours)
+  {
+    f.alarms.drop_before(now);
+    filter_stats stats = {0, 0, 0};
+    for (feedcache_series &s : w.series)
+    {
+      uint32_t header[2];
+      if (s.next >= end || w.end >= end || !idx.seek(s.at) ||
+          idx.read((uint8_t *)header, sizeof(header)) != sizeof(header))
+      {
+        continue;
+      }
+      time_t begin = s.last >= w.end ? s.last + 1 : w.end;
+      failed += !feedcache_expand_series(idx, s.at + sizeof(header), header[1], s, tzmap, zones, begin, end, filter,
+                                         f.alarms, stats);
+      ++expanded;
+    }
+  }
+  else
+  {
+    f.alarms.clear();
+    f.parsed_at = 0;
+    bzero(&f.stats, sizeof(f.stats));
+    w.series.clear();
+    w.end = 0;
+    w.zones_at = w.zones_length = 0;
+    while (idx && idx.available())
+    {
+      uint32_t header[2];
+      uint32_t at = idx.position();
+      if (idx.read((uint8_t *)header, sizeof(header)) != sizeof(header))
+      {
+        break;
+      }
+      // one bad event shouldn't cost the rest of the collection
+      feedcache_series s = {at, 0, 0, 0};
+      if (feedcache_expand_series(idx, at + sizeof(header), header[1], s, tzmap, zones, now, end, filter, f.alarms,
+                                  f.stats))
+      {
+        w.zones_at = at + sizeof(header);
+        w.zones_length = header[1];
+      }
+      else
+      {
+        ++failed;
+      }
+      w.series.push_back(s);
+      idx.seek(at + sizeof(header) + header[1]);
+    }
+    expanded = w.series.size();
+    w.valid = true;
+    w.filter_crc = filter_crc;
+  }
+  // the offsets, which move on with now: in the collection's zone, and only
+  // without one in whatever zone the last event was
+  char tz_path[16];
+  index_path(tz_path, sizeof(tz_path), feed, "tz");
+  File tz = SPIFFS.open(tz_path, "r");
+  if (tz && tz.size())
+  {
+    cal = read_zones(tz, 0, tz.size(), tzmap, zones, now, filter, f.alarms);
+  }
+  else if (w.zones_length)
+  {
+    cal = read_zones(idx, w.zones_at, w.zones_length, tzmap, zones, now, filter, f.alarms);
+  }
+  if (tz)
+  {
+    tz.close();
+  }
+  if (idx)
+  {
+    idx.close();
+  }
+  Serial.printf("caldav %u: %u of %u records expanded, %u alarms, failed %d\n", feed, expanded, w.series.size(),
+                f.alarms.count, failed);
+  if (cal || !ours)
+  {
+    f.num_offsets = cal ? record_offsets(cal, now, f.offsets, MAX_OFFSETS) : 0;
+  }
+  f.parsed_at = w.parsed_at = now;
+  if (w.end < end)
+  {
+    w.end = end;
+  }
+  if (f.alarms.count == MAX_ALARMS)
+  {
+    // alarms past the last kept were let go, so the next window starts over
+    w.valid = false;
+  }
+  return FEED_OK;
+}
+
+bool caldav_expand(feed_status &f, const char *url, time_t now, const event_filter &filter)
+{
+  size_t feed = &f - feeds;
+  char token[256];
+  load_token(feed, url, token, sizeof(token));
+  if (token[0] == 0)
+  {
+    return false; // never synced, or the index is of another collection
+  }
+  return expand_index(f, feed, now, filter) == FEED_OK;
+}
+
+feed_result caldav_sync(feed_status &f, const char *url, time_t now, const event_filter &filter)
+{
+  size_t feed = &f - feeds;
+  char http_url[FEED_URL_LEN];
+  snprintf(http_url, sizeof(http_url), "%s%s", url[6] == 's' ? "https" : "http", strstr(url, "://"));
+
+  char token[256];
+  load_token(feed, url, token, sizeof(token));
+  bool full = token[0] == 0;
+
+  char new_path[16];
+  index_path(new_path, sizeof(new_path), feed, "new");
+  File news = SPIFFS.open(new_path, "w");
+  if (!news)
+  {
+    Serial.println("caldav: no spiffs");
+    return FEED_BEGIN_FAILED;
+  }
+
+  std::vector<caldav_change> changes;
+  uint32_t bytes = 0;
+  bool retried = false;
+  for (int page = 0; page < MAX_SYNC_PAGES; ++page)
+  {
+    multistatus_reader *reader = NULL;
+    f.http_code = sync_report(http_url, token, news, changes, &reader);
+    if ((f.http_code == 403 || f.http_code == 409) && !full && !retried)
+    {
+      // the server forgot our token (DAV:valid-sync-token), start over
+      Serial.println("caldav: sync token rejected, full sync");
+      token[0] = 0;
+      full = retried = true;
+      changes.clear();
+      news.close();
+      news = SPIFFS.open(new_path, "w");
+      page = -1;
+      continue;
+    }
+    if (!reader)
+    {
+      Serial.printf("caldav: report failed %d\n", f.http_code);
+      news.close();
+      SPIFFS.remove(new_path);
+      return f.http_code == 0 ? FEED_PARSE_ERROR : FEED_HTTP_ERROR;
+    }
+    bytes += reader->bytes;
+    strlcpy(token, reader->sync_token, sizeof(token));
+    bool truncated = reader->truncated;
+    delete reader;
+    if (!truncated)
+    {
+      break;
+    }
+  }
+  news.close();
+  Serial.printf("caldav: %u bytes, %u changes\n", bytes, changes.size());
+
+  if ((full || !changes.empty()) && !apply_changes(feed, full, changes))
+  {
+    Serial.println("caldav: couldn't update index");
+    return FEED_PARSE_ERROR;
+  }
+  SPIFFS.remove(new_path);
+  save_token(feed, url, token);
+  char tz_path[16];
+  index_path(tz_path, sizeof(tz_path), feed, "tz");
+  if (full || !SPIFFS.exists(tz_path))
+  {
+    fetch_zone(http_url, feed);
+  }
+  feed_result result = expand_index(f, feed, now, filter);
+  // a sync from our token with nothing in it is the collection as it was
+  return result == FEED_OK && !full && changes.empty() ? FEED_UNCHANGED : result;
+}
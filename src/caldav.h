@@ -0,0 +1,17 @@
+#pragma once
+
+#include <Arduino.h>
+#include "feeds.h"
+
+// A feed url of caldavs://host/path/ (or caldav:// for plain http) names a
+// CalDAV collection instead of an .ics export. It is kept in step with
+// RFC 6578 sync-collection REPORTs, so after the first sync only changed and
+// deleted events cross the network. Each event's calendar data is kept in an
+// index file on SPIFFS, which is what gets expanded.
+bool is_caldav_url(const char *url);
+
+feed_result caldav_sync(feed_status &f, const char *url, time_t now, const event_filter &filter);
+
+// expands the index as the last sync left it, without the network; false
+// if there's no index of url
+bool caldav_expand(feed_status &f, const char *url, time_t now, const event_filter &filter);
@@ -0,0 +1,345 @@
+#include "clock.h"
+
+#define BEEP_ON 250
+#define BEEP_OFF 350
+
+volatile int touched = 0;
+volatile int beeping = 0;
+time_t last_synced;
+time_t last_success;
+time_t last_expanded;
+time_t last_alarm;
+time_t next_alarm;
+time_t last_ota_attempt;
+time_t last_touch;
+int want_stop = 0;
+int ota_ready = 0;
+fetch_schedule fetch_plan;
+
+// the offset in effect at t, -1 for none
+static int offset_at(time_t t)
+{
+  int offset = -1;
+  while (offset + 1 < (int)state.num_offsets && state.offsets[offset + 1].start <= t)
+  {
+    ++offset;
+  }
+  return offset;
+}
+
+int clock_tick(clock_hal &hal, time_t now, int64_t uptime_us)
+{
+  int todo = 0;
+  time_t display_now = now;
+  time_t alarm_now = now - (now % 60);
+  int offset = offset_at(now);
+  if (offset >= 0)
+  {
+    display_now += (int32_t)state.offsets[offset].offset;
+  }
+
+  int found_alarm = 0;
+  size_t al = 0;
+  time_t altime;
+  for (; al < state.num_alarms; ++al)
+  {
+    if (state.alarms[al].start >= alarm_now && state.alarms[al].start < alarm_now + (7 * 86400))
+    {
+      altime = state.alarms[al].start;
+      if (altime == alarm_now && last_alarm != alarm_now)
+      {
+        last_alarm = alarm_now;
+        if (state.alarm_skip != alarm_now)
+        {
+          // so this tick already shows it
+          beeping = 1;
+          todo |= CLOCK_ALARM;
+        }
+      }
+      found_alarm = 1;
+      break;
+    }
+  }
+
+  struct tm *t = gmtime(&display_now);
+  if (beeping)
+  {
+    hal.display->set_color(FACE_GREEN);
+    hal.display->set_backlight(255);
+  }
+  else if ((t->tm_hour <= 7) || (t->tm_hour >= 20))
+  {
+    hal.display->set_color(FACE_RED);
+    hal.display->set_backlight(96);
+  }
+  else
+  {
+    hal.display->set_color(FACE_WHITE);
+    hal.display->set_backlight(255);
+  }
+
+  hal.display->set_text(FACE_TZ, offset >= 0 ? (const char *)state.offsets[offset].buffer : "UTC");
+
+  char buffer[80] = {0};
+  strftime(buffer, sizeof(buffer), "%I:%M", t);
+  if (buffer[0] == '0')
+  {
+    buffer[0] = '!';
+  }
+  hal.display->set_text(FACE_TIME, buffer);
+  hal.display->set_text(FACE_PM, t->tm_hour >= 12 ? "PM" : "");
+  hal.display->set_text(FACE_AM, t->tm_hour >= 12 ? "" : "AM");
+
+  char date_text[80];
+  strftime(date_text, sizeof(date_text), "%a %b %e, %Y", t);
+
+  const char *alarm_prefix = "";
+  char alarm_text[128];
+  if (found_alarm)
+  {
+    next_alarm = altime;
+    if (state.alarm_skip && state.alarm_skip != next_alarm)
+    {
+      Serial.printf("unset skip %ld != %ld\n", (long)state.alarm_skip, (long)next_alarm);
+      state.alarm_skip = 0;
+      todo |= CLOCK_SAVE;
+    }
+    offset = offset_at(altime);
+    if (offset >= 0)
+    {
+      altime += (int32_t)state.offsets[offset].offset;
+    }
+
+    if (beeping)
+    {
+      alarm_prefix = FACE_SYMBOL_EYE_OPEN;
+    }
+    else if (alarm_now != last_alarm && next_alarm != state.alarm_skip)
+    {
+      alarm_prefix = FACE_SYMBOL_BELL;
+    }
+    else
+    {
+      alarm_prefix = FACE_SYMBOL_PAUSE;
+    }
+
+    t = gmtime(&altime);
+    if (next_alarm < alarm_now + (3600 * 22))
+    {
+      strftime(buffer, sizeof(buffer), "%l:%M %p", t);
+    }
+    else
+    {
+      strftime(buffer, sizeof(buffer), "%a %l:%M %p", t);
+    }
+    snprintf(alarm_text, sizeof(alarm_text), "%s %s %s", alarm_prefix, buffer, state.alarms[al].name);
+  }
+  else
+  {
+    if (state.alarm_skip != 0 && next_alarm != 0)
+    {
+      state.alarm_skip = next_alarm = 0;
+      todo |= CLOCK_SAVE;
+    }
+    strlcpy(alarm_text, "no imminent alarm", sizeof(alarm_text));
+  }
+
+  // the alarm line takes turns with whatever needs attention
+  int warn = 0;
+  char warning_text[48] = "";
+  int warn_sec = display_now % 30;
+
+  if (!hal.network->connected())
+  {
+    strlcat(warning_text, FACE_SYMBOL_WIFI, sizeof(warning_text));
+    warn = 1;
+    if (!beeping && warn_sec >= 5 && warn_sec < 10)
+    {
+      snprintf(alarm_text, sizeof(alarm_text), "%s Wi-Fi Disconnected", alarm_prefix);
+    }
+  }
+  else
+  {
+    if (!beeping && last_synced != 0 &&
+        now - last_ota_attempt > 86400 &&
+        (next_alarm == 0 || next_alarm - now > 3600) &&
+        uptime_us > 15 * 1000000LL)
+    {
+      todo |= CLOCK_OTA;
+    }
+  }
+
+  if (now - last_synced > (time_t)((hal.network->ntp_interval_ms() * 4) / 1000))
+  {
+    strlcat(warning_text, FACE_SYMBOL_REFRESH, sizeof(warning_text));
+    warn = 1;
+    if (!beeping && warn_sec >= 10 && warn_sec < 15)
+    {
+      snprintf(alarm_text, sizeof(alarm_text), "%s no recent NTP sync", alarm_prefix);
+    }
+  }
+
+  if (warn == 0 && !beeping && fetch_plan.due(now, next_alarm) && uptime_us > 30 * 1000000LL)
+  {
+    todo |= CLOCK_FETCH;
+  }
+
+  // the window moves on each midnight whether or not a fetch gets through,
+  // and at boot the cached feeds have alarms before the network is up
+  time_t local_offset = display_now - now;
+  if (!beeping && !(todo & CLOCK_FETCH) && uptime_us > 5 * 1000000LL &&
+      (last_expanded == 0 || (last_expanded + local_offset) / 86400 != display_now / 86400))
+  {
+    last_expanded = now;
+    todo |= CLOCK_EXPAND;
+  }
+
+  if (now - last_success > (3600 * 4))
+  {
+    strlcat(warning_text, FACE_SYMBOL_BELL, sizeof(warning_text));
+    warn = 1;
+    if (!beeping && warn_sec >= 15 && warn_sec < 20)
+    {
+      snprintf(alarm_text, sizeof(alarm_text), "%s no recent iCal sync", alarm_prefix);
+    }
+  }
+
+  if (warn)
+  {
+    memmove(warning_text + strlen(FACE_SYMBOL_WARNING), warning_text, strlen(warning_text) + 1);
+    memcpy(warning_text, FACE_SYMBOL_WARNING, strlen(FACE_SYMBOL_WARNING));
+  }
+
+  char ssid[64], url[64];
+  if (hal.network->web_portal_active())
+  {
+    if (want_stop)
+    {
+      hal.network->stop_web_portal();
+    }
+    else
+    {
+      strlcat(warning_text, FACE_SYMBOL_SETTINGS, sizeof(warning_text));
+      if (!beeping && warn_sec >= 20 && warn_sec < 25)
+      {
+        hal.network->portal_info(false, ssid, sizeof(ssid), url, sizeof(url));
+        snprintf(alarm_text, sizeof(alarm_text), "%s SSID: %s", alarm_prefix, ssid);
+        strlcpy(date_text, url, sizeof(date_text));
+      }
+    }
+  }
+
+  if (hal.network->config_portal_active())
+  {
+    if (!beeping)
+    {
+      hal.network->portal_info(true, ssid, sizeof(ssid), url, sizeof(url));
+      snprintf(alarm_text, sizeof(alarm_text), "%s SSID: %s", alarm_prefix, ssid);
+      strlcpy(date_text, url, sizeof(date_text));
+      warning_text[0] = 0;
+    }
+  }
+
+  if (ota_ready)
+  {
+    strlcat(warning_text, FACE_SYMBOL_DOWNLOAD, sizeof(warning_text));
+    if (!beeping && warn_sec >= 20 && warn_sec < 25)
+    {
+      snprintf(alarm_text, sizeof(alarm_text), "%s reboot to update", alarm_prefix);
+    }
+  }
+
+  hal.display->set_text(FACE_DATE, date_text);
+  hal.display->set_text(FACE_ALARM, alarm_text);
+  hal.display->set_text(FACE_WARNING, warning_text);
+  return todo;
+}
+
+int clock_click(time_t now)
+{
+  if (beeping)
+  {
+    if (!touched)
+    {
+      touched = 1;
+      Serial.println("touch to end beeping");
+    }
+  }
+  else if ((now - last_touch) > 1)
+  {
+    Serial.println("new touch");
+    last_touch = now;
+    if (next_alarm != state.alarm_skip)
+    {
+      state.alarm_skip = next_alarm;
+    }
+    else
+    {
+      state.alarm_skip = 0;
+    }
+    return CLOCK_SAVE;
+  }
+  else
+  {
+    // Serial.println("continuing touch");
+    last_touch = now;
+  }
+  return 0;
+}
+
+void clock_beep(clock_hal &hal)
+{
+  touched = 0;
+  int duty = 10;
+  beeping = 1;
+  int maxcount = 299000 / (BEEP_ON + BEEP_OFF); // beep for 299 seconds
+  while (touched == 0 && --maxcount)
+  {
+    hal.buzzer->tone(duty);
+    hal.clock->sleep_ms(BEEP_ON);
+    hal.buzzer->tone(0);
+    hal.clock->sleep_ms(BEEP_OFF);
+    duty += 5;
+    if (duty >= 128)
+    {
+      duty = 127;
+    }
+  }
+  beeping = 0;
+}
+
+bool clock_save(hal_storage &storage, const clock_state &snapshot)
+{
+  static clock_state saved;
+  bzero(&saved, sizeof(saved));
+  if (storage.load("s", &saved, sizeof(saved)) && memcmp(&snapshot, &saved, sizeof(saved)) == 0)
+  {
+    return false;
+  }
+  storage.store("s", &snapshot, sizeof(snapshot));
+  return true;
+}
+
+time_t clock_read_rtc(hal_rtc &rtc, hal_clock &clock)
+{
+  struct tm first, t;
+  rtc.read(first);
+  t = first;
+  int64_t started = clock.mono_us();
+  while (t.tm_sec == first.tm_sec && clock.mono_us() - started < 1100000)
+  {
+    clock.sleep_ms(1);
+    rtc.read(t);
+  }
+  time_t now = mktime(&t);
+  if (now == -1)
+  {
+    now = 1293843661; // super onesday
+  }
+  return now;
+}
+
+void clock_write_rtc(hal_rtc &rtc, time_t now)
+{
+  rtc.write(*gmtime(&now));
+}
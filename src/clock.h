@@ -0,0 +1,63 @@
+#pragma once
+
+#include <Arduino.h>
+#include "hal.h"
+#include "state.h"
+#include "schedule.h"
+
+// The clock's own logic, written against hal.h so it builds for the watch
+// and for the host: what the face shows each second, when alarms go off,
+// and when fetches and updates are due. The tasks doing the fetching and
+// updating stay in main.cpp.
+
+// LVGL's built in symbols (LV_SYMBOL_*), spelled out to build without it
+#define FACE_SYMBOL_SETTINGS "\xef\x80\x93"
+#define FACE_SYMBOL_DOWNLOAD "\xef\x80\x99"
+#define FACE_SYMBOL_REFRESH "\xef\x80\xa1"
+#define FACE_SYMBOL_PAUSE "\xef\x81\x8c"
+#define FACE_SYMBOL_EYE_OPEN "\xef\x81\xae"
+#define FACE_SYMBOL_WARNING "\xef\x81\xb1"
+#define FACE_SYMBOL_BELL "\xef\x83\xb3"
+#define FACE_SYMBOL_WIFI "\xef\x87\xab"
+
+// what clock_tick() leaves to the caller
+#define CLOCK_SAVE 1 // state changed
+#define CLOCK_ALARM 2 // start clock_beep()
+#define CLOCK_FETCH 4
+#define CLOCK_OTA 8
+#define CLOCK_EXPAND 16 // expand the cached feeds again, for a new day
+
+extern volatile int touched;
+extern volatile int beeping;
+extern time_t last_synced;
+extern time_t last_success; // of a feed fetch
+extern time_t last_expanded; // when the alarms' window last moved on
+extern time_t last_alarm;
+extern time_t next_alarm;
+extern time_t last_ota_attempt;
+extern time_t last_touch;
+extern int want_stop; // the web portal is to close
+extern int ota_ready;
+extern fetch_schedule fetch_plan;
+
+// Updates the face for now, and fires the alarm at its minute; call with
+// state locked. Returns CLOCK_* flags.
+int clock_tick(clock_hal &hal, time_t now, int64_t uptime_us);
+
+// a press of the button or the screen: stops the beeping, or else skips
+// the next alarm or unskips it; call with state locked. Returns CLOCK_SAVE
+// if state changed.
+int clock_click(time_t now);
+
+// beeps, louder and louder, until touched or for 299 seconds
+void clock_beep(clock_hal &hal);
+
+// writes state if it differs from what's stored; returns true if it did
+bool clock_save(hal_storage &storage, const clock_state &snapshot);
+
+// waits for the RTC's seconds to turn over, so the reading is good to a
+// few ms, and returns it
+time_t clock_read_rtc(hal_rtc &rtc, hal_clock &clock);
+
+// the RTC only keeps whole seconds, so call this just after one starts
+void clock_write_rtc(hal_rtc &rtc, time_t now);
@@ -0,0 +1,227 @@
+#include "delta.h"
+#include "bundle.h"
+#include <string.h>
+
+delta_patcher::delta_patcher(delta_io &io)
+    : io(io), state(HEADER), status(DELTA_MORE), header_fill(0), value(0), shift(0), remaining(0), run(0),
+      source_pos(0), target_pos(0), target_crc(0), source_buf_start(0), source_buf_len(0), out_fill(0)
+{
+  memset(&h, 0, sizeof(h));
+}
+
+delta_result delta_patcher::feed(const uint8_t *data, size_t len)
+{
+  for (size_t i = 0; i < len && status == DELTA_MORE; ++i)
+  {
+    status = step(data[i]);
+  }
+  return status;
+}
+
+// LEB128; true once the last byte is in
+bool delta_patcher::varint(uint8_t b)
+{
+  if (shift == 0)
+  {
+    value = 0;
+  }
+  value |= (uint32_t)(b & 0x7f) << shift;
+  shift += 7;
+  if (b & 0x80)
+  {
+    return false;
+  }
+  shift = 0;
+  return true;
+}
+
+bool delta_patcher::source_byte(uint32_t pos, uint8_t *b)
+{
+  if (pos >= h.source_size)
+  {
+    return false;
+  }
+  if (pos < source_buf_start || pos >= source_buf_start + source_buf_len)
+  {
+    source_buf_start = pos;
+    source_buf_len = h.source_size - pos < sizeof(source_buf) ? h.source_size - pos : sizeof(source_buf);
+    if (!io.read_source(pos, source_buf, source_buf_len))
+    {
+      source_buf_len = 0;
+      status = DELTA_IO_ERROR;
+      return false;
+    }
+  }
+  *b = source_buf[pos - source_buf_start];
+  return true;
+}
+
+bool delta_patcher::output(uint8_t b)
+{
+  if (target_pos >= h.target_size)
+  {
+    return false;
+  }
+  out_buf[out_fill++] = b;
+  target_pos++;
+  return out_fill < sizeof(out_buf) || flush();
+}
+
+bool delta_patcher::flush()
+{
+  if (!out_fill)
+  {
+    return true;
+  }
+  target_crc = bundle_crc32(target_crc, out_buf, out_fill);
+  if (!io.write_target(out_buf, out_fill))
+  {
+    status = DELTA_IO_ERROR;
+    return false;
+  }
+  out_fill = 0;
+  return true;
+}
+
+delta_result delta_patcher::check_source()
+{
+  uint32_t crc = 0;
+  for (uint32_t pos = 0; pos < h.source_size; pos += sizeof(source_buf))
+  {
+    size_t len = h.source_size - pos < sizeof(source_buf) ? h.source_size - pos : sizeof(source_buf);
+    if (!io.read_source(pos, source_buf, len))
+    {
+      return DELTA_IO_ERROR;
+    }
+    crc = bundle_crc32(crc, source_buf, len);
+  }
+  source_buf_len = 0;
+  return crc == h.source_crc ? DELTA_MORE : DELTA_WRONG_SOURCE;
+}
+
+delta_result delta_patcher::step(uint8_t b)
+{
+  // io failures set status themselves, anything else wrong is the patch
+  delta_result bad = DELTA_CORRUPT;
+  uint8_t s;
+  switch (state)
+  {
+  case HEADER:
+    ((uint8_t *)&h)[header_fill++] = b;
+    if (header_fill < sizeof(h))
+    {
+      return DELTA_MORE;
+    }
+    if (memcmp(h.magic, DELTA_MAGIC, sizeof(h.magic)) || h.version != DELTA_VERSION)
+    {
+      return DELTA_BAD_HEADER;
+    }
+    state = OP;
+    return check_source();
+
+  case OP:
+    shift = 0;
+    if (b == DELTA_END)
+    {
+      if (!flush())
+      {
+        return status;
+      }
+      state = FINISHED;
+      return target_pos == h.target_size && target_crc == h.target_crc ? DELTA_DONE : bad;
+    }
+    if (b == DELTA_DIFF)
+    {
+      state = DIFF_LEN;
+      return DELTA_MORE;
+    }
+    if (b == DELTA_EXTRA)
+    {
+      state = EXTRA_LEN;
+      return DELTA_MORE;
+    }
+    return bad;
+
+  case DIFF_LEN:
+  case EXTRA_LEN:
+    if (!varint(b))
+    {
+      return shift > 28 ? bad : DELTA_MORE;
+    }
+    if (value > h.target_size - target_pos)
+    {
+      return bad;
+    }
+    remaining = value;
+    state = state == EXTRA_LEN ? (remaining ? EXTRA_BYTES : OP) : DIFF_SKIP;
+    return DELTA_MORE;
+
+  case DIFF_SKIP:
+    if (!varint(b))
+    {
+      return shift > 28 ? bad : DELTA_MORE;
+    }
+    source_pos += (int32_t)((value >> 1) ^ (0 - (value & 1)));
+    state = remaining ? DIFF_ZEROS : OP;
+    return DELTA_MORE;
+
+  case DIFF_ZEROS:
+    if (!varint(b))
+    {
+      return shift > 28 ? bad : DELTA_MORE;
+    }
+    if (value > remaining)
+    {
+      return bad;
+    }
+    for (run = value; run; --run, --remaining)
+    {
+      if (!source_byte(source_pos++, &s) || !output(s))
+      {
+        return status == DELTA_MORE ? bad : status;
+      }
+    }
+    state = remaining ? DIFF_LITERAL_COUNT : OP;
+    return DELTA_MORE;
+
+  case DIFF_LITERAL_COUNT:
+    if (!varint(b))
+    {
+      return shift > 28 ? bad : DELTA_MORE;
+    }
+    if (!value || value > remaining)
+    {
+      return bad;
+    }
+    run = value;
+    state = DIFF_LITERALS;
+    return DELTA_MORE;
+
+  case DIFF_LITERALS:
+    if (!source_byte(source_pos++, &s) || !output(s + b))
+    {
+      return status == DELTA_MORE ? bad : status;
+    }
+    --remaining;
+    if (!--run)
+    {
+      state = remaining ? DIFF_ZEROS : OP;
+    }
+    return DELTA_MORE;
+
+  case EXTRA_BYTES:
+    if (!output(b))
+    {
+      return status == DELTA_MORE ? bad : status;
+    }
+    if (!--remaining)
+    {
+      state = OP;
+    }
+    return DELTA_MORE;
+
+  case FINISHED:
+    break;
+  }
+  return bad;
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Binary patch from one app image to the next, made by tools/deltac and
+// served with DELTA_CONTENT_TYPE from the OTA url instead of the image.
+// Since that url names the running image, the server knows the source.
+//
+// A delta_header, then ops, each a byte followed by LEB128 varints:
+//   DELTA_DIFF len skip: move the source position by zigzag(skip), then for
+//     len bytes output source + diff (mod 256). The diff is coded as pairs of
+//     runs, [zeros][n][n literal diff bytes], the last pair may stop after
+//     its zeros. Moved code mostly differs in the odd address, so this is
+//     where releases get small.
+//   DELTA_EXTRA len, len bytes: output them as they are
+//   DELTA_END
+// The crcs are CRC-32 (bundle_crc32) of the whole source and target.
+#define DELTA_MAGIC "CTDP"
+#define DELTA_VERSION 1
+#define DELTA_CONTENT_TYPE "application/vnd.clockthing.delta"
+
+enum delta_op
+{
+  DELTA_END,
+  DELTA_DIFF,
+  DELTA_EXTRA,
+};
+
+struct delta_header
+{
+  char magic[4];
+  uint32_t version;
+  uint32_t source_size;
+  uint32_t source_crc;
+  uint32_t target_size;
+  uint32_t target_crc;
+};
+
+static_assert(sizeof(delta_header) == 24, "delta header layout");
+
+enum delta_result
+{
+  DELTA_MORE, // give it more patch
+  DELTA_DONE, // target complete and checked
+  DELTA_BAD_HEADER,
+  DELTA_WRONG_SOURCE,
+  DELTA_CORRUPT,
+  DELTA_IO_ERROR,
+};
+
+// where the patcher reads the source and writes the target; the target is
+// written in order, in pieces of up to DELTA_OUT_BUFFER bytes
+struct delta_io
+{
+  virtual bool read_source(uint32_t offset, uint8_t *buf, size_t len) = 0;
+  virtual bool write_target(const uint8_t *buf, size_t len) = 0;
+};
+
+#define DELTA_SOURCE_BUFFER 256
+#define DELTA_OUT_BUFFER 256
+
+// Applies a patch as it arrives, in whatever pieces: RAM use is this object,
+// not the image size. The source crc is checked once the header is in
+// (io.read_source over all of it), the target crc at the end.
+class delta_patcher
+{
+public:
+  delta_patcher(delta_io &io);
+  delta_result feed(const uint8_t *data, size_t len);
+  const delta_header &header() const { return h; }
+  uint32_t written() const { return target_pos; }
+
+protected:
+  enum parse_state
+  {
+    HEADER,
+    OP,
+    DIFF_LEN,
+    DIFF_SKIP,
+    DIFF_ZEROS,
+    DIFF_LITERAL_COUNT,
+    DIFF_LITERALS,
+    EXTRA_LEN,
+    EXTRA_BYTES,
+    FINISHED,
+  };
+
+  delta_result step(uint8_t b);
+  bool varint(uint8_t b);
+  bool source_byte(uint32_t pos, uint8_t *b);
+  bool output(uint8_t b);
+  bool flush();
+  delta_result check_source();
+
+  delta_io &io;
+  delta_header h;
+  parse_state state;
+  delta_result status;
+  size_t header_fill;
+  uint32_t value; // varint being read
+  int shift;
+  uint32_t remaining; // of the current op
+  uint32_t run;       // zeros or literals left in the current run
+  uint32_t source_pos;
+  uint32_t target_pos;
+  uint32_t target_crc;
+  uint8_t source_buf[DELTA_SOURCE_BUFFER];
+  uint32_t source_buf_start;
+  size_t source_buf_len;
+  uint8_t out_buf[DELTA_OUT_BUFFER];
+  size_t out_fill;
+};
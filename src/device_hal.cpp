@@ -0,0 +1,95 @@
+#include "config.h"
+#include "device_hal.h"
+#include <WiFi.h>
+#include <esp_sntp.h>
+#include <esp_timer.h>
+
+int64_t watch_clock::mono_us()
+{
+  return esp_timer_get_time();
+}
+
+void watch_clock::sleep_ms(uint32_t ms)
+{
+  vTaskDelay(ms / portTICK_PERIOD_MS);
+}
+
+bool watch_rtc::present()
+{
+  return ttgo->deviceProbe(0x51);
+}
+
+void watch_rtc::read(struct tm &t)
+{
+  RTC_Date now = ttgo->rtc->getDateTime();
+  bzero(&t, sizeof(t));
+  t.tm_sec = now.second;
+  t.tm_min = now.minute;
+  t.tm_hour = now.hour;
+  t.tm_mday = now.day;
+  t.tm_mon = now.month - 1;
+  t.tm_year = now.year - 1900;
+}
+
+void watch_rtc::write(const struct tm &t)
+{
+  RTC_Date now(t.tm_year + 1900, t.tm_mon + 1, t.tm_mday, t.tm_hour, t.tm_min, t.tm_sec);
+  ttgo->rtc->setDateTime(now);
+}
+
+void watch_display::set_backlight(uint8_t level)
+{
+  ttgo->setBrightness(level);
+}
+
+bool watch_network::connected()
+{
+  return WiFi.status() == WL_CONNECTED;
+}
+
+uint32_t watch_network::ntp_interval_ms()
+{
+  return sntp_get_sync_interval();
+}
+
+bool watch_network::web_portal_active()
+{
+  return manager.getWebPortalActive();
+}
+
+bool watch_network::config_portal_active()
+{
+  return manager.getConfigPortalActive();
+}
+
+void watch_network::stop_web_portal()
+{
+  manager.stopWebPortal();
+}
+
+void watch_network::portal_info(bool config, char *ssid, size_t ssid_len, char *url, size_t url_len)
+{
+  strlcpy(ssid, config ? manager.getConfigPortalSSID().c_str() : manager.getWiFiSSID().c_str(), ssid_len);
+  snprintf(url, url_len, "http://%s", (config ? WiFi.softAPIP() : WiFi.localIP()).toString().c_str());
+}
+
+size_t watch_storage::load(const char *key, void *buf, size_t len)
+{
+  return prefs.getBytes(key, buf, len);
+}
+
+void watch_storage::store(const char *key, const void *buf, size_t len)
+{
+  prefs.putBytes(key, buf, len);
+}
+
+void watch_buzzer::begin()
+{
+  ledcSetup(BUZZER_CHANNEL, BUZZER_FREQ, 8);
+  ledcAttachPin(BUZZER_PIN, BUZZER_CHANNEL);
+}
+
+void watch_buzzer::tone(uint8_t duty)
+{
+  ledcWrite(BUZZER_CHANNEL, duty);
+}
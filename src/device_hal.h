@@ -0,0 +1,71 @@
+#pragma once
+
+#include <Preferences.h>
+#include <WiFiManager.h>
+#include "hal.h"
+#include "face.h"
+
+// hal.h on the watch: esp_timer, the PCF8563, the LVGL face on the
+// ILI9481, WiFi and WiFiManager's portals, NVS and the buzzer on GPIO 33.
+
+class TTGOClass;
+
+struct watch_clock : hal_clock
+{
+  int64_t mono_us();
+  void sleep_ms(uint32_t ms);
+};
+
+struct watch_rtc : hal_rtc
+{
+  TTGOClass *&ttgo;
+  watch_rtc(TTGOClass *&ttgo) : ttgo(ttgo)
+  {
+  }
+  bool present();
+  void read(struct tm &t);
+  void write(const struct tm &t);
+};
+
+struct watch_display : lvgl_face
+{
+  TTGOClass *&ttgo;
+  watch_display(TTGOClass *&ttgo) : ttgo(ttgo)
+  {
+  }
+  void set_backlight(uint8_t level);
+};
+
+struct watch_network : hal_network
+{
+  WiFiManager &manager;
+  watch_network(WiFiManager &manager) : manager(manager)
+  {
+  }
+  bool connected();
+  uint32_t ntp_interval_ms();
+  bool web_portal_active();
+  bool config_portal_active();
+  void stop_web_portal();
+  void portal_info(bool config, char *ssid, size_t ssid_len, char *url, size_t url_len);
+};
+
+struct watch_storage : hal_storage
+{
+  Preferences &prefs;
+  watch_storage(Preferences &prefs) : prefs(prefs)
+  {
+  }
+  size_t load(const char *key, void *buf, size_t len);
+  void store(const char *key, const void *buf, size_t len);
+};
+
+#define BUZZER_PIN 33
+#define BUZZER_CHANNEL 1
+#define BUZZER_FREQ 1046
+
+struct watch_buzzer : hal_buzzer
+{
+  void begin();
+  void tone(uint8_t duty);
+};
@@ -0,0 +1,111 @@
+#include "discipline.h"
+#include <string.h>
+
+// how much each new rate measurement moves the estimate
+#define RATE_WEIGHT 4
+
+static int32_t blend(int32_t estimate, uint16_t samples, int64_t measured)
+{
+  if (!samples)
+  {
+    return measured;
+  }
+  return estimate + (measured - estimate) / RATE_WEIGHT;
+}
+
+void clock_discipline::begin(const discipline_saved &s, int64_t mono)
+{
+  saved = s;
+  synced = false;
+  last_mono = last_true = 0;
+  corrected_mono = mono;
+  rtc_unchecked = false;
+  rtc_boot_raw = rtc_boot_mono = 0;
+}
+
+int64_t clock_discipline::rtc_boot(int64_t rtc, int64_t mono)
+{
+  rtc_unchecked = true;
+  rtc_boot_raw = rtc;
+  rtc_boot_mono = mono;
+  if (!saved.rtc_samples || !saved.rtc_set_at || rtc < saved.rtc_set_at)
+  {
+    return rtc;
+  }
+  // time elapsed by the RTC over its rate gives what really elapsed
+  return rtc - (rtc - saved.rtc_set_at) * saved.rtc_ppb / 1000000000LL;
+}
+
+int64_t clock_discipline::sample(int64_t mono, int64_t ntp, int64_t sys, bool *step)
+{
+  int64_t offset = ntp - sys;
+  if (synced && mono - last_mono >= DRIFT_MIN_INTERVAL_US)
+  {
+    int64_t elapsed = ntp - last_true;
+    int64_t ppb = (mono - last_mono - elapsed) * 1000000000LL / elapsed;
+    if (ppb > -MAX_DRIFT_PPB && ppb < MAX_DRIFT_PPB)
+    {
+      saved.sys_ppb = blend(saved.sys_ppb, saved.sys_samples, ppb);
+      if (saved.sys_samples < UINT16_MAX)
+      {
+        saved.sys_samples++;
+      }
+    }
+  }
+  else if (synced)
+  {
+    // keep the older sample as the base until there's a long enough span
+    *step = offset > STEP_THRESHOLD_US || offset < -STEP_THRESHOLD_US;
+    return offset;
+  }
+
+  if (rtc_unchecked && saved.rtc_set_at)
+  {
+    // where the RTC really was at boot, going back by the (corrected) esp_timer
+    int64_t since_boot = mono - rtc_boot_mono;
+    int64_t true_boot = ntp - (since_boot - since_boot * saved.sys_ppb / 1000000000LL);
+    int64_t elapsed = true_boot - saved.rtc_set_at;
+    if (elapsed >= RTC_MIN_INTERVAL_US)
+    {
+      int64_t ppb = (rtc_boot_raw - saved.rtc_set_at - elapsed) * 1000000000LL / elapsed;
+      if (ppb > -MAX_DRIFT_PPB && ppb < MAX_DRIFT_PPB)
+      {
+        saved.rtc_ppb = blend(saved.rtc_ppb, saved.rtc_samples, ppb);
+        if (saved.rtc_samples < UINT16_MAX)
+        {
+          saved.rtc_samples++;
+        }
+      }
+    }
+  }
+
+  *step = !synced || offset > STEP_THRESHOLD_US || offset < -STEP_THRESHOLD_US;
+  rtc_unchecked = false;
+  synced = true;
+  last_mono = mono;
+  last_true = ntp;
+  corrected_mono = mono;
+  return offset;
+}
+
+int64_t clock_discipline::rate_correction(int64_t mono)
+{
+  int64_t due = (mono - corrected_mono) * saved.sys_ppb / 1000000000LL;
+  if (!due)
+  {
+    return 0;
+  }
+  // only hand out whole microseconds, the rest stays for next time
+  corrected_mono += due * 1000000000LL / saved.sys_ppb;
+  return -due;
+}
+
+void clock_discipline::rtc_written(int64_t t)
+{
+  saved.rtc_set_at = t;
+}
+
+uint32_t clock_discipline::interval_ms() const
+{
+  return saved.sys_samples >= 4 ? 6 * 3600 * 1000 : 3600 * 1000;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdint.h>
+
+// Learns how fast the system clock and the RTC run from NTP samples, so the
+// clock can keep time between syncs instead of jumping at each one. Times
+// are microseconds: mono is esp_timer (never adjusted), sys the system
+// clock, true times come from NTP. Rates are parts per billion, positive
+// when the clock runs fast.
+//
+// Nothing here touches hardware; main.cpp does the stepping, slewing and
+// RTC access, and tools/driftsim runs it against simulated clocks.
+
+// samples closer together than this say too little about rate
+#define DRIFT_MIN_INTERVAL_US (15 * 60 * 1000000LL)
+// the RTC has to have run this long since it was set to be worth measuring
+#define RTC_MIN_INTERVAL_US (6 * 3600 * 1000000LL)
+// larger errors are stepped, smaller slewed
+#define STEP_THRESHOLD_US 1000000LL
+// anything past this is a bad sample, not a crystal
+#define MAX_DRIFT_PPB 200000
+
+// persisted (Preferences key "d")
+struct discipline_saved
+{
+  int32_t sys_ppb;
+  int32_t rtc_ppb;
+  int64_t rtc_set_at; // true time the RTC was last written, 0 if never
+  uint16_t sys_samples;
+  uint16_t rtc_samples;
+  uint32_t reserved;
+};
+
+static_assert(sizeof(discipline_saved) == 24, "discipline_saved layout");
+
+struct clock_discipline
+{
+  discipline_saved saved;
+  bool synced; // had an NTP sample this boot
+  int64_t last_mono, last_true;
+  int64_t corrected_mono; // rate correction has been handed out up to here
+  bool rtc_unchecked; // the RTC was read at boot and no sample has checked it
+  int64_t rtc_boot_raw, rtc_boot_mono; // what it said, and when
+
+  void begin(const discipline_saved &s, int64_t mono);
+
+  // the time to start from, given the RTC read as its seconds turned over
+  int64_t rtc_boot(int64_t rtc, int64_t mono);
+
+  // An NTP sample: true time ntp at mono, while the system clock said sys.
+  // Returns the offset to apply; *step says to set the clock rather than
+  // slew it.
+  int64_t sample(int64_t mono, int64_t ntp, int64_t sys, bool *step);
+
+  // the slew that makes up for the system clock's rate since the last call
+  int64_t rate_correction(int64_t mono);
+
+  void rtc_written(int64_t t);
+
+  // how often NTP is needed for sub-second time, longer once the rate is known
+  uint32_t interval_ms() const;
+};
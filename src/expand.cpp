@@ -0,0 +1,159 @@
+#include "expand.h"
+#include <tuple>
+#include <algorithm>
+#include "tzhash.h"
+
+#define STARTS_WITH(l, s) (strncmp((l), (s), sizeof(s) - 1) == 0)
+
+// Passes the feed through, loading each zone a line names before uICAL
+// gets to the line. A VTIMEZONE's own TZID counts as naming it, so the
+// feed's definition isn't shadowed.
+class ZoneSniffer : public uICAL::istream
+{
+public:
+  ZoneSniffer(uICAL::istream &inner, uICAL::TZMap_ptr &tzmap, zone_lookup *zones)
+      : inner(inner), tzmap(tzmap), zones(zones)
+  {
+  }
+
+  char peek() const { return inner.peek(); }
+  char get() { return inner.get(); }
+  bool readuntil(uICAL::string &st, char delim)
+  {
+    bool ret = inner.readuntil(st, delim);
+    if (zones)
+    {
+      line(st.c_str());
+    }
+    return ret;
+  }
+
+protected:
+  void line(const char *l);
+  void name(const char *tzid, size_t len, bool defined);
+
+  uICAL::istream &inner;
+  uICAL::TZMap_ptr &tzmap;
+  zone_lookup *zones;
+};
+
+zone_lookup::zone_lookup(zone_loader load) : load(load), lookups(0), hashed(tzhash_keys())
+{
+}
+
+bool zone_lookup::first_time(const char *tzid)
+{
+  ++lookups;
+  int key = tzhash_find(tzid);
+  if (key >= 0)
+  {
+    bool first = !hashed[key];
+    hashed[key] = true;
+    return first;
+  }
+  if (std::find(named.begin(), named.end(), tzid) != named.end())
+  {
+    return false;
+  }
+  named.push_back(tzid);
+  return true;
+}
+
+void ZoneSniffer::name(const char *tzid, size_t len, bool defined)
+{
+  while (len && (tzid[len - 1] == '\r' || tzid[len - 1] == ' '))
+  {
+    --len;
+  }
+  char id[96];
+  if (!len || len >= sizeof(id))
+  {
+    return;
+  }
+  memcpy(id, tzid, len);
+  id[len] = 0;
+  if (zones->first_time(id) && !defined && !zones->load(id, tzmap))
+  {
+    Serial.printf("no zone %s\n", id);
+  }
+}
+
+void ZoneSniffer::line(const char *l)
+{
+  if (STARTS_WITH(l, "TZID:"))
+  {
+    name(l + 5, strlen(l + 5), true);
+    return;
+  }
+  if (STARTS_WITH(l, "X-WR-TIMEZONE:"))
+  {
+    name(l + 14, strlen(l + 14), false);
+    return;
+  }
+  // parameters, up to the first : that isn't quoted
+  bool quoted = false;
+  for (const char *p = l; *p && (quoted || *p != ':'); ++p)
+  {
+    if (*p == '"')
+    {
+      quoted = !quoted;
+    }
+    else if (!quoted && STARTS_WITH(p, ";TZID="))
+    {
+      p += 6;
+      const char *stop = *p == '"' ? strchr(++p, '"') : strpbrk(p, ";:");
+      name(p, stop ? stop - p : strlen(p), false);
+      return;
+    }
+  }
+}
+
+uICAL::Calendar_ptr expand_calendar(uICAL::istream &istm, uICAL::TZMap_ptr &tzmap, time_t begin, time_t end,
+                                    const event_filter &filter, alarm_collector &alarms, filter_stats &stats,
+                                    zone_lookup *zones)
+{
+  ZoneSniffer named(istm, tzmap, zones);
+  ValarmSniffer sniffer(named);
+  return uICAL::Calendar::load(sniffer, tzmap, [&](const uICAL::VEvent &event)
+                               {
+    vTaskDelay(1);
+    ++stats.seen;
+    if (!filter.accept(sniffer))
+    {
+      ++stats.dropped;
+      return false;
+    }
+    ++stats.kept;
+    expand_event_alarms(event, sniffer, begin, end, alarms);
+    return false; });
+}
+
+size_t record_offsets(const uICAL::Calendar_ptr &cal, time_t now, tz_offset *offsets, size_t max)
+{
+  auto current_offset = cal->tz()->fromUTC(now);
+
+  offsets[0].start = now;
+  offsets[0].offset = std::get<0>(current_offset) - now;
+  strncpy((char *)offsets[0].buffer, std::get<1>(current_offset).c_str(), sizeof(offsets[0].buffer) - 1);
+  offsets[0].buffer[sizeof(offsets[0].buffer) - 1] = 0;
+  size_t count = 1;
+  while (count < max)
+  {
+    auto next_offset = cal->tz()->next_transition_UTC(offsets[count - 1].start);
+    if (std::get<0>(next_offset) == MAX_UICAL_SECONDS)
+    {
+      break;
+    }
+    offsets[count].start = std::get<0>(next_offset);
+    offsets[count].offset = std::get<1>(next_offset);
+    strncpy((char *)offsets[count].buffer, std::get<2>(next_offset).c_str(), sizeof(offsets[0].buffer) - 1);
+    offsets[count].buffer[sizeof(offsets[0].buffer) - 1] = 0;
+    ++count;
+  }
+
+  if (count == 1 && offsets[0].offset == 0 && offsets[0].buffer[0] == 'Z' && offsets[0].buffer[1] == 0)
+  {
+    count = 0;
+  }
+  return count;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <Arduino.h>
+#include <uICal.h>
+#include <vector>
+#include "state.h"
+#include "valarm.h"
+#include "filter.h"
+
+// how far ahead alarms are expanded
+#define EXPAND_DAYS 7
+
+// adds the zone named tzid to tzmap; false if there's no such zone
+typedef bool (*zone_loader)(const char *tzid, uICAL::TZMap_ptr &tzmap);
+
+// Zones for a TZMap, loaded one at a time as the calendars parsed into it
+// name them (TZID=, X-WR-TIMEZONE) without defining them first. Keep one
+// for as long as its TZMap, so each zone is only loaded once.
+struct zone_lookup
+{
+  zone_lookup(zone_loader load);
+
+  // false if tzid was named before; names in the zone hash are
+  // looked up in it, others in named
+  bool first_time(const char *tzid);
+
+  zone_loader load;
+  size_t lookups;
+  std::vector<bool> hashed;         // by tzhash_find() key
+  std::vector<uICAL::string> named; // the rest
+};
+
+// parses one VCALENDAR from istm, adding the alarms within [begin, end) of
+// events that pass the filter to alarms and counting them in stats; zones
+// fills tzmap as the feed needs, if given
+uICAL::Calendar_ptr expand_calendar(uICAL::istream &istm, uICAL::TZMap_ptr &tzmap, time_t begin, time_t end,
+                                    const event_filter &filter, alarm_collector &alarms, filter_stats &stats,
+                                    zone_lookup *zones = NULL);
+
+// fills offsets with the calendar's offset at now and the transitions after
+// it; returns how many, 0 for a calendar in plain UTC
+size_t record_offsets(const uICAL::Calendar_ptr &cal, time_t now, tz_offset *offsets, size_t max);
@@ -0,0 +1,66 @@
+#include "face.h"
+
+void lvgl_face::create()
+{
+  lv_style_init(&my_style);
+  lv_style_init(&time_style);
+  lv_style_init(&date_style);
+  lv_style_init(&alarm_style);
+
+  lv_style_set_text_font(&my_style, LV_STATE_DEFAULT, &lv_font_montserrat_28);
+  lv_style_set_text_font(&time_style, LV_STATE_DEFAULT, &dseg_175);
+  lv_style_set_text_font(&date_style, LV_STATE_DEFAULT, &lv_font_montserrat_48);
+  lv_style_set_text_font(&alarm_style, LV_STATE_DEFAULT, &lv_font_montserrat_38);
+
+  lv_style_set_bg_color(&my_style, LV_STATE_DEFAULT, LV_COLOR_BLACK);
+  lv_style_set_text_color(&my_style, LV_STATE_DEFAULT, LV_COLOR_WHITE);
+  color = FACE_WHITE;
+
+  lv_obj_add_style(lv_scr_act(), LV_OBJ_PART_MAIN, &my_style);
+  for (int i = 0; i < NUM_FACE_LABELS; ++i)
+  {
+    labels[i] = lv_label_create(lv_scr_act(), NULL);
+  }
+  lv_obj_add_style(labels[FACE_TIME], LV_OBJ_PART_MAIN, &time_style);
+  lv_obj_set_pos(labels[FACE_TIME], -102, 10);
+  lv_obj_set_pos(labels[FACE_TZ], 80, 185);
+  lv_obj_set_pos(labels[FACE_AM], 261, 185);
+  lv_obj_set_pos(labels[FACE_PM], 399, 185);
+  lv_obj_add_style(labels[FACE_DATE], LV_OBJ_PART_MAIN, &date_style);
+  lv_obj_set_pos(labels[FACE_DATE], 40, 214);
+  lv_obj_add_style(labels[FACE_ALARM], LV_OBJ_PART_MAIN, &alarm_style);
+  lv_obj_set_pos(labels[FACE_ALARM], 0, 282);
+  lv_obj_set_pos(labels[FACE_WARNING], 480, 289);
+}
+
+void lvgl_face::set_text(face_label label, const char *text)
+{
+  // setting the same text again would still redraw it
+  if (strcmp(lv_label_get_text(labels[label]), text) == 0)
+  {
+    return;
+  }
+  lv_label_set_text(labels[label], text);
+  if (label == FACE_WARNING)
+  {
+    // the symbols are 3 bytes of UTF-8 each
+    lv_obj_set_pos(labels[label], 480 - ((strlen(text) / 3) * 30), 289);
+  }
+}
+
+void lvgl_face::set_color(face_color c)
+{
+  if (c == color)
+  {
+    return;
+  }
+  color = c;
+  lv_style_set_text_color(&my_style, LV_STATE_DEFAULT,
+                          c == FACE_GREEN ? LV_COLOR_GREEN : c == FACE_RED ? LV_COLOR_RED : LV_COLOR_WHITE);
+  lv_obj_report_style_mod(&my_style);
+}
+
+void lvgl_face::refresh()
+{
+  lv_task_handler();
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "lvgl/lvgl.h"
+#include "hal.h"
+
+// The clock face as LVGL objects on the active screen, 480x320: the big
+// time in dseg_175, zone and AM/PM above the date, the alarm line, and
+// warning symbols in the corner. Only set_backlight is left to the board.
+class lvgl_face : public hal_display
+{
+public:
+  // builds the objects; LVGL and its display driver are already up
+  void create();
+
+  void set_text(face_label label, const char *text);
+  void set_color(face_color color);
+  void refresh();
+
+protected:
+  lv_obj_t *labels[NUM_FACE_LABELS];
+  lv_style_t my_style, time_style, date_style, alarm_style;
+  int color;
+};
@@ -0,0 +1,591 @@
+#include "feedcache.h"
+#include <SPIFFS.h>
+#include <vector>
+#include "bundle.h"
+#include "expand.h"
+#include "istream_record.h"
+#include "tzdb.h"
+
+#define STARTS_WITH(l, s) (strncmp((l), (s), sizeof(s) - 1) == 0)
+
+// one-off events are kept until this long after they start or end, for
+// triggers after them and for offsets from UTC
+#define KEEP_PAST_DAYS 2
+
+// what valarm.cpp, the filter and uICAL read of an event
+static const char *const kept_properties[] = {
+    "BEGIN", "END", "UID", "DTSTART", "DTEND", "DURATION", "RRULE", "RDATE", "EXDATE", "EXRULE",
+    "RECURRENCE-ID", "SUMMARY", "CATEGORIES", "TRANSP", "STATUS", "TRIGGER", "ACTION",
+};
+
+// components outside VEVENTs that nothing reads
+static const char *const skipped_components[] = {"VTODO", "VJOURNAL", "VFREEBUSY"};
+
+// the state on SPIFFS is brought up to date when the window has moved on
+// this far
+#define STATE_SAVE_INTERVAL 86400
+
+// what feedcache_state describes, for each feed, in RAM
+struct expansion
+{
+  bool valid;
+  uint32_t cache_crc, filter_crc;
+  time_t parsed_at; // of the feed_status alarms it goes with
+  time_t end;
+  time_t saved_end; // of the state on SPIFFS, 0 if it's older
+  std::vector<feedcache_series> series;
+};
+
+static expansion expansions[MAX_FEEDS];
+
+static void cache_path(char *out, size_t len, size_t feed, const char *ext)
+{
+  snprintf(out, len, "/feed%u.%s", feed, ext);
+}
+
+static uint32_t url_crc(const char *url)
+{
+  return bundle_crc32(0, url, strlen(url));
+}
+
+// the YYYYMMDD a DATE or DATE-TIME value starts with, "" if it doesn't
+static void value_date(const char *l, char *out)
+{
+  const char *p = strrchr(l, ':');
+  out[0] = 0;
+  if (!p || strspn(p + 1, "0123456789") < 8)
+  {
+    return;
+  }
+  memcpy(out, p + 1, 8);
+  out[8] = 0;
+}
+
+feedcache_writer::feedcache_writer(uICAL::istream &inner, size_t feed, time_t now)
+    : kept(0), dropped(0), crc(0), inner(inner), feed(feed), now(now), taken_len(0), in_event(false)
+{
+  time_t t = now - 86400 * KEEP_PAST_DAYS;
+  strftime(cutoff, sizeof(cutoff), "%Y%m%d", gmtime(&t));
+  skipping[0] = 0;
+  char path[16];
+  cache_path(path, sizeof(path), feed, "tmp");
+  events = SPIFFS.open(path, "w");
+  cache_path(path, sizeof(path), feed, "cal");
+  calendar = SPIFFS.open(path, "w");
+  ok = events && calendar;
+}
+
+feedcache_writer::~feedcache_writer()
+{
+  discard();
+}
+
+char feedcache_writer::peek() const
+{
+  return inner.peek();
+}
+
+// uICAL takes the space folding a line with get(), then the rest of it
+char feedcache_writer::get()
+{
+  char c = inner.get();
+  if (c && taken_len < sizeof(taken) - 1)
+  {
+    taken[taken_len++] = c;
+  }
+  return c;
+}
+
+bool feedcache_writer::readuntil(uICAL::string &st, char delim)
+{
+  bool ret = inner.readuntil(st, delim);
+  if (!ret)
+  {
+    return ret;
+  }
+  if (taken_len)
+  {
+    taken[taken_len] = 0;
+    taken_len = 0;
+    String l = taken;
+    l += st.c_str();
+    line(l.c_str());
+  }
+  else
+  {
+    line(st.c_str());
+  }
+  return ret;
+}
+
+void feedcache_writer::write(File &file, const char *text, size_t len)
+{
+  crc = bundle_crc32(crc, text, len);
+  if (ok && file.write((const uint8_t *)text, len) != len)
+  {
+    Serial.println("feed cache: spiffs full");
+    ok = false;
+  }
+}
+
+void feedcache_writer::line(const char *l)
+{
+  size_t len = strcspn(l, "\r\n");
+  bool folded = l[0] == ' ' || l[0] == '\t';
+  if (skipping[0])
+  {
+    if (STARTS_WITH(l, "END:") && strncmp(l + 4, skipping, len - 4) == 0 && len - 4 == strlen(skipping))
+    {
+      skipping[0] = 0;
+    }
+    return;
+  }
+  if (!in_event)
+  {
+    if (STARTS_WITH(l, "BEGIN:VEVENT"))
+    {
+      in_event = true;
+      keep_property = true;
+      recurs = future_trigger = false;
+      last_date[0] = 0;
+      event = "BEGIN:VCALENDAR\n";
+      event += calendar_zone;
+      event += "BEGIN:VEVENT\n";
+      return;
+    }
+    for (const char *c : skipped_components)
+    {
+      if (STARTS_WITH(l, "BEGIN:") && strncmp(l + 6, c, len - 6) == 0 && len - 6 == strlen(c))
+      {
+        strlcpy(skipping, c, sizeof(skipping));
+        return;
+      }
+    }
+    if (STARTS_WITH(l, "X-WR-TIMEZONE"))
+    {
+      calendar_zone = String(l).substring(0, len) + "\n";
+    }
+    write(calendar, l, len);
+    write(calendar, "\n", 1);
+    return;
+  }
+
+  if (STARTS_WITH(l, "END:VEVENT"))
+  {
+    event += "END:VEVENT\nEND:VCALENDAR\n";
+    end_event();
+    in_event = false;
+    return;
+  }
+  if (!folded)
+  {
+    size_t name_len = strcspn(l, ";:");
+    keep_property = false;
+    for (const char *p : kept_properties)
+    {
+      if (name_len == strlen(p) && strncmp(l, p, name_len) == 0)
+      {
+        keep_property = true;
+        break;
+      }
+    }
+    if (STARTS_WITH(l, "RRULE") || STARTS_WITH(l, "RDATE"))
+    {
+      recurs = true;
+    }
+    else if (STARTS_WITH(l, "DTSTART") || STARTS_WITH(l, "DTEND"))
+    {
+      char date[9];
+      value_date(l, date);
+      if (!date[0])
+      {
+        future_trigger = true; // can't tell, keep it
+      }
+      else if (strcmp(date, last_date) > 0)
+      {
+        strcpy(last_date, date);
+      }
+    }
+    else if (STARTS_WITH(l, "TRIGGER"))
+    {
+      alarm_trigger t;
+      future_trigger |= parse_trigger(l, &t) && t.related == TRIGGER_ABSOLUTE && t.value >= now;
+    }
+  }
+  if (keep_property)
+  {
+    event += String(l).substring(0, len) + "\n";
+  }
+}
+
+void feedcache_writer::end_event()
+{
+  if (!recurs && !future_trigger && strcmp(last_date, cutoff) < 0)
+  {
+    ++dropped;
+    return;
+  }
+  feedcache_event h = {(uint32_t)event.length(), recurs ? FEEDCACHE_RECURS : 0u};
+  write(events, (const char *)&h, sizeof(h));
+  write(events, event.c_str(), event.length());
+  ++kept;
+}
+
+bool feedcache_writer::commit(const feed_status &f)
+{
+  char tmp_path[16], cal_path[16], path[16];
+  cache_path(tmp_path, sizeof(tmp_path), feed, "tmp");
+  cache_path(cal_path, sizeof(cal_path), feed, "cal");
+  cache_path(path, sizeof(path), feed, "fc");
+  if (!ok || in_event)
+  {
+    discard();
+    drop_old();
+    return false;
+  }
+
+  feedcache_trailer t;
+  bzero(&t, sizeof(t));
+  memcpy(t.magic, FEEDCACHE_MAGIC, sizeof(t.magic));
+  t.version = FEEDCACHE_VERSION;
+  t.url_crc = url_crc(f.url);
+  t.num_events = kept;
+  t.calendar_at = events.position();
+  strlcpy(t.etag, f.etag, sizeof(t.etag));
+  strlcpy(t.last_modified, f.last_modified, sizeof(t.last_modified));
+
+  calendar.close();
+  calendar = SPIFFS.open(cal_path, "r");
+  uint8_t buf[256];
+  size_t n;
+  while (ok && calendar && (n = calendar.read(buf, sizeof(buf))) > 0)
+  {
+    write(events, (const char *)buf, n);
+    t.calendar_length += n;
+  }
+  write(events, (const char *)&t, sizeof(t));
+  if (!ok)
+  {
+    discard();
+    drop_old();
+    return false;
+  }
+  events.close();
+  calendar.close();
+  SPIFFS.remove(cal_path);
+  drop_old();
+  if (!SPIFFS.rename(tmp_path, path))
+  {
+    return false;
+  }
+  Serial.printf("feed cache: %u events kept, %u past ones left out\n", kept, dropped);
+  return true;
+}
+
+void feedcache_drop(size_t feed)
+{
+  char path[16];
+  cache_path(path, sizeof(path), feed, "fc");
+  SPIFFS.remove(path);
+  cache_path(path, sizeof(path), feed, "st");
+  SPIFFS.remove(path);
+  expansions[feed].valid = false;
+}
+
+// the old cache is of an older parse than the alarms now in the feed, so
+// it goes whether or not this one made it
+void feedcache_writer::drop_old()
+{
+  feedcache_drop(feed);
+}
+
+void feedcache_writer::discard()
+{
+  char path[16];
+  if (events)
+  {
+    events.close();
+    cache_path(path, sizeof(path), feed, "tmp");
+    SPIFFS.remove(path);
+  }
+  if (calendar)
+  {
+    calendar.close();
+    cache_path(path, sizeof(path), feed, "cal");
+    SPIFFS.remove(path);
+  }
+  ok = false;
+}
+
+// the cache of feed, if it's of f's url
+static bool open_cache(const feed_status &f, size_t feed, File &file, feedcache_trailer &t)
+{
+  char path[16];
+  cache_path(path, sizeof(path), feed, "fc");
+  file = SPIFFS.open(path, "r");
+  if (!file)
+  {
+    return false;
+  }
+  size_t size = file.size();
+  if (size < sizeof(t) || !file.seek(size - sizeof(t)) || file.read((uint8_t *)&t, sizeof(t)) != sizeof(t) ||
+      memcmp(t.magic, FEEDCACHE_MAGIC, sizeof(t.magic)) != 0 || t.version != FEEDCACHE_VERSION ||
+      t.url_crc != url_crc(f.url) || t.calendar_at > size - sizeof(t) ||
+      t.calendar_length != size - sizeof(t) - t.calendar_at)
+  {
+    file.close();
+    return false;
+  }
+  return true;
+}
+
+// the zones and the calendar's own lines, which every event needs first
+static uICAL::Calendar_ptr read_calendar(File &file, const feedcache_trailer &t, uICAL::TZMap_ptr &tzmap,
+                                         zone_lookup &zones, time_t now, const event_filter &filter,
+                                         alarm_collector &alarms)
+{
+  filter_stats none = {0, 0, 0};
+  try
+  {
+    file.seek(t.calendar_at);
+    istream_record lines(file, t.calendar_length);
+    return expand_calendar(lines, tzmap, now, now, filter, alarms, none, &zones);
+  }
+  catch (uICAL::Error ex)
+  {
+    Serial.printf("feed cache: %s\n", ex.message.c_str());
+    return nullptr;
+  }
+}
+
+bool feedcache_expand_series(File &file, uint32_t at, uint32_t length, feedcache_series &s, uICAL::TZMap_ptr &tzmap,
+                             zone_lookup &zones, time_t begin, time_t horizon, const event_filter &filter,
+                             alarm_collector &alarms, filter_stats &stats)
+{
+  if (!file.seek(at))
+  {
+    return false;
+  }
+  alarms.horizon = horizon;
+  alarms.beyond = ALARM_NEVER;
+  alarms.latest = s.last;
+  bool ok = true;
+  try
+  {
+    istream_record record(file, length);
+    expand_calendar(record, tzmap, begin, horizon, filter, alarms, stats, &zones);
+  }
+  catch (uICAL::Error ex)
+  {
+    ok = false;
+  }
+  alarms.horizon = 0;
+  s.last = alarms.latest;
+  s.next = ok ? alarms.beyond : horizon; // a failed one is tried again
+  return ok;
+}
+
+// the series of the event record at s.at
+static bool expand_series(File &file, feedcache_series &s, uICAL::TZMap_ptr &tzmap, zone_lookup &zones,
+                          time_t begin, time_t horizon, const event_filter &filter, alarm_collector &alarms,
+                          filter_stats &stats)
+{
+  feedcache_event h;
+  if (!file.seek(s.at) || file.read((uint8_t *)&h, sizeof(h)) != sizeof(h))
+  {
+    return false;
+  }
+  return feedcache_expand_series(file, s.at + sizeof(h), h.length, s, tzmap, zones, begin, horizon, filter, alarms,
+                                 stats);
+}
+
+// the state saved, and the alarms it goes with into f, if it's of this
+// cache and filter
+static bool load_state(size_t feed, expansion &w, feed_status &f, uint32_t cache_crc, uint32_t filter_crc)
+{
+  char path[16];
+  cache_path(path, sizeof(path), feed, "st");
+  File file = SPIFFS.open(path, "r");
+  if (!file)
+  {
+    return false;
+  }
+  feedcache_state h;
+  bool ok = file.read((uint8_t *)&h, sizeof(h)) == sizeof(h) &&
+            memcmp(h.magic, FEEDCACHE_STATE_MAGIC, sizeof(h.magic)) == 0 && h.version == FEEDCACHE_STATE_VERSION &&
+            h.cache_crc == cache_crc && h.filter_crc == filter_crc && h.num_alarms < MAX_ALARMS &&
+            file.size() == sizeof(h) + h.num_alarms * sizeof(bundle_alarm) + h.num_series * sizeof(feedcache_series);
+  if (ok)
+  {
+    // the series first, so a short read doesn't leave f half done
+    w.series.resize(h.num_series);
+    file.seek(sizeof(h) + h.num_alarms * sizeof(bundle_alarm));
+    size_t size = h.num_series * sizeof(feedcache_series);
+    ok = file.read((uint8_t *)w.series.data(), size) == size;
+    file.seek(sizeof(h));
+    f.alarms.clear();
+  }
+  for (size_t i = 0; ok && i < h.num_alarms; ++i)
+  {
+    bundle_alarm a;
+    ok = file.read((uint8_t *)&a, sizeof(a)) == sizeof(a);
+    f.alarms.alarms[i].start = a.start;
+    memcpy(f.alarms.alarms[i].name, a.name, sizeof(f.alarms.alarms[i].name));
+    f.alarms.alarms[i].name[sizeof(f.alarms.alarms[i].name) - 1] = 0;
+    f.alarms.count = i + 1;
+  }
+  file.close();
+  if (!ok)
+  {
+    w.series.clear();
+    return false;
+  }
+  w.valid = true;
+  w.cache_crc = cache_crc;
+  w.filter_crc = filter_crc;
+  w.end = w.saved_end = h.end;
+  return true;
+}
+
+static void save_state(size_t feed, expansion &w, const feed_status &f)
+{
+  char tmp_path[16], path[16];
+  cache_path(tmp_path, sizeof(tmp_path), feed, "stn");
+  cache_path(path, sizeof(path), feed, "st");
+  File file = SPIFFS.open(tmp_path, "w");
+  if (!file)
+  {
+    return;
+  }
+  feedcache_state h;
+  bzero(&h, sizeof(h));
+  memcpy(h.magic, FEEDCACHE_STATE_MAGIC, sizeof(h.magic));
+  h.version = FEEDCACHE_STATE_VERSION;
+  h.num_alarms = f.alarms.count;
+  h.cache_crc = w.cache_crc;
+  h.filter_crc = w.filter_crc;
+  h.num_series = w.series.size();
+  h.end = w.end;
+  bool ok = file.write((const uint8_t *)&h, sizeof(h)) == sizeof(h);
+  for (size_t i = 0; ok && i < f.alarms.count; ++i)
+  {
+    bundle_alarm a;
+    bzero(&a, sizeof(a));
+    a.start = f.alarms.alarms[i].start;
+    memcpy(a.name, f.alarms.alarms[i].name, sizeof(a.name));
+    ok = file.write((const uint8_t *)&a, sizeof(a)) == sizeof(a);
+  }
+  size_t size = w.series.size() * sizeof(feedcache_series);
+  ok = ok && file.write((const uint8_t *)w.series.data(), size) == size;
+  file.close();
+  if (!ok)
+  {
+    SPIFFS.remove(tmp_path);
+    return;
+  }
+  SPIFFS.remove(path);
+  if (SPIFFS.rename(tmp_path, path))
+  {
+    w.saved_end = w.end;
+  }
+}
+
+bool feedcache_expand(feed_status &f, size_t feed, time_t now, const event_filter &filter)
+{
+  File file;
+  feedcache_trailer t;
+  if (!open_cache(f, feed, file, t))
+  {
+    return false;
+  }
+  expansion &w = expansions[feed];
+  uint32_t cache_crc = bundle_crc32(0, &t, sizeof(t));
+  uint32_t filter_crc = filter.crc();
+  bool ours = w.valid && w.cache_crc == cache_crc && w.filter_crc == filter_crc && f.parsed_at &&
+              f.parsed_at == w.parsed_at;
+  if (!ours)
+  {
+    w.valid = false;
+    ours = load_state(feed, w, f, cache_crc, filter_crc);
+  }
+
+  time_t end = now + 86400 * EXPAND_DAYS;
+  uICAL::TZMap_ptr tzmap = uICAL::new_ptr<uICAL::TZMap>();
+  zone_lookup zones(tzdb_load_zone);
+  // read even when no series is due: the offsets move on with now, and
+  // after a boot the state on SPIFFS doesn't have them
+  uICAL::Calendar_ptr cal = read_calendar(file, t, tzmap, zones, now, filter, f.alarms);
+  if (!cal)
+  {
+    file.close();
+    w.valid = false;
+    return false;
+  }
+  size_t expanded = 0;
+  int failed = 0;
+  if (ours)
+  {
+    // only the series with alarms in the window's new tail
+    f.alarms.drop_before(now);
+    filter_stats stats = {0, 0, 0};
+    for (feedcache_series &s : w.series)
+    {
+      if (s.next >= end || w.end >= end)
+      {
+        continue;
+      }
+      time_t begin = s.last >= w.end ? s.last + 1 : w.end;
+      failed += !expand_series(file, s, tzmap, zones, begin, end, filter, f.alarms, stats);
+      ++expanded;
+    }
+  }
+  else
+  {
+    f.alarms.clear();
+    bzero(&f.stats, sizeof(f.stats));
+    w.series.clear();
+    w.end = 0;
+    file.seek(0);
+    for (uint32_t i = 0; i < t.num_events; ++i)
+    {
+      feedcache_event h;
+      uint32_t at = file.position();
+      if (file.read((uint8_t *)&h, sizeof(h)) != sizeof(h) || file.position() > t.calendar_at ||
+          h.length > t.calendar_at - file.position())
+      {
+        break;
+      }
+      feedcache_series s = {at, 0, 0, 0};
+      failed += !expand_series(file, s, tzmap, zones, now, end, filter, f.alarms, f.stats);
+      w.series.push_back(s);
+      file.seek(at + sizeof(h) + h.length);
+    }
+    expanded = w.series.size();
+    w.valid = true;
+    w.cache_crc = cache_crc;
+    w.filter_crc = filter_crc;
+    w.saved_end = 0;
+  }
+  file.close();
+  Serial.printf("feed cache %u: %u of %u series expanded, %u alarms, failed %d\n", feed, expanded, w.series.size(),
+                f.alarms.count, failed);
+
+  f.num_offsets = record_offsets(cal, now, f.offsets, MAX_OFFSETS);
+  strlcpy(f.etag, t.etag, sizeof(f.etag));
+  strlcpy(f.last_modified, t.last_modified, sizeof(f.last_modified));
+  f.parsed_at = w.parsed_at = now;
+  if (w.end < end)
+  {
+    w.end = end;
+  }
+  if (f.alarms.count == MAX_ALARMS)
+  {
+    // alarms past the last kept were let go, so the next window starts over
+    w.valid = false;
+  }
+  else if (!w.saved_end || w.end - w.saved_end >= STATE_SAVE_INTERVAL)
+  {
+    save_state(feed, w, f);
+  }
+  return true;
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <Arduino.h>
+#include <FS.h>
+#include <uICal.h>
+#include "feeds.h"
+#include "expand.h"
+
+// The last good parse of each .ics feed, kept on SPIFFS so its alarms can
+// be expanded again without the network: at boot, and when the window
+// moves on at midnight. Only what expansion reads is kept. Events are cut
+// down to the properties valarm.cpp, the filter and uICAL look at, and
+// one-off events over before the window are left out.
+//
+// /feedN.fc holds each event as a record, a feedcache_event then one
+// VCALENDAR with just that event, so one bad event can't spoil the rest;
+// then the lines outside the events (VTIMEZONEs, X-WR-TIMEZONE) as one
+// VCALENDAR; then a feedcache_trailer.
+#define FEEDCACHE_MAGIC "FCH1"
+#define FEEDCACHE_VERSION 1
+
+// an event with RRULE or RDATE
+#define FEEDCACHE_RECURS 1
+
+struct feedcache_event
+{
+  uint32_t length; // of the text after this
+  uint32_t flags;
+};
+
+struct feedcache_trailer
+{
+  char magic[4];
+  uint16_t version;
+  uint16_t reserved;
+  uint32_t url_crc; // bundle_crc32() of the feed url
+  uint32_t num_events;
+  uint32_t calendar_at; // the lines outside the events
+  uint32_t calendar_length;
+  char etag[64]; // of the response parsed, for the next conditional fetch
+  char last_modified[40];
+};
+
+static_assert(sizeof(feedcache_trailer) == 128, "feed cache trailer layout");
+
+// How far each cached feed has been expanded, so a refresh only expands
+// the window's new tail, and only of the series with alarms in it. Each
+// event record is a series: the last alarm it gave, and the time before
+// which it has no other. Each is followed past the window to its next
+// alarm, however far off, so most are left alone until the window gets
+// there, and one that's run out is never looked at again.
+//
+// It's kept in RAM between refreshes, and in /feedN.st with the alarms it
+// goes with once a day, so a boot picks up where it left off: a
+// feedcache_state, its alarms as bundle_alarms, then its series.
+#define FEEDCACHE_STATE_MAGIC "FCS1"
+#define FEEDCACHE_STATE_VERSION 1
+
+struct feedcache_state
+{
+  char magic[4];
+  uint16_t version;
+  uint16_t num_alarms;
+  uint32_t cache_crc; // of the cache's trailer, so a new cache starts over
+  uint32_t filter_crc; // of the event_filter the alarms went through
+  uint32_t num_series;
+  uint32_t reserved;
+  int64_t end; // every alarm before this is in the alarms
+};
+
+static_assert(sizeof(feedcache_state) == 32, "feed cache state layout");
+
+struct feedcache_series
+{
+  uint32_t at; // its record, in the cache or a CalDAV index
+  uint32_t reserved;
+  int64_t last; // the latest alarm it gave, 0 for none yet
+  int64_t next; // it has no alarm before this, past those given
+};
+
+// expands the series in length bytes of file from at, begin up to horizon,
+// into alarms; notes in s the last alarm it gave and when it next has one
+// after, or ALARM_FOLLOW past horizon if it has none before that
+bool feedcache_expand_series(File &file, uint32_t at, uint32_t length, feedcache_series &s, uICAL::TZMap_ptr &tzmap,
+                             zone_lookup &zones, time_t begin, time_t horizon, const event_filter &filter,
+                             alarm_collector &alarms, filter_stats &stats);
+
+// Passes a feed through to uICAL unchanged while writing the cut down
+// copy to temporary files; commit() makes it the feed's cache once the
+// parse has gone through, and otherwise it's thrown away.
+class feedcache_writer : public uICAL::istream
+{
+public:
+  feedcache_writer(uICAL::istream &inner, size_t feed, time_t now);
+  ~feedcache_writer();
+
+  char peek() const;
+  char get();
+  bool readuntil(uICAL::string &st, char delim);
+
+  // f has the url, etag and last modified of what was parsed
+  bool commit(const feed_status &f);
+
+  uint32_t kept, dropped; // events
+  uint32_t crc; // of the cut down copy; the same feed served again gives the same
+
+protected:
+  void line(const char *l);
+  void end_event();
+  void write(File &file, const char *text, size_t len);
+  void discard();
+  void drop_old();
+
+  uICAL::istream &inner;
+  size_t feed;
+  time_t now;
+  char cutoff[9]; // events ending before this date (YYYYMMDD) aren't needed
+  File events, calendar;
+  bool ok;
+  char taken[4]; // what get() took of the next line, a fold's space
+  size_t taken_len;
+
+  String event; // the current event's record
+  String calendar_zone; // X-WR-TIMEZONE, repeated in each event's VCALENDAR
+  char skipping[16]; // a component nothing reads, VTODO or VJOURNAL
+  bool in_event, keep_property, recurs, future_trigger;
+  char last_date[9]; // the latest of DTSTART and DTEND
+};
+
+// Expands feed's cache, if it's of f's url, as fetch_feed() would have
+// expanded the feed at now; restores the etag and last modified with it.
+// If f's alarms came from here, or the state on SPIFFS is of this cache,
+// only the tail of the window past where they end is expanded. False, and
+// f untouched, if there's no such cache.
+bool feedcache_expand(feed_status &f, size_t feed, time_t now, const event_filter &filter);
+
+// forgets feed's cache and the state kept with it, for a feed whose alarms
+// now come from elsewhere (an alarm bundle)
+void feedcache_drop(size_t feed);
@@ -0,0 +1,477 @@
+#include "feeds.h"
+#include <HTTPClient.h>
+#include <esp_timer.h>
+#include <uICal.h>
+#include "caldav.h"
+#include "expand.h"
+#include "feedcache.h"
+#include "bundle.h"
+#include "tzdb.h"
+#include "tls.h"
+#include "tasks.h"
+#include "trace.h"
+
+feed_status feeds[MAX_FEEDS];
+
+extern SemaphoreHandle_t stateMutex; // main.cpp's, held while state changes
+
+static QueueHandle_t feed_queue;
+static SemaphoreHandle_t feed_done;
+// state's urls and filter as run_feeds() found them, for the workers; the
+// portal can change state's while they run
+static char feed_urls[MAX_FEEDS][FEED_URL_LEN];
+static event_filter feed_filter;
+static time_t feed_now;
+static bool feed_cached_only; // expand the SPIFFS copies instead of fetching
+static bool feed_expanded[MAX_FEEDS];
+static volatile bool feed_forget; // set by forget_feeds(), done by run_feeds()
+
+// a 304 keeps the previous expansion, moved on from the cached copy of the
+// feed if there is one, and otherwise sliding out of the window; past this
+// age without one we ask for the whole feed again
+#define MAX_UNCHANGED_AGE 86400
+
+static bool read_exactly(Stream &in, void *buf, size_t len)
+{
+  return in.readBytes((uint8_t *)buf, len) == len;
+}
+
+// what a fetch parses into, so a feed that doesn't parse keeps what it had
+struct parsed_feed
+{
+  alarm_collector alarms;
+  tz_offset offsets[MAX_OFFSETS];
+  size_t num_offsets;
+  filter_stats stats;
+  uint32_t crc; // of the body, or what the feed cache kept of it
+};
+
+// one per feed worker, too big for their stacks
+static parsed_feed parsed[MAX_FEEDS];
+
+// Alarms are read straight into p and only kept if the crc over all of
+// them matches; past MAX_ALARMS only the crc sees them.
+static feed_result load_bundle(parsed_feed &p, Stream &in, time_t now)
+{
+  bundle_header h;
+  bundle_offset offsets[BUNDLE_MAX_OFFSETS];
+  if (!read_exactly(in, &h, sizeof(h)) || !bundle_header_valid(h) ||
+      !read_exactly(in, offsets, h.num_offsets * sizeof(offsets[0])))
+  {
+    Serial.println("bad alarm bundle header");
+    return FEED_PARSE_ERROR;
+  }
+  uint32_t crc = bundle_crc32(0, offsets, h.num_offsets * sizeof(offsets[0]));
+
+  p.alarms.clear();
+  size_t keep = h.num_alarms < MAX_ALARMS ? h.num_alarms : MAX_ALARMS;
+  bool ok = true;
+  if (sizeof(alarm_entry) == sizeof(bundle_alarm) && sizeof(time_t) == sizeof(int64_t))
+  {
+    ok = read_exactly(in, p.alarms.alarms, keep * sizeof(bundle_alarm));
+    crc = bundle_crc32(crc, p.alarms.alarms, keep * sizeof(bundle_alarm));
+  }
+  else
+  {
+    for (size_t i = 0; ok && i < keep; ++i)
+    {
+      bundle_alarm a;
+      ok = read_exactly(in, &a, sizeof(a));
+      crc = bundle_crc32(crc, &a, sizeof(a));
+      p.alarms.alarms[i].start = a.start;
+      memcpy(p.alarms.alarms[i].name, a.name, sizeof(p.alarms.alarms[i].name));
+    }
+  }
+  for (size_t i = keep; ok && i < h.num_alarms; ++i)
+  {
+    bundle_alarm a;
+    ok = read_exactly(in, &a, sizeof(a));
+    crc = bundle_crc32(crc, &a, sizeof(a));
+  }
+  for (size_t i = 1; ok && i < keep; ++i)
+  {
+    ok = p.alarms.alarms[i - 1].start <= p.alarms.alarms[i].start;
+  }
+  if (!ok || crc != h.crc)
+  {
+    Serial.println("bad alarm bundle");
+    return FEED_PARSE_ERROR;
+  }
+  p.alarms.count = keep;
+  for (size_t i = 0; i < keep; ++i)
+  {
+    p.alarms.alarms[i].name[sizeof(p.alarms.alarms[i].name) - 1] = 0;
+  }
+
+  // the offset in effect now, and the transitions after it
+  size_t first = 0;
+  while (first + 1 < h.num_offsets && offsets[first + 1].start <= now)
+  {
+    ++first;
+  }
+  p.crc = h.crc;
+  p.num_offsets = 0;
+  for (size_t i = first; i < h.num_offsets && p.num_offsets < MAX_OFFSETS; ++i)
+  {
+    tz_offset &o = p.offsets[p.num_offsets++];
+    o.start = i == first ? now : offsets[i].start;
+    o.offset = offsets[i].offset;
+    memcpy(o.buffer, offsets[i].name, sizeof(o.buffer));
+    o.buffer[sizeof(o.buffer) - 1] = 0;
+  }
+  bzero(&p.stats, sizeof(p.stats));
+  p.stats.seen = p.stats.kept = h.num_alarms;
+  Serial.printf("alarm bundle: %u alarms, %u offsets\n", h.num_alarms, h.num_offsets);
+  return FEED_OK;
+}
+
+// a failed request, by what esp-tls saw of the connection
+static fetch_failure connect_failure(const TlsClient &tls)
+{
+  switch (tls.error)
+  {
+  case ESP_OK:
+  case ESP_ERR_ESP_TLS_FAILED_CONNECT_TO_HOST:
+  case ESP_ERR_ESP_TLS_CONNECTION_TIMEOUT:
+  case ESP_ERR_ESP_TLS_CANNOT_CREATE_SOCKET:
+    return FAIL_CONNECT;
+  case ESP_ERR_ESP_TLS_CANNOT_RESOLVE_HOSTNAME:
+    return FAIL_DNS;
+  default:
+    return FAIL_TLS;
+  }
+}
+
+static fetch_failure result_failure(const feed_status &f)
+{
+  switch (f.result)
+  {
+  case FEED_OK:
+  case FEED_UNCHANGED:
+  case FEED_NO_URL:
+    return FAIL_NONE;
+  case FEED_PARSE_ERROR:
+    return FAIL_PARSE;
+  default:
+    return f.http_code < 0 ? FAIL_CONNECT : FAIL_HTTP;
+  }
+}
+
+// takes a good parse, and the validators of the response it came from;
+// unchanged if it's what the last good parse had
+static feed_result keep_parsed(feed_status &f, const parsed_feed &p, HTTPClient &https, time_t now)
+{
+  feed_result result = f.parsed_at && p.crc == f.content_crc ? FEED_UNCHANGED : FEED_OK;
+  f.content_crc = p.crc;
+  f.alarms = p.alarms;
+  memcpy(f.offsets, p.offsets, sizeof(f.offsets));
+  f.num_offsets = p.num_offsets;
+  f.stats = p.stats;
+  strlcpy(f.etag, https.header("ETag").c_str(), sizeof(f.etag));
+  strlcpy(f.last_modified, https.header("Last-Modified").c_str(), sizeof(f.last_modified));
+  f.parsed_at = now;
+  return result;
+}
+
+static void fetch_feed(feed_status &f, const char *url, time_t now, const event_filter &filter)
+{
+  if (strncmp(f.url, url, sizeof(f.url)) != 0)
+  {
+    bzero(&f, sizeof(f));
+    strlcpy(f.url, url, sizeof(f.url));
+  }
+  if (url[0] == 0)
+  {
+    f.result = FEED_NO_URL;
+    return;
+  }
+  if (is_caldav_url(url))
+  {
+    f.result = caldav_sync(f, url, now, filter);
+    f.failure = result_failure(f);
+    return;
+  }
+
+  TlsClient tls;
+  HTTPClient https;
+  https.useHTTP10(true);
+
+  if (!http_begin(https, tls, url))
+  {
+    Serial.printf("https begin failed %s\n", url);
+    f.result = FEED_BEGIN_FAILED;
+    f.failure = FAIL_HTTP;
+    return;
+  }
+  const char *keys[] = {"ETag", "Last-Modified", "Content-Type"};
+  https.collectHeaders(keys, 3);
+  if (f.parsed_at && now - f.parsed_at < MAX_UNCHANGED_AGE)
+  {
+    if (f.etag[0])
+    {
+      https.addHeader("If-None-Match", f.etag);
+    }
+    if (f.last_modified[0])
+    {
+      https.addHeader("If-Modified-Since", f.last_modified);
+    }
+  }
+  trace_begin("request");
+  f.http_code = https.GET();
+  trace_end("request");
+
+  if (f.http_code == 304)
+  {
+    Serial.printf("feed unchanged %s\n", url);
+    // the same feed as cached, so only the window's new tail needs
+    // expanding; a bundle has no cache, and its alarms stand as they are
+    feedcache_expand(f, &f - feeds, now, filter);
+    f.result = FEED_UNCHANGED;
+    f.failure = FAIL_NONE;
+    return;
+  }
+  if (f.http_code != 200)
+  {
+    char buf[128];
+    snprintf(buf, sizeof(buf), "http code: %d", f.http_code);
+    Serial.println(buf);
+  }
+  if (f.http_code <= 0)
+  {
+    f.result = FEED_HTTP_ERROR;
+    f.failure = connect_failure(tls);
+    return;
+  }
+  if (f.http_code >= 300)
+  {
+    // an error page isn't a calendar; keep the alarms we have
+    f.result = FEED_HTTP_ERROR;
+    f.failure = FAIL_HTTP;
+    return;
+  }
+
+  parsed_feed &p = parsed[&f - feeds];
+  if (https.header("Content-Type").startsWith(BUNDLE_CONTENT_TYPE))
+  {
+    TRACE_SCOPE("bundle");
+    f.result = load_bundle(p, https.getStream(), now);
+    if (f.result == FEED_OK)
+    {
+      f.result = keep_parsed(f, p, https, now);
+      // a 304 or a boot mustn't expand a calendar this url served before
+      feedcache_drop(&f - feeds);
+    }
+    f.failure = result_failure(f);
+    return;
+  }
+
+  TRACE_SCOPE("parse");
+  try
+  {
+    uICAL::TZMap_ptr tzmap = uICAL::new_ptr<uICAL::TZMap>();
+    zone_lookup zones(tzdb_load_zone);
+    uICAL::istream_Stream istm(https.getStream());
+    feedcache_writer cache(istm, &f - feeds, now);
+    p.alarms.clear();
+    bzero(&p.stats, sizeof(p.stats));
+    uICAL::Calendar_ptr cal = expand_calendar(cache, tzmap, now, now + 86400 * EXPAND_DAYS, filter, p.alarms, p.stats, &zones);
+    Serial.printf("events seen %u kept %u dropped %u\n", p.stats.seen, p.stats.kept, p.stats.dropped);
+    p.num_offsets = record_offsets(cal, now, p.offsets, MAX_OFFSETS);
+
+    p.crc = cache.crc;
+    f.result = keep_parsed(f, p, https, now);
+    cache.commit(f);
+  }
+  catch (uICAL::Error ex)
+  {
+    // the alarms, offsets and validators of the last good parse still stand
+    char buf[128];
+    snprintf(buf, sizeof(buf), "%s: %s", ex.message.c_str(), "! Failed loading calendar");
+    Serial.println(buf);
+    f.result = FEED_PARSE_ERROR;
+  }
+  f.failure = result_failure(f);
+}
+
+// expands what's kept on SPIFFS of the feed at url, if it's of that url
+static bool expand_cached_feed(feed_status &f, const char *url, time_t now, const event_filter &filter)
+{
+  if (strncmp(f.url, url, sizeof(f.url)) != 0)
+  {
+    bzero(&f, sizeof(f));
+    strlcpy(f.url, url, sizeof(f.url));
+  }
+  if (url[0] == 0)
+  {
+    return true;
+  }
+  if (is_caldav_url(url))
+  {
+    return caldav_expand(f, url, now, filter);
+  }
+  return feedcache_expand(f, &f - feeds, now, filter);
+}
+
+static void feed_worker(void *)
+{
+  while (1)
+  {
+    size_t i;
+    xQueueReceive(feed_queue, &i, portMAX_DELAY);
+    TRACE_SCOPE("feed");
+    int64_t started = esp_timer_get_time();
+    if (feed_cached_only)
+    {
+      feed_expanded[i] = expand_cached_feed(feeds[i], feed_urls[i], feed_now, feed_filter);
+    }
+    else
+    {
+      fetch_feed(feeds[i], feed_urls[i], feed_now, feed_filter);
+      feeds[i].fetch_ms = (esp_timer_get_time() - started) / 1000;
+    }
+    xSemaphoreGive(feed_done);
+  }
+}
+
+void feeds_begin()
+{
+  feed_queue = xQueueCreate(MAX_FEEDS, sizeof(size_t));
+  feed_done = xSemaphoreCreateCounting(MAX_FEEDS, 0);
+  for (size_t i = 0; i < MAX_FEEDS; ++i)
+  {
+    char name[16];
+    snprintf(name, sizeof(name), "feed%u", i);
+    task_start(TASK_FEED, feed_worker, name);
+  }
+}
+
+// hands every feed to the workers and waits for them all
+static void run_feeds(time_t now, bool cached_only)
+{
+  char spec[sizeof(state.filter)];
+  xSemaphoreTake(stateMutex, portMAX_DELAY);
+  for (size_t i = 0; i < MAX_FEEDS; ++i)
+  {
+    strlcpy(feed_urls[i], state_feed_url(i), sizeof(feed_urls[i]));
+  }
+  strlcpy(spec, state.filter, sizeof(spec));
+  xSemaphoreGive(stateMutex);
+  if (!feed_filter.parse(spec))
+  {
+    Serial.printf("ignoring part of filter %s\n", spec);
+  }
+
+  // only here, with no worker running, can the urls change under nobody
+  if (feed_forget)
+  {
+    feed_forget = false;
+    for (size_t i = 0; i < MAX_FEEDS; ++i)
+    {
+      feeds[i].url[0] = 0;
+    }
+  }
+  feed_now = now;
+  feed_cached_only = cached_only;
+  for (size_t i = 0; i < MAX_FEEDS; ++i)
+  {
+    xQueueSend(feed_queue, &i, portMAX_DELAY);
+  }
+  for (size_t i = 0; i < MAX_FEEDS; ++i)
+  {
+    xSemaphoreTake(feed_done, portMAX_DELAY);
+  }
+}
+
+void forget_feeds()
+{
+  feed_forget = true;
+}
+
+void fetch_feeds(time_t now)
+{
+  run_feeds(now, false);
+  for (size_t i = 0; i < MAX_FEEDS; ++i)
+  {
+    if (feeds[i].result != FEED_NO_URL)
+    {
+      Serial.printf("feed %u result %d http %d %u ms\n", i, feeds[i].result, feeds[i].http_code, feeds[i].fetch_ms);
+    }
+  }
+}
+
+bool expand_cached_feeds(time_t now, bool &all)
+{
+  run_feeds(now, true);
+  bool any = false;
+  all = true;
+  for (size_t i = 0; i < MAX_FEEDS; ++i)
+  {
+    if (feed_urls[i][0] == 0)
+    {
+      continue;
+    }
+    if (!feed_expanded[i])
+    {
+      Serial.printf("feed %u has nothing cached\n", i);
+    }
+    // a bundle can't be expanded again, but what it gave still stands
+    bool has = feed_expanded[i] || feeds[i].parsed_at != 0;
+    any |= has;
+    all &= has;
+  }
+  return any;
+}
+
+size_t merge_feed_alarms(alarm_entry *out, size_t max, time_t since, const alarm_entry *held, size_t num_held)
+{
+  size_t pos[MAX_FEEDS] = {0};
+  size_t held_pos = 0;
+  size_t count = 0;
+  while (count < max)
+  {
+    int best = -1;
+    for (size_t i = 0; i < MAX_FEEDS; ++i)
+    {
+      if (!feeds[i].parsed_at || pos[i] >= feeds[i].alarms.count)
+      {
+        continue;
+      }
+      if (best < 0 || feeds[i].alarms.alarms[pos[i]].start < feeds[best].alarms.alarms[pos[best]].start)
+      {
+        best = i;
+      }
+    }
+    const alarm_entry *next_held = held_pos < num_held ? &held[held_pos] : NULL;
+    if (next_held && (best < 0 || next_held->start < feeds[best].alarms.alarms[pos[best]].start))
+    {
+      best = MAX_FEEDS;
+    }
+    if (best < 0)
+    {
+      break;
+    }
+    const alarm_entry &next = best == MAX_FEEDS ? held[held_pos++] : feeds[best].alarms.alarms[pos[best]++];
+    if (next.start < since)
+    {
+      continue; // left over from an older expansion of an unchanged feed
+    }
+    if (count > 0 && out[count - 1].start == next.start)
+    {
+      continue; // one alarm per instant, the name of whichever came first
+    }
+    out[count++] = next;
+  }
+  return count;
+}
+
+const feed_status *offsets_feed()
+{
+  for (size_t i = 0; i < MAX_FEEDS; ++i)
+  {
+    if (feeds[i].parsed_at)
+    {
+      return &feeds[i];
+    }
+  }
+  return NULL;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <Arduino.h>
+#include <uICal.h>
+#include "state.h"
+#include "valarm.h"
+#include "filter.h"
+#include "schedule.h"
+
+enum feed_result
+{
+  FEED_OK,
+  FEED_UNCHANGED, // 304 or the same feed again, the alarms from the last good fetch still stand
+  FEED_NO_URL,
+  FEED_BEGIN_FAILED,
+  FEED_HTTP_ERROR,
+  FEED_PARSE_ERROR,
+};
+
+// Everything one feed needs between fetches. Results stay around after a
+// failure, so one broken feed doesn't take the others' alarms with it.
+struct feed_status
+{
+  char url[FEED_URL_LEN]; // what the cached results below came from
+  char etag[64];
+  char last_modified[40];
+  time_t parsed_at; // start of the window the alarms were expanded over, 0 if none
+  uint32_t content_crc; // of what the last good parse kept, to tell a change from the same feed
+  feed_result result;
+  fetch_failure failure;
+  int http_code;
+  uint32_t fetch_ms;
+  filter_stats stats;
+  tz_offset offsets[MAX_OFFSETS];
+  size_t num_offsets;
+  alarm_collector alarms;
+};
+
+extern feed_status feeds[MAX_FEEDS];
+
+// starts one fetch worker per feed
+void feeds_begin();
+
+// forgets every feed's results, and so their caches, before the next
+// fetch or expansion; safe from other tasks while the workers are busy
+void forget_feeds();
+
+// fetches every configured feed at once and returns when the last one is
+// done; state's urls and filter are read once, under stateMutex, first
+void fetch_feeds(time_t now);
+
+// expands every configured feed again from what's kept of it on SPIFFS
+// (src/feedcache.h, and the CalDAV index), without the network; returns
+// whether any of them has results, and sets all if every one does
+bool expand_cached_feeds(time_t now, bool &all);
+
+// merge-sorts the alarms of every feed with results, and the sorted held
+// ones, into out, skipping those before since and collapsing alarms at the
+// same instant; returns how many were written
+size_t merge_feed_alarms(alarm_entry *out, size_t max, time_t since, const alarm_entry *held = NULL,
+                         size_t num_held = 0);
+
+// the first feed (in configuration order) with results supplies the offsets
+const feed_status *offsets_feed();
@@ -0,0 +1,139 @@
+#include "filter.h"
+#include "bundle.h"
+
+static bool contains_nocase(const char *haystack, const char *needle)
+{
+  size_t n = strlen(needle);
+  for (; *haystack; ++haystack)
+  {
+    if (strncasecmp(haystack, needle, n) == 0)
+    {
+      return true;
+    }
+  }
+  return n == 0;
+}
+
+bool event_filter::parse(const char *spec)
+{
+  num_rules = 0;
+  has_include = 0;
+  bool ok = true;
+  while (*spec)
+  {
+    const char *end = strchr(spec, ';');
+    if (!end)
+    {
+      end = spec + strlen(spec);
+    }
+    while (spec < end && *spec == ' ')
+    {
+      ++spec;
+    }
+    if (spec == end)
+    {
+      spec = *end ? end + 1 : end;
+      continue;
+    }
+
+    // a rule needs its '+' or '-', and something to match
+    if (*spec != '+' && *spec != '-')
+    {
+      ok = false;
+      spec = *end ? end + 1 : end;
+      continue;
+    }
+    int include = (*spec++ == '+');
+    const char *colon = (const char *)memchr(spec, ':', end - spec);
+    filter_field field;
+    if (!colon || colon + 1 == end)
+    {
+      ok = false;
+      spec = *end ? end + 1 : end;
+      continue;
+    }
+    if (colon - spec == 7 && strncasecmp(spec, "summary", 7) == 0)
+    {
+      field = FILTER_SUMMARY;
+    }
+    else if (colon - spec == 10 && strncasecmp(spec, "categories", 10) == 0)
+    {
+      field = FILTER_CATEGORIES;
+    }
+    else if (colon - spec == 6 && strncasecmp(spec, "transp", 6) == 0)
+    {
+      field = FILTER_TRANSP;
+    }
+    else
+    {
+      ok = false;
+      spec = *end ? end + 1 : end;
+      continue;
+    }
+
+    if (num_rules < MAX_FILTER_RULES)
+    {
+      size_t len = end - (colon + 1);
+      if (len >= FILTER_TEXT_LEN)
+      {
+        len = FILTER_TEXT_LEN - 1;
+        ok = false;
+      }
+      rules[num_rules].field = field;
+      rules[num_rules].include = include;
+      memcpy(rules[num_rules].text, colon + 1, len);
+      rules[num_rules].text[len] = 0;
+      has_include |= include;
+      ++num_rules;
+    }
+    else
+    {
+      ok = false;
+    }
+    spec = *end ? end + 1 : end;
+  }
+  return ok;
+}
+
+bool event_filter::accept(const ValarmSniffer &event) const
+{
+  int included = 0;
+  for (size_t i = 0; i < num_rules; ++i)
+  {
+    bool match;
+    switch (rules[i].field)
+    {
+    case FILTER_SUMMARY:
+      match = contains_nocase(event.summary, rules[i].text);
+      break;
+    case FILTER_CATEGORIES:
+      match = contains_nocase(event.categories, rules[i].text);
+      break;
+    default:
+      match = strcasecmp(event.transp, rules[i].text) == 0;
+      break;
+    }
+    if (match && !rules[i].include)
+    {
+      return false;
+    }
+    included |= match && rules[i].include;
+  }
+  return included || !has_include;
+}
+
+uint32_t event_filter::crc() const
+{
+  uint32_t n = num_rules, include = has_include;
+  uint32_t crc = bundle_crc32(0, &n, sizeof(n));
+  crc = bundle_crc32(crc, &include, sizeof(include));
+  for (size_t i = 0; i < num_rules; ++i)
+  {
+    uint32_t field = rules[i].field;
+    include = rules[i].include;
+    crc = bundle_crc32(crc, &field, sizeof(field));
+    crc = bundle_crc32(crc, &include, sizeof(include));
+    crc = bundle_crc32(crc, rules[i].text, strnlen(rules[i].text, sizeof(rules[i].text)));
+  }
+  return crc;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <Arduino.h>
+#include "valarm.h"
+
+#define MAX_FILTER_RULES 8
+#define FILTER_TEXT_LEN 32
+
+// Rules come from the portal as one string, separated by ';':
+//   -summary:lunch;-categories:holiday;-transp:transparent;+summary:wake
+// '-' drops a matching event, '+' keeps it; if there are any '+' rules an
+// event has to match one of them. Every rule needs its '+' or '-' and some
+// text. SUMMARY and CATEGORIES match on a case insensitive substring, TRANSP
+// on the whole value.
+enum filter_field
+{
+  FILTER_SUMMARY,
+  FILTER_CATEGORIES,
+  FILTER_TRANSP,
+};
+
+struct event_filter
+{
+  size_t num_rules;
+  int has_include;
+  struct
+  {
+    filter_field field;
+    int include;
+    char text[FILTER_TEXT_LEN];
+  } rules[MAX_FILTER_RULES];
+
+  // returns false if the rules couldn't all be understood; the ones that
+  // could are still used
+  bool parse(const char *spec);
+  bool accept(const ValarmSniffer &event) const;
+  // of the rules in use, not the unused slots after them, to tell whether
+  // alarms kept went through the same rules
+  uint32_t crc() const;
+};
+
+struct filter_stats
+{
+  uint32_t seen;
+  uint32_t kept;
+  uint32_t dropped;
+};
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <Arduino.h>
+#include <time.h>
+
+// The hardware the clock logic in clock.cpp touches, behind thin
+// interfaces: device_hal.cpp has the watch's, tools/host/host_hal.h has
+// stand-ins so the same logic runs on Linux (pio run -e native).
+
+struct hal_clock
+{
+  virtual int64_t mono_us() = 0; // since boot, never steps
+  virtual void sleep_ms(uint32_t ms) = 0;
+};
+
+// a battery backed clock keeping whole seconds of UTC
+struct hal_rtc
+{
+  virtual bool present() = 0;
+  virtual void read(struct tm &t) = 0;
+  virtual void write(const struct tm &t) = 0;
+};
+
+enum face_label
+{
+  FACE_TIME,
+  FACE_TZ,
+  FACE_AM,
+  FACE_PM,
+  FACE_DATE,
+  FACE_ALARM,
+  FACE_WARNING, // a row of symbols, right aligned
+  NUM_FACE_LABELS,
+};
+
+enum face_color
+{
+  FACE_WHITE,
+  FACE_RED, // at night
+  FACE_GREEN, // while beeping
+};
+
+// the clock face; text is UTF-8 and may have LVGL's symbols (FACE_SYMBOL_*)
+struct hal_display
+{
+  virtual void set_text(face_label label, const char *text) = 0;
+  virtual void set_color(face_color color) = 0;
+  virtual void set_backlight(uint8_t level) = 0;
+  virtual void refresh() = 0; // draws what changed
+};
+
+struct hal_network
+{
+  virtual bool connected() = 0;
+  virtual uint32_t ntp_interval_ms() = 0;
+  virtual bool web_portal_active() = 0;
+  virtual bool config_portal_active() = 0;
+  virtual void stop_web_portal() = 0;
+  // for the face while a portal is up: the network to join, and where
+  virtual void portal_info(bool config, char *ssid, size_t ssid_len, char *url, size_t url_len) = 0;
+};
+
+// small blobs by key, kept across reboots
+struct hal_storage
+{
+  virtual size_t load(const char *key, void *buf, size_t len) = 0;
+  virtual void store(const char *key, const void *buf, size_t len) = 0;
+};
+
+struct hal_buzzer
+{
+  virtual void tone(uint8_t duty) = 0; // 0 is off
+};
+
+struct clock_hal
+{
+  hal_clock *clock;
+  hal_rtc *rtc;
+  hal_display *display;
+  hal_network *network;
+  hal_storage *storage;
+  hal_buzzer *buzzer;
+};
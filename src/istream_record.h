@@ -0,0 +1,58 @@
+#pragma once
+
+#include <Arduino.h>
+#include <FS.h>
+#include <uICal.h>
+
+// an istream over length bytes of a SPIFFS file from where it's positioned,
+// for uICAL; the CalDAV index and the feed caches are records of these
+class istream_record : public uICAL::istream
+{
+public:
+  istream_record(File &file, uint32_t length) : file(file), remaining(length) {}
+
+  char peek() const
+  {
+    return remaining ? file.peek() : 0;
+  }
+
+  char get()
+  {
+    if (!remaining)
+    {
+      return 0;
+    }
+    --remaining;
+    return file.read();
+  }
+
+  bool readuntil(uICAL::string &st, char delim)
+  {
+    char buf[64];
+    size_t n = 0;
+    st = "";
+    while (remaining)
+    {
+      int c = file.read();
+      --remaining;
+      if (c < 0 || c == delim)
+      {
+        break;
+      }
+      buf[n++] = c;
+      if (n == sizeof(buf) - 1)
+      {
+        buf[n] = 0;
+        st += buf;
+        n = 0;
+      }
+    }
+    buf[n] = 0;
+    st += buf;
+    return remaining || st.length() > 0;
+  }
+
+protected:
+  File &file;
+  uint32_t remaining;
+};
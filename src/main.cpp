@@ -4,56 +4,41 @@
 #include <WiFi.h>
 #include "time.h"
 #include <Preferences.h>
+#include <SPIFFS.h>
 #include <esp_sntp.h>
-#include <esp_https_ota.h>
-#include <esp_crt_bundle.h>
 #include <esp_ota_ops.h>
 #include <esp_timer.h>
-#include <HTTPClient.h>
 #include <WiFiManager.h> //https://github.com/tzapu/WiFiManager WiFi Configuration Magic
 #include <climits>
-#include <uICal.h>
-#include <uICAL/veventiter.h>
-#include <tuple>
+#include "state.h"
+#include "valarm.h"
+#include "filter.h"
+#include "feeds.h"
+#include "tls.h"
+#include "ota.h"
+#include "tzdb.h"
+#include "wifi_cache.h"
+#include "discipline.h"
+#include "ticker.h"
+#include "tasks.h"
+#include "telemetry.h"
+#include "trace.h"
+#include "clock.h"
+#include "device_hal.h"
 
-#define ALARM_FREQ 1046
 #define US_IN_SEC 1000000
 
 TTGOClass *ttgo;
 
 volatile int ticked = 0;
 
-time_t last_synced;
 time_t last_fetched;
-time_t last_success;
-time_t last_touch;
-time_t last_alarm;
-time_t next_alarm;
-time_t last_ota_attempt;
-int want_stop = 0;
-int ota_ready = 0;
-
-#define MAX_OFFSETS 4
-#define MAX_ALARMS 100
-
-struct
-{
-  struct
-  {
-    time_t start;
-    uint32_t offset;
-    unsigned char buffer[8];
-  } offsets[MAX_OFFSETS];
-  size_t num_offsets;
-  struct
-  {
-    time_t start;
-    unsigned char name[20];
-  } alarms[MAX_ALARMS];
-  size_t num_alarms;
-  time_t alarm_skip;
-  char feed_url[256];
-} state;
+
+// since boot, for how long startup takes
+int64_t wifi_up_us;
+int64_t first_sync_us;
+
+clock_state state;
 
 SemaphoreHandle_t stateMutex;
 
@@ -61,19 +46,85 @@ Preferences preferences;
 
 WiFiManager wifiManager;
 WiFiManagerParameter feed_url("feed", "ical feed url", "", 255);
+WiFiManagerParameter more_feed_urls[MAX_FEEDS - 1] = {
+    {"feed2", "second ical feed url", "", 255},
+    {"feed3", "third ical feed url", "", 255},
+};
+WiFiManagerParameter filter_rules("filter", "event filter (-summary:lunch;+categories:alarm)", "", 255);
+
+watch_clock hw_clock;
+watch_rtc hw_rtc(ttgo);
+watch_display face(ttgo);
+watch_network network(wifiManager);
+watch_storage storage(preferences);
+watch_buzzer buzzer;
+clock_hal hal = {&hw_clock, &hw_rtc, &face, &network, &storage, &buzzer};
+
+clock_discipline discipline;
+SemaphoreHandle_t timeMutex;
+volatile int rtc_due = 0;
+
+// adds to whatever slew adjtime still has to do
+static void slew(int64_t us)
+{
+  struct timeval pending, delta;
+  adjtime(NULL, &pending);
+  int64_t total = pending.tv_sec * 1000000LL + pending.tv_usec + us;
+  delta.tv_sec = total / 1000000;
+  delta.tv_usec = total % 1000000;
+  adjtime(&delta, NULL);
+}
 
-volatile int touched = 0;
-volatile int beeping = 0;
+// Replaces esp-idf's weak one, so NTP samples go through the discipline
+// rather than stepping the clock every time. time_synced still gets called
+// after this.
+void sntp_sync_time(struct timeval *tv)
+{
+  struct timeval sys;
+  xSemaphoreTake(timeMutex, portMAX_DELAY);
+  int64_t mono = esp_timer_get_time();
+  gettimeofday(&sys, NULL);
+  bool step;
+  int64_t offset = discipline.sample(mono, tv->tv_sec * 1000000LL + tv->tv_usec,
+                                     sys.tv_sec * 1000000LL + sys.tv_usec, &step);
+  if (step)
+  {
+    settimeofday(tv, NULL);
+  }
+  else
+  {
+    slew(offset);
+  }
+  xSemaphoreGive(timeMutex);
+  sntp_set_sync_status(SNTP_SYNC_STATUS_COMPLETED);
+  sntp_set_sync_interval(discipline.interval_ms());
+  Serial.printf("ntp offset %lld us %s, clock %d ppb, rtc %d ppb\n", offset, step ? "stepped" : "slewed",
+                discipline.saved.sys_ppb, discipline.saved.rtc_ppb);
+}
 
 void time_synced(struct timeval *tv)
 {
   Serial.println("time synced");
+  if (!first_sync_us)
+  {
+    first_sync_us = esp_timer_get_time();
+    Serial.printf("first ntp sync %u ms after boot, %u ms after wifi\n", (uint32_t)(first_sync_us / 1000),
+                  (uint32_t)((first_sync_us - wifi_up_us) / 1000));
+  }
   ticked = 1;
   last_synced = time(NULL);
-  struct tm *t = gmtime(&last_synced);
-  RTC_Date rtcnow(t->tm_year + 1900, t->tm_mon + 1, t->tm_mday,
-                  t->tm_hour, t->tm_min, t->tm_sec);
-  ttgo->rtc->setDateTime(rtcnow);
+  // loop() writes it at the next second edge
+  rtc_due = 1;
+}
+
+// the RTC only keeps whole seconds, so this is called just after one starts
+void set_rtc(time_t now)
+{
+  clock_write_rtc(hw_rtc, now);
+  xSemaphoreTake(timeMutex, portMAX_DELAY);
+  discipline.rtc_written(now * 1000000LL);
+  xSemaphoreGive(timeMutex);
+  storage.store("d", &discipline.saved, sizeof(discipline.saved));
   Serial.println("rtc set");
 }
 
@@ -85,43 +136,97 @@ void ardevent(arduino_event_id_t event)
     configTime(0, 0, "0.pool.ntp.org", "1.pool.ntp.org", "2.pool.ntp.org");
     sntp_set_time_sync_notification_cb(time_synced);
   }
+  else if (event == ARDUINO_EVENT_WIFI_STA_GOT_IP)
+  {
+    if (!wifi_up_us)
+    {
+      wifi_up_us = esp_timer_get_time();
+      Serial.printf("wifi up %u ms after boot\n", (uint32_t)(wifi_up_us / 1000));
+    }
+    wifi_remember_ap(preferences);
+  }
   else if (event == ARDUINO_EVENT_WIFI_STA_DISCONNECTED)
   {
     Serial.println("wifi disconnected, expect wifi manager to restart");
+    wifi_unpin();
   }
   ticked = 1;
 }
 
+TaskHandle_t savetask;
+static const char *volatile save_location;
+static volatile uint32_t saves_asked, saves_done;
+
+// call holding stateMutex, which is given back; the flash write happens on
+// the save task, off the display's core
 void save_data(const char *location)
 {
-  char buf[sizeof(state)];
-  bzero(buf, sizeof(state));
-  Serial.printf("save data %s", location);
-  if (preferences.getBytes("s", buf, sizeof(state)))
+  save_location = location;
+  saves_asked++;
+  xSemaphoreGive(stateMutex);
+  xTaskNotifyGive(savetask);
+}
+
+// waits for saves asked for so far, before a restart
+static void save_flush()
+{
+  while (saves_done != saves_asked)
   {
-    if (memcmp(&state, buf, sizeof(state)) == 0)
-    {
-      Serial.println(" unchanged");
-      xSemaphoreGive(stateMutex);
-      return;
-    }
+    delay(10);
   }
-  preferences.putBytes("s", &state, sizeof(state));
-  Serial.println(" saved");
-  xSemaphoreGive(stateMutex);
+}
+
+void save(void *)
+{
+  static clock_state snapshot;
+  while (1)
+  {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    TRACE_SCOPE("save");
+    xSemaphoreTake(stateMutex, portMAX_DELAY);
+    uint32_t asked = saves_asked;
+    const char *location = save_location;
+    memcpy(&snapshot, &state, sizeof(state));
+    xSemaphoreGive(stateMutex);
+
+    Serial.printf("save data %s", location);
+    Serial.println(clock_save(storage, snapshot) ? " saved" : " unchanged");
+    saves_done = asked;
+  }
+}
+
+static int copy_param(char *dest, const WiFiManagerParameter &param, size_t size, const char *what)
+{
+  if (strncmp(param.getValue(), dest, size) == 0)
+  {
+    return 0;
+  }
+  if (strlcpy(dest, param.getValue(), size) >= size)
+  {
+    Serial.printf("%s too big\n", what);
+  }
+  return 1;
 }
 
 void saveParamsCallback()
 {
   xSemaphoreTake(stateMutex, portMAX_DELAY);
-  if (strncmp(feed_url.getValue(), state.feed_url, sizeof(state.feed_url)) != 0)
+  int changed = copy_param(state.feed_url, feed_url, sizeof(state.feed_url), "feed url");
+  for (size_t i = 0; i < MAX_FEEDS - 1; ++i)
+  {
+    changed |= copy_param(state.more_feed_urls[i], more_feed_urls[i], sizeof(state.more_feed_urls[i]), "feed url");
+  }
+  if (copy_param(state.filter, filter_rules, sizeof(state.filter), "filter"))
+  {
+    // cached feeds were expanded under the old rules
+    forget_feeds();
+    changed = 1;
+  }
+  if (changed)
   {
-    if (strlcpy(state.feed_url, feed_url.getValue(), sizeof(state.feed_url)) >= sizeof(state.feed_url))
-    {
-      Serial.println("feed url too big");
-    }
     state.num_offsets = state.num_alarms = 0;
     last_fetched = 0;
+    fetch_plan.reset();
     ticked = 1;
     if (beeping)
     {
@@ -138,33 +243,14 @@ void saveParamsCallback()
 
 TaskHandle_t beeptask, otatask, fetchtask;
 
-#define BEEP_ON 250
-#define BEEP_OFF 350
-
 void beep(void *)
 {
   while (1)
   {
     vTaskSuspend(NULL);
-    touched = 0;
-    int pwm = 10;
-    beeping = 1;
+    TRACE_SCOPE("beep");
     ticked = 1;
-    int maxcount = 299000 / (BEEP_ON + BEEP_OFF); // beep for 299 seconds
-    while (touched == 0 && --maxcount)
-    {
-      ledcWrite(1, pwm);
-      vTaskDelay(BEEP_ON / portTICK_PERIOD_MS);
-      ledcWrite(1, 0);
-      vTaskDelay(BEEP_OFF / portTICK_PERIOD_MS);
-      pwm += 5;
-      if (pwm >= 128)
-      {
-        pwm = 127;
-      }
-    }
-    beeping = 0;
-
+    clock_beep(hal);
     ticked = 1;
   }
 }
@@ -174,6 +260,7 @@ void ota(void *)
   while (1)
   {
     vTaskSuspend(NULL);
+    TRACE_SCOPE("ota");
     last_ota_attempt = time(NULL);
 
     if (!ota_ready)
@@ -181,57 +268,74 @@ void ota(void *)
       char buffer[65];
       esp_ota_get_app_elf_sha256(buffer, sizeof(buffer));
       char url[128];
-      snprintf(url, sizeof(url), "https://time.enslaves.us/ota/from/%s.img", buffer);
+      snprintf(url, sizeof(url), OTA_URL, buffer);
 
-      esp_http_client_config_t http_config = {
-          .url = url,
-          .crt_bundle_attach = esp_crt_bundle_attach,
-      };
-
-      esp_err_t ret = esp_https_ota(&http_config);
-      if (ret == ESP_OK)
+      if (download_ota(url) == ESP_OK)
       {
         Serial.println("ota ready");
         ota_ready = 1;
       }
     }
+    // zones change more often than the firmware does
+    tzdb_update(TZDB_URL);
   }
 }
 
 void clicked()
 {
-  time_t now = time(NULL);
-  if (beeping)
-  {
-    if (!touched)
-    {
-      touched = 1;
-      Serial.println("touch to end beeping");
-    }
-  }
-  else if ((now - last_touch) > 1)
+  xSemaphoreTake(stateMutex, portMAX_DELAY);
+  if (clock_click(time(NULL)) & CLOCK_SAVE)
   {
-    Serial.println("new touch");
-    last_touch = now;
-    xSemaphoreTake(stateMutex, portMAX_DELAY);
-    if (next_alarm != state.alarm_skip)
-    {
-      state.alarm_skip = next_alarm;
-    }
-    else
-    {
-      state.alarm_skip = 0;
-    }
     save_data("clicked");
     ticked = 1;
   }
   else
   {
-    // Serial.println("continuing touch");
-    last_touch = now;
+    xSemaphoreGive(stateMutex);
+  }
+}
+
+// the /trace download, written straight to the socket by the trace task
+// while the portal goes on serving; the end of the json is the close
+static WiFiClient trace_client;
+
+static void trace_sent(Print *)
+{
+  trace_client.stop();
+}
+
+// /trace?start and /trace?stop, then /trace for the json
+static void portal_trace()
+{
+  if (wifiManager.server->hasArg("start") || wifiManager.server->hasArg("stop"))
+  {
+    wifiManager.server->hasArg("start") ? trace_start() : trace_stop();
+    wifiManager.server->send(200, "text/plain", trace_on ? "tracing\n" : "not tracing\n");
+    return;
+  }
+  if (trace_client.connected())
+  {
+    wifiManager.server->send(503, "text/plain", "a dump is still going\n");
+    return;
+  }
+  trace_client = wifiManager.server->client();
+  // not through server->send(), which would end the response as the
+  // handler returns
+  trace_client.print("HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n"
+                     "Content-Disposition: attachment; filename=trace.json\r\nConnection: close\r\n\r\n");
+  if (!trace_dump_async(&trace_client, trace_sent))
+  {
+    trace_client.print("{\"traceEvents\":[]}\n");
+    trace_client.stop();
   }
 }
 
+static void bind_portal()
+{
+  wifiManager.server->on("/telemetry", []() { wifiManager.server->send(200, "text/plain", telemetry_text()); });
+  wifiManager.server->on("/trace", portal_trace);
+}
+
 void doubleclicked()
 {
   if (beeping)
@@ -260,133 +364,134 @@ void longclicked()
   Serial.println("resetting settings");
   wifiManager.resetSettings();
   feed_url.setValue("", 0);
+  for (size_t i = 0; i < MAX_FEEDS - 1; ++i)
+  {
+    more_feed_urls[i].setValue("", 0);
+  }
+  filter_rules.setValue("", 0);
   saveParamsCallback();
+  save_flush();
   esp_restart();
 }
 
 
-extern const uint8_t fallback_timezones[] asm("_binary_fallback_timezones_ics_start");
+// the fetch task is to expand the cached feeds, not fetch
+static volatile int cached_only;
 
-void fetch(void *)
+// takes the feeds' alarms and offsets into state, and saves it; with hold,
+// the alarms state had stay too, for the feeds with no results of their own
+static void publish_alarms(time_t since, const char *location, bool hold = false)
 {
+  static alarm_entry held[MAX_ALARMS];
+  TRACE_SCOPE("merge");
+  xSemaphoreTake(stateMutex, portMAX_DELAY);
+  const feed_status *tz = offsets_feed();
+  if (tz)
+  {
+    memcpy(state.offsets, tz->offsets, sizeof(state.offsets));
+    state.num_offsets = tz->num_offsets;
+  }
+  size_t num_held = hold ? state.num_alarms : 0;
+  memcpy(held, state.alarms, num_held * sizeof(held[0]));
+  state.num_alarms = merge_feed_alarms(state.alarms, MAX_ALARMS, since - (since % 60), held, num_held);
+  last_expanded = since;
+  save_data(location);
+}
 
+// the window moved on, or the clock booted: the alarms again from what's
+// kept of each feed on SPIFFS, with no network
+static void expand_cached()
+{
+  TRACE_SCOPE("expand cached");
+  time_t now = time(NULL);
+  bool all;
+  if (!expand_cached_feeds(now, all))
+  {
+    Serial.println("no feed is cached; alarms wait for a fetch");
+    return;
+  }
+  if (!all)
+  {
+    // a bundle not fetched since boot: what was saved from it still stands,
+    // next to the others' alarms, until a fetch replaces them all
+    Serial.println("not every feed is cached; keeping the saved alarms too");
+  }
+  publish_alarms(now, "cached feeds", !all);
+}
 
+void fetch(void *)
+{
   while (1)
   {
     vTaskSuspend(NULL);
-    last_fetched = time(NULL);
-    if (state.feed_url[0] == 0)
-    {
-      Serial.println("skipping feed fetch; no url");
-      last_success = time(NULL);
-      continue;
-    }
-    HTTPClient https;
-    https.useHTTP10(true);
-
-    if (!https.begin(state.feed_url))
+    if (cached_only)
     {
-      Serial.println("https begin failed");
+      expand_cached();
       continue;
     }
-    int httpCode = https.GET();
-
-    if (httpCode != 200)
+    TRACE_SCOPE("fetch");
+    last_fetched = time(NULL);
+    int any_url = 0;
+    for (size_t i = 0; i < MAX_FEEDS; ++i)
     {
-      char buf[128];
-      snprintf(buf, sizeof(buf), "http code: %d", httpCode);
-      Serial.println(buf);
+      any_url |= state_feed_url(i)[0] != 0;
     }
-    if (httpCode <= 0)
+    if (!any_url)
     {
+      Serial.println("skipping feed fetch; no url");
+      last_success = time(NULL);
+      fetch_plan.success(last_success, false, esp_random());
       continue;
     }
-    int entered = 0;
-    
+    trace_begin("fetch feeds");
+    fetch_feeds(last_fetched);
+    trace_end("fetch feeds");
 
-    try
+    int fetched = 0, changed = 0;
+    const feed_status *failed = NULL;
+    for (size_t i = 0; i < MAX_FEEDS; ++i)
     {
-
-    uICAL::TZMap_ptr tzmap = uICAL::new_ptr<uICAL::TZMap>();
-    uICAL::Calendar_ptr cal = nullptr;
-
-      String fallback_str((char *)fallback_timezones);
-      uICAL::istream_String fallback(fallback_str);
-      cal = uICAL::Calendar::load(fallback, tzmap);
-
-      uICAL::DateTime calBegin(last_fetched), calEnd(last_fetched + 86400 * 7);
-      uICAL::istream_Stream istm(https.getStream());
-      cal = uICAL::Calendar::load(istm, tzmap,[calBegin, calEnd](const uICAL::VEvent &event)
-                                  {
-        vTaskDelay(1);
-        auto ev = uICAL::new_ptr<uICAL::VEvent>(event);
-        auto evIt = uICAL::new_ptr<uICAL::VEventIter>(ev, calBegin, calEnd);
-        return evIt->next(); });
-
-      auto current_offset = cal->tz()->fromUTC(last_fetched);
-
-      xSemaphoreTake(stateMutex, portMAX_DELAY);
-      entered = 1;
-      state.offsets[0].start = last_fetched;
-      state.offsets[0].offset = std::get<0>(current_offset) - last_fetched;
-      std::get<1>(current_offset).getBytes(state.offsets[0].buffer, sizeof(state.offsets[0].buffer) - 1);
-      int offsets = 1;
-      while (offsets < MAX_OFFSETS)
-      {
-        auto next_offset = cal->tz()->next_transition_UTC(state.offsets[offsets - 1].start);
-        if (std::get<0>(next_offset) == MAX_UICAL_SECONDS)
-        {
-          break;
-        }
-        state.offsets[offsets].start = std::get<0>(next_offset);
-        state.offsets[offsets].offset = std::get<1>(next_offset);
-        std::get<2>(next_offset).getBytes(state.offsets[offsets].buffer, sizeof(state.offsets[0].buffer) - 1);
-        ++offsets;
-      }
-
-      if (offsets == 1 && state.offsets[0].offset == 0 && state.offsets[0].buffer[0] == 'Z' && state.offsets[0].buffer[1] == 0) {
-        offsets = 0;
-      } 
-      state.num_offsets = offsets;
-
-      uICAL::CalendarIter_ptr calIt = uICAL::new_ptr<uICAL::CalendarIter>(cal, calBegin, calEnd);
-      int alarm = 0;
-      while (calIt->next() && alarm < MAX_ALARMS)
+      fetched |= feeds[i].result == FEED_OK || feeds[i].result == FEED_UNCHANGED;
+      changed |= feeds[i].result == FEED_OK;
+      if (!failed && feeds[i].failure != FAIL_NONE)
       {
-        uICAL::CalendarEntry_ptr entry = calIt->current();
-        state.alarms[alarm].start = entry->start().seconds();
-        entry->summary().getBytes(state.alarms[alarm].name, sizeof(state.alarms[alarm].name) - 1);
-        ++alarm;
-        state.num_alarms = alarm;
-        last_success = time(NULL);
+        failed = &feeds[i];
       }
     }
-    catch (uICAL::Error ex)
-    {
-      char buf[128];
-      snprintf(buf, sizeof(buf), "%s: %s", ex.message.c_str(), "! Failed loading calendar");
-      Serial.println(buf);
-    }
-    if (entered)
+    if (!fetched)
     {
-      save_data("try fetch");
+      fetch_plan.failure(time(NULL), failed ? failed->failure : FAIL_CONNECT, failed ? failed->http_code : 0,
+                         esp_random());
+      Serial.printf("fetch failed (%s, %d in a row), next in %ld s\n", fetch_failure_name(fetch_plan.last_failure),
+                    fetch_plan.failures, (long)(fetch_plan.next - time(NULL)));
+      continue;
     }
+    fetch_plan.success(time(NULL), changed, esp_random());
+    Serial.printf("fetch %s, next in %ld s\n", changed ? "changed" : "unchanged", (long)(fetch_plan.next - time(NULL)));
+
+    last_success = time(NULL);
+    publish_alarms(last_fetched, "try fetch");
   }
 }
 
-lv_obj_t *timelabel, *datelabel, *alarmlabel, *tzlabel, *amlabel, *pmlabel;
-lv_obj_t *warninglabel, *wifilabel, *ntplabel, *icallabel;
-
-lv_style_t my_style, time_style, date_style, alarm_style;
-
 void setup()
 {
   Serial.begin(115200);
   preferences.begin("clock", false, NULL);
-  if (preferences.getBytes("s", &state, sizeof(state)))
+  if (!SPIFFS.begin(true))
+  {
+    Serial.println("spiffs mount failed");
+  }
+  tzdb_begin();
+  if (storage.load("s", &state, sizeof(state)))
   {
     Serial.println("got saved data");
     feed_url.setValue(state.feed_url, sizeof(state.feed_url) - 1);
+    for (size_t i = 0; i < MAX_FEEDS - 1; ++i)
+    {
+      more_feed_urls[i].setValue(state.more_feed_urls[i], sizeof(state.more_feed_urls[i]) - 1);
+    }
+    filter_rules.setValue(state.filter, sizeof(state.filter) - 1);
   }
   else
   {
@@ -407,17 +512,29 @@ void setup()
   ttgo->tft->fillScreen(TFT_BLACK);
   ttgo->openBL();
 
-  ledcSetup(1, ALARM_FREQ, 8);
-
-  ledcAttachPin(33, 1);
-  xTaskCreate(beep, "beep", 1024, NULL, tskIDLE_PRIORITY, &beeptask);
-  xTaskCreate(ota, "ota", 8192, NULL, tskIDLE_PRIORITY, &otatask);
-  xTaskCreate(fetch, "fetch", 8192, NULL, tskIDLE_PRIORITY, &fetchtask);
+  buzzer.begin();
+  trace_setup(TRACE_AT_BOOT);
   stateMutex = xSemaphoreCreateMutex();
+  beeptask = task_start(TASK_BEEP, beep);
+  otatask = task_start(TASK_OTA, ota);
+  fetchtask = task_start(TASK_FETCH, fetch);
+  savetask = task_start(TASK_SAVE, save);
+  telemetry_begin();
+  tls_cache_begin();
+  feeds_begin();
+
+  timeMutex = xSemaphoreCreateMutex();
+  discipline_saved saved_discipline;
+  if (storage.load("d", &saved_discipline, sizeof(saved_discipline)) != sizeof(saved_discipline))
+  {
+    bzero(&saved_discipline, sizeof(saved_discipline));
+  }
+  discipline.begin(saved_discipline, esp_timer_get_time());
 
   // Check if RTC is online
   time_t now = 1643768522; // super twosday
-  if (!ttgo->deviceProbe(0x51))
+  int64_t now_us = now * 1000000LL;
+  if (!hw_rtc.present())
   {
     Serial.println("RTC CHECK FAILED");
     ttgo->tft->fillScreen(TFT_BLACK);
@@ -431,63 +548,18 @@ void setup()
   {
     ticked = 1;
 
-    RTC_Date rtcnow = ttgo->rtc->getDateTime();
-    struct tm t = {
-        .tm_sec = rtcnow.second,
-        .tm_min = rtcnow.minute,
-        .tm_hour = rtcnow.hour,
-        .tm_mday = rtcnow.day,
-        .tm_mon = rtcnow.month - 1,
-        .tm_year = rtcnow.year - 1900,
-    };
-    now = mktime(&t);
-    if (now == -1)
-    {
-      now = 1293843661; // super onesday
-    }
+    now = clock_read_rtc(hw_rtc, hw_clock);
+    // corrected for how far the RTC drifted since it was set
+    now_us = discipline.rtc_boot(now * 1000000LL, esp_timer_get_time());
+    Serial.printf("rtc %ld, corrected by %lld us\n", (long)now, now_us - now * 1000000LL);
   }
   struct timeval tv
   {
-    .tv_sec = now, .tv_usec = 0
+    .tv_sec = (time_t)(now_us / 1000000), .tv_usec = (suseconds_t)(now_us % 1000000)
   };
   settimeofday(&tv, NULL);
 
-  lv_style_init(&my_style);
-  lv_style_init(&time_style);
-  lv_style_init(&date_style);
-  lv_style_init(&alarm_style);
-
-  lv_style_set_text_font(&my_style, LV_STATE_DEFAULT, &lv_font_montserrat_28);
-  lv_style_set_text_font(&time_style, LV_STATE_DEFAULT, &dseg_175);
-  lv_style_set_text_font(&date_style, LV_STATE_DEFAULT, &lv_font_montserrat_48);
-  lv_style_set_text_font(&alarm_style, LV_STATE_DEFAULT, &lv_font_montserrat_38);
-
-  lv_style_set_bg_color(&my_style, LV_STATE_DEFAULT, LV_COLOR_BLACK);
-
-  lv_obj_add_style(lv_scr_act(), LV_OBJ_PART_MAIN, &my_style);
-  timelabel = lv_label_create(lv_scr_act(), NULL);
-  lv_obj_add_style(timelabel, LV_OBJ_PART_MAIN, &time_style);
-  lv_obj_set_pos(timelabel, -102, 10);
-
-  tzlabel = lv_label_create(lv_scr_act(), NULL);
-  lv_obj_set_pos(tzlabel, 80, 185);
-
-  amlabel = lv_label_create(lv_scr_act(), NULL);
-  lv_obj_set_pos(amlabel, 261, 185);
-
-  pmlabel = lv_label_create(lv_scr_act(), NULL);
-  lv_obj_set_pos(pmlabel, 399, 185);
-
-  datelabel = lv_label_create(lv_scr_act(), NULL);
-  lv_obj_add_style(datelabel, LV_OBJ_PART_MAIN, &date_style);
-  lv_obj_set_pos(datelabel, 40, 214);
-
-  alarmlabel = lv_label_create(lv_scr_act(), NULL);
-  lv_obj_add_style(alarmlabel, LV_OBJ_PART_MAIN, &alarm_style);
-  lv_obj_set_pos(alarmlabel, 0, 282);
-
-  warninglabel = lv_label_create(lv_scr_act(), NULL);
-  lv_obj_set_pos(warninglabel, 480, 289);
+  face.create();
 
   ttgo->button->setClickHandler(clicked);
   ttgo->button->setDoubleClickHandler(doubleclicked);
@@ -497,13 +569,22 @@ void setup()
   WiFi.onEvent(ardevent);
   // wifiManager.resetSettings();
   wifiManager.addParameter(&feed_url);
+  for (size_t i = 0; i < MAX_FEEDS - 1; ++i)
+  {
+    wifiManager.addParameter(&more_feed_urls[i]);
+  }
+  wifiManager.addParameter(&filter_rules);
   wifiManager.setConfigPortalBlocking(false);
   wifiManager.setSaveConfigCallback(saveParamsCallback);
+  wifiManager.setWebServerCallback(bind_portal);
   wifiManager.setBreakAfterConfig(true);
+  // autoConnect returns straight away if this got us on
+  wifi_fast_connect(preferences, wifiManager.getWiFiSSID(true).c_str(), wifiManager.getWiFiPass(true).c_str());
   if (!wifiManager.autoConnect())
   {
     want_stop = 0;
   };
+  ticker_begin();
   Serial.println("end of setup");
 }
 
@@ -511,150 +592,28 @@ time_t lasttime = 0;
 
 void loop()
 {
-  wifiManager.process();
+  static int64_t last_rate_correction;
   time_t now = time(NULL);
-  if (ticked || now != lasttime)
+  int flipped = now != lasttime;
+  if (rtc_due && flipped)
+  {
+    // one i2c write late, every few hours
+    rtc_due = 0;
+    set_rtc(now);
+  }
+  if (esp_timer_get_time() - last_rate_correction > 60 * US_IN_SEC)
+  {
+    last_rate_correction = esp_timer_get_time();
+    xSemaphoreTake(timeMutex, portMAX_DELAY);
+    slew(discipline.rate_correction(last_rate_correction));
+    xSemaphoreGive(timeMutex);
+  }
+  if (ticked || flipped)
   {
-    time_t display_now = now;
-    time_t alarm_now = now - (now % 60);
-    int offset = -1;
-    int need_save = 0;
+    TRACE_SCOPE("tick");
     xSemaphoreTake(stateMutex, portMAX_DELAY);
-    while (offset + 1 < state.num_offsets && state.offsets[offset + 1].start <= now)
-    {
-      ++offset;
-    }
-    if (offset >= 0)
-    {
-      display_now += state.offsets[offset].offset;
-    }
-
-    int found_alarm = 0;
-    int al = 0;
-    time_t altime;
-    for (; al < state.num_alarms; ++al)
-    {
-      if (state.alarms[al].start >= alarm_now && state.alarms[al].start < alarm_now + (7 * 86400))
-      {
-        altime = state.alarms[al].start;
-        if (altime == alarm_now && last_alarm != alarm_now)
-        {
-          last_alarm = alarm_now;
-          if (state.alarm_skip != alarm_now)
-          {
-            vTaskResume(beeptask);
-            delay(1);
-          }
-        }
-        found_alarm = 1;
-        break;
-      }
-    }
-
-    struct tm *t = gmtime(&display_now);
-    if (beeping)
-    {
-      lv_style_set_text_color(&my_style, LV_STATE_DEFAULT, LV_COLOR_GREEN);
-      ttgo->setBrightness(255);
-    }
-    else if ((t->tm_hour <= 7) || (t->tm_hour >= 20))
-    {
-      lv_style_set_text_color(&my_style, LV_STATE_DEFAULT, LV_COLOR_RED);
-      ttgo->setBrightness(96);
-    }
-    else
-    {
-      lv_style_set_text_color(&my_style, LV_STATE_DEFAULT, LV_COLOR_WHITE);
-      ttgo->setBrightness(255);
-    }
-
-    if (offset >= 0)
-    {
-      lv_label_set_text(tzlabel, (char *)state.offsets[offset].buffer);
-    }
-    else
-    {
-      lv_label_set_text_static(tzlabel, "UTC");
-    }
-
-    char buffer[80] = {0};
-    strftime(buffer, sizeof(buffer), "%I:%M", t);
-    if (buffer[0] == '0')
-    {
-      buffer[0] = '!';
-    }
-
-    lv_label_set_text(timelabel, buffer);
-    if (t->tm_hour >= 12)
-    {
-      lv_label_set_text_static(pmlabel, "PM");
-      lv_label_set_text_static(amlabel, "");
-    }
-    else
-    {
-      lv_label_set_text_static(pmlabel, "");
-      lv_label_set_text_static(amlabel, "AM");
-    }
-
-    strftime(buffer, sizeof(buffer), "%a %b %e, %Y", t);
-    lv_label_set_text(datelabel, buffer);
-
-    String alarm_prefix = "";
-
-    if (found_alarm)
-    {
-      next_alarm = altime;
-      if (state.alarm_skip && state.alarm_skip != next_alarm)
-      {
-        Serial.printf("unset skip %ld != %ld\n", state.alarm_skip, next_alarm);
-        state.alarm_skip = 0;
-        need_save = 1;
-      }
-      offset = -1;
-      while (offset + 1 < state.num_offsets && state.offsets[offset + 1].start <= altime)
-      {
-        ++offset;
-      }
-      if (offset >= 0)
-      {
-        altime += state.offsets[offset].offset;
-      }
-
-      if (beeping)
-      {
-        alarm_prefix = LV_SYMBOL_EYE_OPEN;
-      }
-      else if (alarm_now != last_alarm && next_alarm != state.alarm_skip)
-      {
-        alarm_prefix = LV_SYMBOL_BELL;
-      }
-      else
-      {
-        alarm_prefix = LV_SYMBOL_PAUSE;
-      }
-
-      t = gmtime(&altime);
-      if (next_alarm < alarm_now + (3600 * 22))
-      {
-        strftime(buffer, sizeof(buffer), "%l:%M %p", t);
-      }
-      else
-      {
-        strftime(buffer, sizeof(buffer), "%a %l:%M %p", t);
-      }
-
-      lv_label_set_text_fmt(alarmlabel, "%s %s %s", alarm_prefix.c_str(), buffer, state.alarms[al].name);
-    }
-    else
-    {
-      if (state.alarm_skip != 0 && next_alarm != 0)
-      {
-        state.alarm_skip = next_alarm = 0;
-        need_save = 1;
-      }
-      lv_label_set_text_static(alarmlabel, "no imminent alarm");
-    }
-    if (need_save)
+    int todo = clock_tick(hal, now, esp_timer_get_time());
+    if (todo & CLOCK_SAVE)
     {
       save_data("loop");
     }
@@ -662,107 +621,58 @@ void loop()
     {
       xSemaphoreGive(stateMutex);
     }
-
-    int warn = 0;
-
-    String warning_text = "";
-    int warn_sec = display_now % 30;
-
-    if (WiFi.status() != WL_CONNECTED)
+    if (todo & CLOCK_ALARM)
     {
-      warning_text += LV_SYMBOL_WIFI;
-      warn = 1;
-      if (!beeping && warn_sec >= 5 && warn_sec < 10)
-      {
-        lv_label_set_text_fmt(alarmlabel, "%s Wi-Fi Disconnected", alarm_prefix.c_str());
-      }
+      vTaskResume(beeptask);
     }
-    else
+    if (todo & CLOCK_OTA)
     {
-      if (!beeping && last_synced != 0 &&
-          now - last_ota_attempt > 86400 &&
-          (next_alarm == 0 || next_alarm - now > 3600) &&
-          esp_timer_get_time() > 15 * US_IN_SEC)
-      {
-        vTaskResume(otatask);
-      }
+      vTaskResume(otatask);
     }
-
-    if (now - last_synced > ((sntp_get_sync_interval() * 4) / 1000))
-    {
-      warning_text += LV_SYMBOL_REFRESH;
-      warn = 1;
-      if (!beeping && warn_sec >= 10 && warn_sec < 15)
-      {
-        lv_label_set_text_fmt(alarmlabel, "%s no recent NTP sync", alarm_prefix.c_str());
-      }
-    }
-
-    if (warn == 0 && (now - last_fetched > 60 * 60) && esp_timer_get_time() > 30 * US_IN_SEC)
+    if (todo & CLOCK_FETCH)
     {
+      cached_only = 0;
       vTaskResume(fetchtask);
     }
-
-    if (now - last_success > (3600 * 4))
-    {
-      warning_text += LV_SYMBOL_BELL;
-      warn = 1;
-      if (!beeping && warn_sec >= 15 && warn_sec < 20)
-      {
-        lv_label_set_text_fmt(alarmlabel, "%s no recent iCal sync", alarm_prefix.c_str());
-      }
-    }
-
-    if (warn)
-    {
-      warning_text = LV_SYMBOL_WARNING + warning_text;
-    }
-
-    if (wifiManager.getWebPortalActive())
+    else if ((todo & CLOCK_EXPAND) && eTaskGetState(fetchtask) == eSuspended)
     {
-      if (want_stop)
-      {
-        wifiManager.stopWebPortal();
-      }
-      else
-      {
-        warning_text += LV_SYMBOL_SETTINGS;
-        if (!beeping && warn_sec >= 20 && warn_sec < 25)
-        {
-          lv_label_set_text_fmt(alarmlabel, "%s SSID: %s", alarm_prefix.c_str(), wifiManager.getWiFiSSID().c_str());
-          lv_label_set_text_fmt(datelabel, "http://%s", WiFi.localIP().toString().c_str());
-        }
-      }
+      cached_only = 1;
+      vTaskResume(fetchtask);
     }
 
-    if (wifiManager.getConfigPortalActive())
+    ticked = 0;
+    lasttime = now;
+    trace_begin("lv_task_handler");
+    face.refresh();
+    trace_end("lv_task_handler");
+    if (flipped)
     {
-      if (!beeping)
-      {
-        lv_label_set_text_fmt(alarmlabel, "%s SSID: %s", alarm_prefix.c_str(), wifiManager.getConfigPortalSSID().c_str());
-        lv_label_set_text_fmt(datelabel, "http://%s", WiFi.softAPIP().toString().c_str());
-        warning_text = "";
-      }
+      ticker_flipped();
     }
+  }
+  wifiManager.process();
 
-    if (ota_ready)
-    {
-      warning_text += LV_SYMBOL_DOWNLOAD;
-      if (!beeping && warn_sec >= 20 && warn_sec < 25)
+  // on serial: + starts tracing, - stops it, t dumps it
+  if (Serial.available())
+  {
+    switch (Serial.read())
+    {
+    case '+':
+      trace_start();
+      break;
+    case '-':
+      trace_stop();
+      break;
+    case 't':
+      if (!trace_dump_async(&Serial))
       {
-        lv_label_set_text_fmt(alarmlabel, "%s reboot to update", alarm_prefix.c_str());
+        Serial.println("a dump is still going");
       }
+      break;
     }
-
-    lv_label_set_text(warninglabel, warning_text.c_str());
-    lv_obj_set_pos(warninglabel, 480 - ((warning_text.length() / 3) * 30), 289);
-
-    ticked = 0;
-    lasttime = now;
-    lv_task_handler();
   }
 
-  vTaskDelay(5);
+  ticker_wait(5);
   ttgo->button->loop();
   if (ttgo->touched())
   {
@@ -0,0 +1,391 @@
+#include "ota.h"
+#include <HTTPClient.h>
+#include <SPIFFS.h>
+#include <esp_ota_ops.h>
+#include <esp_partition.h>
+#include <esp_timer.h>
+#include "tls.h"
+#include "delta.h"
+#include "trace.h"
+
+// flash is erased and written a sector at a time, and progress only counts
+// whole sectors, so a resume never has to patch one up
+#define OTA_SECTOR 4096
+#define OTA_PROGRESS_FILE "/ota.prg"
+#define OTA_SAVE_EVERY (64 * 1024)
+#define OTA_MAX_RETRIES 5
+#define OTA_IDLE_TIMEOUT_MS 20000
+#define OTA_STALL_MS 500
+
+ota_stats ota_last;
+
+struct ota_progress
+{
+  char url[128];
+  char validator[64]; // ETag, or Last-Modified without one, for If-Range
+  uint32_t size;
+  uint32_t written;
+};
+
+static void load_progress(ota_progress &p)
+{
+  bzero(&p, sizeof(p));
+  File f = SPIFFS.open(OTA_PROGRESS_FILE, "r");
+  if (!f)
+  {
+    return;
+  }
+  strlcpy(p.url, f.readStringUntil('\n').c_str(), sizeof(p.url));
+  strlcpy(p.validator, f.readStringUntil('\n').c_str(), sizeof(p.validator));
+  p.size = f.readStringUntil('\n').toInt();
+  p.written = f.readStringUntil('\n').toInt();
+  f.close();
+}
+
+static void save_progress(const ota_progress &p)
+{
+  File f = SPIFFS.open(OTA_PROGRESS_FILE, "w");
+  f.printf("%s\n%s\n%u\n%u\n", p.url, p.validator, p.size, p.written);
+  f.close();
+}
+
+// "bytes first-last/total"
+static bool parse_content_range(const String &range, uint32_t *first, uint32_t *total)
+{
+  unsigned long a, b, t;
+  if (sscanf(range.c_str(), "bytes %lu-%lu/%lu", &a, &b, &t) != 3)
+  {
+    return false;
+  }
+  *first = a;
+  *total = t;
+  return true;
+}
+
+// time spent waiting counts as a stall if it was long enough to notice
+static void end_idle(int64_t &idle_since, int64_t now)
+{
+  if (idle_since && now - idle_since >= OTA_STALL_MS * 1000LL)
+  {
+    ota_last.stall_ms += (now - idle_since) / 1000;
+  }
+  idle_since = 0;
+}
+
+// whatever has arrived, up to len: 0 if nothing yet, -1 once the connection
+// has dropped or been quiet for OTA_IDLE_TIMEOUT_MS
+static int read_some(WiFiClient *stream, uint8_t *buf, size_t len, int64_t &idle_since)
+{
+  int64_t now = esp_timer_get_time();
+  int n = stream->available();
+  if (n <= 0)
+  {
+    if (!stream->connected() || (idle_since && now - idle_since > OTA_IDLE_TIMEOUT_MS * 1000LL))
+    {
+      end_idle(idle_since, now);
+      return -1;
+    }
+    if (!idle_since)
+    {
+      idle_since = now;
+    }
+    delay(10);
+    return 0;
+  }
+  end_idle(idle_since, now);
+  n = stream->read(buf, (size_t)n < len ? n : len);
+  if (n <= 0)
+  {
+    return 0;
+  }
+  ota_last.received += n;
+  return n;
+}
+
+static esp_err_t write_sector(const esp_partition_t *partition, uint32_t offset, const uint8_t *data, size_t len)
+{
+  esp_err_t err = esp_partition_erase_range(partition, offset, OTA_SECTOR);
+  if (err == ESP_OK)
+  {
+    err = esp_partition_write(partition, offset, data, len);
+  }
+  if (err != ESP_OK)
+  {
+    Serial.printf("ota flash write at %u: %s\n", offset, esp_err_to_name(err));
+  }
+  return err;
+}
+
+// a delta's source is the running app, its target goes to the update
+// partition through the sector buffer
+struct partition_io : delta_io
+{
+  const esp_partition_t *source, *target;
+  uint8_t *sector;
+  size_t fill;
+  uint32_t offset;
+
+  partition_io(const esp_partition_t *target, uint8_t *sector)
+      : source(esp_ota_get_running_partition()), target(target), sector(sector), fill(0), offset(0)
+  {
+  }
+  bool read_source(uint32_t at, uint8_t *buf, size_t len)
+  {
+    return at + len <= source->size && esp_partition_read(source, at, buf, len) == ESP_OK;
+  }
+  bool write_target(const uint8_t *buf, size_t len)
+  {
+    while (len)
+    {
+      size_t n = OTA_SECTOR - fill < len ? OTA_SECTOR - fill : len;
+      if (offset + fill + n > target->size)
+      {
+        return false;
+      }
+      memcpy(sector + fill, buf, n);
+      fill += n;
+      buf += n;
+      len -= n;
+      if (fill == OTA_SECTOR && !flush())
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+  bool flush()
+  {
+    if (fill && write_sector(target, offset, sector, fill) != ESP_OK)
+    {
+      return false;
+    }
+    offset += fill;
+    fill = 0;
+    return true;
+  }
+};
+
+// Deltas aren't resumed: the patcher's state would have to be saved along
+// with the flash, and the whole patch is about what a resume would save.
+static esp_err_t apply_delta(const esp_partition_t *partition, WiFiClient *stream, ota_progress &p, uint8_t *sector)
+{
+  partition_io io(partition, sector);
+  delta_patcher patcher(io);
+  uint8_t buf[512];
+  int64_t idle_since = 0;
+  delta_result result = DELTA_MORE;
+  ota_last.delta = true;
+  while (result == DELTA_MORE)
+  {
+    int n = read_some(stream, buf, sizeof(buf), idle_since);
+    if (n < 0)
+    {
+      break;
+    }
+    result = patcher.feed(buf, n);
+  }
+  ota_last.size = patcher.header().target_size;
+  if (result == DELTA_DONE && io.flush())
+  {
+    p.size = p.written = patcher.written();
+    return ESP_OK;
+  }
+  if (result == DELTA_MORE)
+  {
+    Serial.printf("ota delta dropped at %u of %u\n", patcher.written(), patcher.header().target_size);
+    return ESP_ERR_TIMEOUT;
+  }
+  Serial.printf("ota delta failed: %d\n", result);
+  return result == DELTA_IO_ERROR ? ESP_FAIL : ESP_ERR_INVALID_RESPONSE;
+}
+
+// One request, from p.written to the end. ESP_ERR_TIMEOUT means the
+// connection dropped or went quiet and is worth another go,
+// ESP_ERR_INVALID_RESPONSE that a delta didn't apply.
+static esp_err_t fetch_rest(const esp_partition_t *partition, ota_progress &p, uint8_t *buffer, bool accept_delta)
+{
+  TRACE_SCOPE("ota request");
+  TlsClient tls;
+  HTTPClient http;
+  http.useHTTP10(true);
+  if (!http_begin(http, tls, p.url))
+  {
+    return ESP_FAIL;
+  }
+  const char *keys[] = {"ETag", "Last-Modified", "Content-Range", "Content-Type"};
+  http.collectHeaders(keys, 4);
+  if (accept_delta)
+  {
+    http.addHeader("Accept", DELTA_CONTENT_TYPE ", application/octet-stream;q=0.5");
+  }
+  if (p.written && p.validator[0])
+  {
+    char range[32];
+    snprintf(range, sizeof(range), "bytes=%u-", p.written);
+    http.addHeader("Range", range);
+    http.addHeader("If-Range", p.validator);
+  }
+  int code = http.GET();
+  if (code == 206)
+  {
+    uint32_t first, total;
+    if (!parse_content_range(http.header("Content-Range"), &first, &total) || first != p.written || total != p.size)
+    {
+      Serial.printf("ota range mismatch: %s\n", http.header("Content-Range").c_str());
+      p.written = 0;
+      return ESP_ERR_TIMEOUT;
+    }
+  }
+  else if (code == 200 && http.header("Content-Type").startsWith(DELTA_CONTENT_TYPE))
+  {
+    p.written = 0;
+    p.validator[0] = 0;
+    save_progress(p);
+    return apply_delta(partition, http.getStreamPtr(), p, buffer);
+  }
+  else if (code == 200)
+  {
+    // a new image, or a server that doesn't do ranges
+    if (p.written)
+    {
+      Serial.println("ota restarting from 0");
+    }
+    p.written = 0;
+    int size = http.getSize();
+    if (size <= 0 || (uint32_t)size > partition->size)
+    {
+      Serial.printf("ota bad size: %d\n", size);
+      return ESP_FAIL;
+    }
+    p.size = size;
+    String validator = http.header("ETag");
+    if (!validator.length())
+    {
+      validator = http.header("Last-Modified");
+    }
+    strlcpy(p.validator, validator.c_str(), sizeof(p.validator));
+    save_progress(p);
+  }
+  else
+  {
+    Serial.printf("ota http code: %d\n", code);
+    if (code == 416)
+    {
+      p.written = 0;
+      return ESP_ERR_TIMEOUT;
+    }
+    return code < 0 ? ESP_ERR_TIMEOUT : ESP_FAIL;
+  }
+  ota_last.size = p.size;
+
+  WiFiClient *stream = http.getStreamPtr();
+  size_t fill = 0;
+  int64_t idle_since = 0;
+  while (p.written + fill < p.size)
+  {
+    size_t want = OTA_SECTOR - fill;
+    if (want > p.size - p.written - fill)
+    {
+      want = p.size - p.written - fill;
+    }
+    int n = read_some(stream, buffer + fill, want, idle_since);
+    if (n < 0)
+    {
+      break;
+    }
+    fill += n;
+
+    if (fill == OTA_SECTOR || p.written + fill == p.size)
+    {
+      esp_err_t err = write_sector(partition, p.written, buffer, fill);
+      if (err != ESP_OK)
+      {
+        return err;
+      }
+      p.written += fill;
+      fill = 0;
+      if (p.written % OTA_SAVE_EVERY == 0 || p.written == p.size)
+      {
+        save_progress(p);
+      }
+    }
+  }
+  if (p.written < p.size)
+  {
+    Serial.printf("ota dropped at %u of %u\n", p.written + fill, p.size);
+    save_progress(p);
+    return ESP_ERR_TIMEOUT;
+  }
+  return ESP_OK;
+}
+
+esp_err_t download_ota(const char *url)
+{
+  bzero(&ota_last, sizeof(ota_last));
+  const esp_partition_t *partition = esp_ota_get_next_update_partition(NULL);
+  if (!partition)
+  {
+    return ESP_ERR_NOT_FOUND;
+  }
+  ota_progress p;
+  load_progress(p);
+  if (strcmp(p.url, url) || p.written > p.size || p.size > partition->size)
+  {
+    bzero(&p, sizeof(p));
+    strlcpy(p.url, url, sizeof(p.url));
+  }
+  else if (p.written)
+  {
+    Serial.printf("ota resuming at %u of %u\n", p.written, p.size);
+  }
+  ota_last.resumed_at = p.written;
+
+  uint8_t *buffer = (uint8_t *)malloc(OTA_SECTOR);
+  if (!buffer)
+  {
+    return ESP_ERR_NO_MEM;
+  }
+  esp_err_t err;
+  bool accept_delta = true;
+  for (int attempt = 0;; attempt++)
+  {
+    int64_t started = esp_timer_get_time();
+    err = fetch_rest(partition, p, buffer, accept_delta);
+    ota_last.transfer_ms += (esp_timer_get_time() - started) / 1000;
+    if (err == ESP_ERR_INVALID_RESPONSE && accept_delta)
+    {
+      // the patch doesn't fit what's running, ask for the image instead
+      accept_delta = false;
+      ota_last.retries++;
+      continue;
+    }
+    if (err != ESP_ERR_TIMEOUT || attempt == OTA_MAX_RETRIES)
+    {
+      break;
+    }
+    ota_last.retries++;
+    delay(1000 << attempt);
+  }
+  free(buffer);
+
+  if (ota_last.transfer_ms)
+  {
+    ota_last.bytes_per_sec = (uint64_t)ota_last.received * 1000 / ota_last.transfer_ms;
+  }
+  Serial.printf("ota %u of %u bytes%s (from %u), %u received, %u B/s, stalled %u ms, %u retries\n", p.written,
+                p.size, ota_last.delta ? " by delta" : "", ota_last.resumed_at, ota_last.received,
+                ota_last.bytes_per_sec, ota_last.stall_ms, ota_last.retries);
+  if (err != ESP_OK)
+  {
+    return err;
+  }
+
+  // checks the whole image before pointing otadata at it
+  err = esp_ota_set_boot_partition(partition);
+  if (err != ESP_OK)
+  {
+    Serial.printf("ota image rejected: %s\n", esp_err_to_name(err));
+  }
+  SPIFFS.remove(OTA_PROGRESS_FILE);
+  return err;
+}
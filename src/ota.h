@@ -0,0 +1,33 @@
+#pragma once
+
+#include <Arduino.h>
+#include <esp_err.h>
+
+// where images are fetched from, by the running app's sha256; override with
+// -DOTA_URL=... to test against lib/ota_standin.py
+#ifndef OTA_URL
+#define OTA_URL "https://time.enslaves.us/ota/from/%s.img"
+#endif
+
+struct ota_stats
+{
+  bool delta;          // a patch against the running app came instead
+  uint32_t resumed_at; // bytes already in flash from an earlier attempt
+  uint32_t size;
+  uint32_t received; // body bytes over the network, including any thrown away
+  uint32_t retries;
+  uint32_t transfer_ms; // time spent in requests, without the backoff between them
+  uint32_t stall_ms;    // waits of OTA_STALL_MS or more for the next byte
+  uint32_t bytes_per_sec;
+};
+
+// the last download_ota()
+extern ota_stats ota_last;
+
+// Downloads the image at url into the next update partition and sets it to
+// boot. This goes through TlsClient rather than esp_https_ota, so the OTA
+// server's session sits in the same cache as the feeds'. Progress is kept
+// on SPIFFS; a dropped connection, here or in an earlier attempt, carries
+// on from there with a Range request. The server may answer with a delta
+// (src/delta.h) instead of the image.
+esp_err_t download_ota(const char *url);
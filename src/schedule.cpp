@@ -0,0 +1,101 @@
+#include "schedule.h"
+
+// +-percent
+static uint32_t jittered(uint32_t delay, uint32_t percent, uint32_t rnd)
+{
+  uint32_t spread = delay * percent / 100;
+  if (!spread)
+  {
+    return delay;
+  }
+  return delay - spread + rnd % (2 * spread + 1);
+}
+
+void fetch_schedule::reset()
+{
+  next = 0;
+  interval = 3600;
+  failures = 0;
+  last_failure = FAIL_NONE;
+  last_http_code = 0;
+}
+
+void fetch_schedule::success(time_t now, bool changed, uint32_t rnd)
+{
+  if (!interval)
+  {
+    interval = 3600;
+  }
+  // a feed that just changed is likely to again soon
+  interval = changed ? interval / 2 : interval + interval / 2;
+  if (interval < FETCH_MIN_INTERVAL)
+  {
+    interval = FETCH_MIN_INTERVAL;
+  }
+  if (interval > FETCH_MAX_INTERVAL)
+  {
+    interval = FETCH_MAX_INTERVAL;
+  }
+  failures = 0;
+  last_failure = FAIL_NONE;
+  last_http_code = 0;
+  next = now + jittered(interval, 10, rnd);
+}
+
+void fetch_schedule::failure(time_t now, fetch_failure why, int http_code, uint32_t rnd)
+{
+  // what a first retry waits: the network coming back is quick, a server
+  // refusing or a broken feed much less so
+  uint32_t base;
+  switch (why)
+  {
+  case FAIL_DNS:
+  case FAIL_CONNECT:
+    base = 60;
+    break;
+  case FAIL_HTTP:
+    base = http_code >= 500 || http_code == 429 ? 300 : 1800;
+    break;
+  case FAIL_PARSE:
+    base = 1800;
+    break;
+  default:
+    base = 300;
+    break;
+  }
+  if (why != last_failure)
+  {
+    failures = 0;
+  }
+  uint32_t delay = base;
+  for (uint16_t i = 0; i < failures && delay < FETCH_MAX_BACKOFF; ++i)
+  {
+    delay *= 2;
+  }
+  if (delay > FETCH_MAX_BACKOFF)
+  {
+    delay = FETCH_MAX_BACKOFF;
+  }
+  if (failures < UINT16_MAX)
+  {
+    failures++;
+  }
+  last_failure = why;
+  last_http_code = http_code;
+  next = now + jittered(delay, 25, rnd);
+}
+
+bool fetch_schedule::due(time_t now, time_t next_alarm) const
+{
+  if (now < next)
+  {
+    return false;
+  }
+  return !next_alarm || next_alarm <= now || next_alarm - now > FETCH_ALARM_GUARD;
+}
+
+const char *fetch_failure_name(fetch_failure f)
+{
+  static const char *names[] = {"none", "dns", "connect", "tls", "http", "parse"};
+  return f <= FAIL_PARSE ? names[f] : "?";
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+
+// Decides when feeds are next fetched: sooner while they keep changing,
+// later while they don't, backing off after failures by what kind of
+// failure it was, and never right before an alarm. Delays get jitter so a
+// houseful of clocks doesn't hit the server in step.
+
+enum fetch_failure
+{
+  FAIL_NONE,
+  FAIL_DNS,
+  FAIL_CONNECT,
+  FAIL_TLS,
+  FAIL_HTTP, // see the code: 5xx and 429 are retried sooner than the rest
+  FAIL_PARSE,
+};
+
+#define FETCH_MIN_INTERVAL (15 * 60)
+#define FETCH_MAX_INTERVAL (2 * 3600)
+#define FETCH_MAX_BACKOFF (4 * 3600)
+// no fetch starts this close before an alarm
+#define FETCH_ALARM_GUARD (5 * 60)
+
+struct fetch_schedule
+{
+  time_t next; // 0 fetches as soon as possible
+  uint32_t interval; // after a success
+  uint16_t failures; // in a row
+  fetch_failure last_failure;
+  int last_http_code;
+
+  void reset();
+  // rnd is any random number, for jitter
+  void success(time_t now, bool changed, uint32_t rnd);
+  void failure(time_t now, fetch_failure why, int http_code, uint32_t rnd);
+  bool due(time_t now, time_t next_alarm) const;
+};
+
+const char *fetch_failure_name(fetch_failure f);
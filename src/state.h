@@ -0,0 +1,44 @@
+#pragma once
+
+#include <Arduino.h>
+#include <time.h>
+
+#define MAX_OFFSETS 4
+#define MAX_ALARMS 100
+#define ALARM_NAME_LEN 20
+#define MAX_FEEDS 3
+#define FEED_URL_LEN 256
+
+struct tz_offset
+{
+  time_t start;
+  uint32_t offset;
+  unsigned char buffer[8];
+};
+
+struct alarm_entry
+{
+  time_t start;
+  unsigned char name[ALARM_NAME_LEN];
+};
+
+struct clock_state
+{
+  tz_offset offsets[MAX_OFFSETS];
+  size_t num_offsets;
+  alarm_entry alarms[MAX_ALARMS];
+  size_t num_alarms;
+  time_t alarm_skip;
+  char feed_url[FEED_URL_LEN];
+  // everything below was appended, so data saved before it still loads
+  char filter[256];
+  char more_feed_urls[MAX_FEEDS - 1][FEED_URL_LEN];
+};
+
+extern clock_state state;
+
+// feed 0 is feed_url, the rest are more_feed_urls
+static inline char *state_feed_url(size_t feed)
+{
+  return feed == 0 ? state.feed_url : state.more_feed_urls[feed - 1];
+}
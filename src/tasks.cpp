@@ -0,0 +1,84 @@
+#include "tasks.h"
+#include <algorithm>
+#include <vector>
+
+// Network and parsing work stays at idle priority, as it always ran: a
+// long parse then shares core 0 with the idle task instead of starving it
+// into the task watchdog. Flash writes are short and go ahead of it. beep
+// outranks loop() so an alarm doesn't wait for a redraw.
+const task_spec task_specs[NUM_TASKS] = {
+    {"beep", 1024, 2, UI_CORE},
+    {"ota", 8192, tskIDLE_PRIORITY, NET_CORE},
+    {"fetch", 8192, tskIDLE_PRIORITY, NET_CORE},
+    {"feed", 8192, tskIDLE_PRIORITY, NET_CORE},
+    {"save", 4096, 1, NET_CORE},
+    {"telemetry", 3072, tskIDLE_PRIORITY, NET_CORE},
+    {"trace", 4096, tskIDLE_PRIORITY, NET_CORE},
+};
+
+TaskHandle_t task_start(task_id id, TaskFunction_t fn, const char *name)
+{
+  const task_spec &spec = task_specs[id];
+  TaskHandle_t handle = NULL;
+  if (xTaskCreatePinnedToCore(fn, name ? name : spec.name, spec.stack, NULL, spec.priority, &handle, spec.core) !=
+      pdPASS)
+  {
+    Serial.printf("couldn't start task %s\n", name ? name : spec.name);
+  }
+  return handle;
+}
+
+// counters as of the last sample, by task
+static std::vector<TaskHandle_t> last_handle;
+static std::vector<uint32_t> last_runtime;
+static uint32_t last_total;
+
+size_t task_sample(task_usage *out, size_t max)
+{
+  // uxTaskGetSystemState() gives nothing at all if there are more tasks
+  // than room, so size it from the count, with some for tasks started since
+  std::vector<TaskStatus_t> status(uxTaskGetNumberOfTasks() + 4);
+  uint32_t total;
+  size_t n = uxTaskGetSystemState(status.data(), status.size(), &total);
+  if (!n)
+  {
+    Serial.printf("more than %u tasks to sample\n", status.size());
+    return 0;
+  }
+  uint32_t elapsed = total - last_total;
+
+  std::vector<task_usage> usage(n);
+  for (size_t i = 0; i < n; ++i)
+  {
+    uint32_t before = 0;
+    for (size_t j = 0; j < last_handle.size(); ++j)
+    {
+      if (last_handle[j] == status[i].xHandle)
+      {
+        before = last_runtime[j];
+        break;
+      }
+    }
+    task_usage &u = usage[i];
+    strlcpy(u.name, status[i].pcTaskName, sizeof(u.name));
+    BaseType_t core = xTaskGetAffinity(status[i].xHandle);
+    u.core = core == tskNO_AFFINITY ? -1 : core;
+    u.priority = status[i].uxCurrentPriority;
+    u.stack_free = status[i].usStackHighWaterMark; // bytes, on esp-idf
+    u.cpu_permille = elapsed ? (uint64_t)(status[i].ulRunTimeCounter - before) * 1000 / elapsed : 0;
+  }
+  last_handle.resize(n);
+  last_runtime.resize(n);
+  for (size_t i = 0; i < n; ++i)
+  {
+    last_handle[i] = status[i].xHandle;
+    last_runtime[i] = status[i].ulRunTimeCounter;
+  }
+  last_total = total;
+
+  std::sort(usage.begin(), usage.end(),
+            [](const task_usage &a, const task_usage &b) { return a.cpu_permille > b.cpu_permille; });
+  size_t count = std::min(n, max);
+  std::copy(usage.begin(), usage.begin() + count, out);
+  return count;
+}
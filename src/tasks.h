@@ -0,0 +1,52 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Where every task runs, in one place. loop() and LVGL get core 1 to
+// themselves (sdkconfig pins Arduino's loopTask there, at priority 1), and
+// anything that blocks on the network, parses or writes flash goes on core
+// 0 with the wifi and lwip tasks, so it can't preempt a redraw.
+#define UI_CORE 1
+#define NET_CORE 0
+
+enum task_id
+{
+  TASK_BEEP,
+  TASK_OTA,
+  TASK_FETCH,
+  TASK_FEED, // one per feed
+  TASK_SAVE,
+  TASK_TELEMETRY,
+  TASK_TRACE,
+  NUM_TASKS,
+};
+
+struct task_spec
+{
+  const char *name;
+  uint32_t stack;
+  UBaseType_t priority;
+  BaseType_t core;
+};
+
+extern const task_spec task_specs[NUM_TASKS];
+
+// name overrides the spec's, for tasks started more than once
+TaskHandle_t task_start(task_id id, TaskFunction_t fn, const char *name = NULL);
+
+// how many tasks a sample reports, the busiest
+#define TASK_REPORT_MAX 24
+
+struct task_usage
+{
+  char name[16];
+  int core; // -1 if not pinned
+  UBaseType_t priority;
+  uint16_t cpu_permille; // of one core, since the last sample
+  uint32_t stack_free;   // fewest bytes the stack has ever had left
+};
+
+// fills out with the busiest max tasks, busiest first; returns how many.
+// Call at least every 71 minutes, when the 32 bit microsecond run time
+// counters wrap.
+size_t task_sample(task_usage *out, size_t max);
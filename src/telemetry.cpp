@@ -0,0 +1,110 @@
+#include "telemetry.h"
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+
+static telemetry_sample latest;
+static SemaphoreHandle_t latest_mutex;
+
+static void heap_sample(heap_usage &h, uint32_t caps)
+{
+  h.free = heap_caps_get_free_size(caps);
+  h.min_free = heap_caps_get_minimum_free_size(caps);
+  h.largest = heap_caps_get_largest_free_block(caps);
+}
+
+static void append_heap(String &out, const char *name, const heap_usage &h)
+{
+  char line[96];
+  snprintf(line, sizeof(line), "%s: %u free, %u at least, %u largest\n", name, h.free, h.min_free, h.largest);
+  out += line;
+}
+
+static void format(String &out, const telemetry_sample &s)
+{
+  char line[128];
+  snprintf(line, sizeof(line), "uptime %u s\n", s.uptime_s);
+  out += line;
+  append_heap(out, "heap", s.internal);
+  if (s.psram.free || s.psram.largest)
+  {
+    append_heap(out, "psram", s.psram);
+  }
+  const tls_cache_stats &tls = s.tls;
+  uint32_t full = tls.handshakes - tls.resumed - tls.failures;
+  snprintf(line, sizeof(line), "tls: %u handshakes, %u failed, %u of %u offered sessions resumed (%u%%)\n",
+           tls.handshakes, tls.failures, tls.resumed, tls.offered, tls.offered ? tls.resumed * 100 / tls.offered : 0);
+  out += line;
+  snprintf(line, sizeof(line), "tls: %u ms a full handshake, %u ms resumed, %u ms the last\n",
+           full ? (uint32_t)(tls.full_ms / full) : 0, tls.resumed ? (uint32_t)(tls.resumed_ms / tls.resumed) : 0,
+           tls.last_handshake_ms);
+  out += line;
+  if (s.flip.count)
+  {
+    snprintf(line, sizeof(line), "display flip: %u us after the second, jitter %u us, worst %u us, worst wake %u us\n",
+             flip_mean_us(s.flip), flip_jitter_us(s.flip), s.flip.max_us, s.flip.wake_max_us);
+    out += line;
+  }
+  out += "task             core prio  cpu%  stack free\n";
+  for (size_t i = 0; i < s.num_tasks; ++i)
+  {
+    const task_usage &t = s.tasks[i];
+    snprintf(line, sizeof(line), "%-16s %4c %4u %3u.%u %11u%s\n", t.name, t.core < 0 ? '*' : '0' + t.core, t.priority,
+             t.cpu_permille / 10, t.cpu_permille % 10, t.stack_free, t.stack_free < TELEMETRY_STACK_LOW ? " LOW" : "");
+    out += line;
+  }
+}
+
+static void telemetry(void *)
+{
+  static telemetry_sample s;
+  size_t was_low = 0;
+  for (uint32_t n = 0;; ++n)
+  {
+    s.at = time(NULL);
+    s.uptime_s = esp_timer_get_time() / 1000000;
+    s.num_tasks = task_sample(s.tasks, TASK_REPORT_MAX);
+    heap_sample(s.internal, MALLOC_CAP_INTERNAL);
+    heap_sample(s.psram, MALLOC_CAP_SPIRAM);
+    s.tls = tls_stats_copy();
+    s.flip = flip_last_copy();
+
+    size_t low = 0;
+    for (size_t i = 0; i < s.num_tasks; ++i)
+    {
+      low += s.tasks[i].stack_free < TELEMETRY_STACK_LOW;
+    }
+
+    xSemaphoreTake(latest_mutex, portMAX_DELAY);
+    latest = s;
+    xSemaphoreGive(latest_mutex);
+
+    // the first sample's cpu covers all of boot, which isn't interesting
+    if (n && (low > was_low || n % TELEMETRY_LOG_EVERY == 0))
+    {
+      String text;
+      format(text, s);
+      Serial.print(text);
+    }
+    was_low = low;
+    vTaskDelay(TELEMETRY_INTERVAL_MS / portTICK_PERIOD_MS);
+  }
+}
+
+void telemetry_begin()
+{
+  latest_mutex = xSemaphoreCreateMutex();
+  task_start(TASK_TELEMETRY, telemetry);
+}
+
+String telemetry_text()
+{
+  String out;
+  if (!latest_mutex)
+  {
+    return out;
+  }
+  xSemaphoreTake(latest_mutex, portMAX_DELAY);
+  format(out, latest);
+  xSemaphoreGive(latest_mutex);
+  return out;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <Arduino.h>
+#include "tasks.h"
+#include "tls.h"
+#include "ticker.h"
+
+// Every task's CPU share and stack headroom, how much heap is left and in
+// how big a piece, the TLS session cache's totals, and how late the last
+// hour's display flips were, sampled each minute on the telemetry task.
+// The latest sample is served at /telemetry on the web portal, and logged
+// to serial hourly, or straight away when a stack gets low.
+#define TELEMETRY_INTERVAL_MS 60000
+#define TELEMETRY_LOG_EVERY 60
+// a stack with less than this left is called out
+#define TELEMETRY_STACK_LOW 256
+
+struct heap_usage
+{
+  uint32_t free;
+  uint32_t min_free; // since boot
+  uint32_t largest;  // biggest block malloc could hand out now
+};
+
+struct telemetry_sample
+{
+  time_t at;
+  uint32_t uptime_s;
+  size_t num_tasks;
+  task_usage tasks[TASK_REPORT_MAX];
+  heap_usage internal;
+  heap_usage psram; // all 0 without PSRAM
+  tls_cache_stats tls;
+  flip_stats flip; // the last full FLIP_WINDOW, count 0 before there is one
+};
+
+// starts the telemetry task
+void telemetry_begin();
+
+// the latest sample as text, for serial or http
+String telemetry_text();
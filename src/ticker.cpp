@@ -0,0 +1,109 @@
+#include "ticker.h"
+#include <esp_timer.h>
+#include <sys/time.h>
+#include <math.h>
+
+// the coarse wait stops this far short of the edge
+#define TICK_FINE_US 10000
+// a wake this soon after an edge is for that edge
+#define TICK_LATE_US 10000
+
+flip_stats flip_window, flip_last;
+
+static esp_timer_handle_t tick_timer;
+static TaskHandle_t tick_task;
+static volatile int64_t notified_at;
+static SemaphoreHandle_t flip_mutex; // for flip_last, read by other tasks
+
+static void tick(void *)
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  if (tv.tv_usec < TICK_LATE_US)
+  {
+    notified_at = esp_timer_get_time();
+    xTaskNotifyGive(tick_task);
+  }
+  uint32_t to_edge = 1000000 - tv.tv_usec;
+  esp_timer_start_once(tick_timer, to_edge > 2 * TICK_FINE_US ? to_edge - TICK_FINE_US : to_edge);
+}
+
+void ticker_begin()
+{
+  flip_mutex = xSemaphoreCreateMutex();
+  tick_task = xTaskGetCurrentTaskHandle();
+  esp_timer_create_args_t args = {};
+  args.callback = tick;
+  args.name = "tick";
+  esp_timer_create(&args, &tick_timer);
+  esp_timer_start_once(tick_timer, 1000);
+}
+
+void ticker_wait(uint32_t max_ms)
+{
+  if (ulTaskNotifyTake(pdTRUE, max_ms / portTICK_PERIOD_MS))
+  {
+    uint32_t late = esp_timer_get_time() - notified_at;
+    if (late > flip_window.wake_max_us)
+    {
+      flip_window.wake_max_us = late;
+    }
+  }
+}
+
+void ticker_flipped()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  uint32_t late = tv.tv_usec;
+  flip_window.count++;
+  flip_window.sum_us += late;
+  flip_window.sum_sq_us += (uint64_t)late * late;
+  if (late > flip_window.max_us)
+  {
+    flip_window.max_us = late;
+  }
+  if (flip_window.count == FLIP_WINDOW)
+  {
+    if (flip_mutex)
+    {
+      xSemaphoreTake(flip_mutex, portMAX_DELAY);
+    }
+    flip_last = flip_window;
+    if (flip_mutex)
+    {
+      xSemaphoreGive(flip_mutex);
+    }
+    bzero(&flip_window, sizeof(flip_window));
+    Serial.printf("display flip %u us after the second, jitter %u us, worst %u us, worst wake %u us\n",
+                  flip_mean_us(flip_last), flip_jitter_us(flip_last), flip_last.max_us, flip_last.wake_max_us);
+  }
+}
+
+flip_stats flip_last_copy()
+{
+  if (!flip_mutex)
+  {
+    return flip_last;
+  }
+  xSemaphoreTake(flip_mutex, portMAX_DELAY);
+  flip_stats s = flip_last;
+  xSemaphoreGive(flip_mutex);
+  return s;
+}
+
+uint32_t flip_mean_us(const flip_stats &s)
+{
+  return s.count ? s.sum_us / s.count : 0;
+}
+
+uint32_t flip_jitter_us(const flip_stats &s)
+{
+  if (!s.count)
+  {
+    return 0;
+  }
+  double mean = (double)s.sum_us / s.count;
+  double var = (double)s.sum_sq_us / s.count - mean * mean;
+  return var > 0 ? sqrt(var) : 0;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Wakes loop() as the system clock's seconds turn over, rather than it
+// finding out on its next 5 ms poll. An esp_timer is aimed a little short
+// of each edge and then at the edge itself, since the system clock can be
+// slewing against esp_timer.
+
+// how late, after the second edge, the display finished changing
+struct flip_stats
+{
+  uint32_t count;
+  uint32_t max_us;
+  uint64_t sum_us;
+  uint64_t sum_sq_us;
+  uint32_t wake_max_us; // worst from an edge to loop() running
+};
+
+#define FLIP_WINDOW 3600
+
+// the window being filled, and the last full one
+extern flip_stats flip_window, flip_last;
+
+// notifies the calling task at each edge
+void ticker_begin();
+
+// returns at the next edge, or after max_ms
+void ticker_wait(uint32_t max_ms);
+
+// call once the display shows the new second
+void ticker_flipped();
+
+// a copy of flip_last, for another task to report
+flip_stats flip_last_copy();
+
+uint32_t flip_mean_us(const flip_stats &s);
+uint32_t flip_jitter_us(const flip_stats &s); // standard deviation
@@ -0,0 +1,460 @@
+#include "tls.h"
+#include <SPIFFS.h>
+#include <esp_crt_bundle.h>
+#include <esp_timer.h>
+#include <mbedtls/ssl.h>
+#include <lwip/sockets.h>
+
+#define TLS_TIMEOUT_MS 10000
+#define TLS_SESSION_FILE "/tls.ses"
+
+tls_cache_stats tls_stats;
+
+struct tls_cache_entry
+{
+  char host[64];
+  uint16_t port;
+  uint32_t used; // tick of last use, the oldest goes first
+  esp_tls_client_session_t *session;
+};
+
+static tls_cache_entry cache[TLS_CACHE_SIZE];
+static SemaphoreHandle_t cache_mutex;
+
+static void free_session(esp_tls_client_session_t *session)
+{
+  if (session)
+  {
+    mbedtls_ssl_session_free(&session->saved_session);
+    free(session);
+  }
+}
+
+// sessions are serialized to copy them, which is also the persisted format
+static unsigned char *save_session(const esp_tls_client_session_t *session, size_t *len)
+{
+  *len = 0;
+  mbedtls_ssl_session_save(&session->saved_session, NULL, 0, len);
+  unsigned char *data = (unsigned char *)malloc(*len);
+  if (data && mbedtls_ssl_session_save(&session->saved_session, data, *len, len) != 0)
+  {
+    free(data);
+    data = NULL;
+  }
+  return data;
+}
+
+static esp_tls_client_session_t *load_session(const unsigned char *data, size_t len)
+{
+  esp_tls_client_session_t *session = (esp_tls_client_session_t *)calloc(1, sizeof(esp_tls_client_session_t));
+  if (!session)
+  {
+    return NULL;
+  }
+  mbedtls_ssl_session_init(&session->saved_session);
+  if (mbedtls_ssl_session_load(&session->saved_session, data, len) != 0)
+  {
+    free_session(session);
+    return NULL;
+  }
+  return session;
+}
+
+static esp_tls_client_session_t *copy_session(const esp_tls_client_session_t *session)
+{
+  size_t len;
+  unsigned char *data = save_session(session, &len);
+  if (!data)
+  {
+    return NULL;
+  }
+  esp_tls_client_session_t *copy = load_session(data, len);
+  free(data);
+  return copy;
+}
+
+static tls_cache_entry *find_entry(const char *host, uint16_t port)
+{
+  for (size_t i = 0; i < TLS_CACHE_SIZE; i++)
+  {
+    if (cache[i].session && cache[i].port == port && !strcmp(cache[i].host, host))
+    {
+      return &cache[i];
+    }
+  }
+  return NULL;
+}
+
+#if PERSIST_TLS_SESSIONS
+// [char host[64]][u16 port][u32 len][len bytes] per entry; caller holds the mutex
+static void persist_cache()
+{
+  File f = SPIFFS.open(TLS_SESSION_FILE ".tmp", "w");
+  if (!f)
+  {
+    return;
+  }
+  for (size_t i = 0; i < TLS_CACHE_SIZE; i++)
+  {
+    size_t len;
+    unsigned char *data = cache[i].session ? save_session(cache[i].session, &len) : NULL;
+    if (data)
+    {
+      uint32_t len32 = len;
+      f.write((const uint8_t *)cache[i].host, sizeof(cache[i].host));
+      f.write((const uint8_t *)&cache[i].port, sizeof(cache[i].port));
+      f.write((const uint8_t *)&len32, sizeof(len32));
+      f.write(data, len);
+      free(data);
+    }
+  }
+  f.close();
+  SPIFFS.remove(TLS_SESSION_FILE);
+  SPIFFS.rename(TLS_SESSION_FILE ".tmp", TLS_SESSION_FILE);
+}
+
+static void restore_cache()
+{
+  File f = SPIFFS.open(TLS_SESSION_FILE, "r");
+  if (!f)
+  {
+    return;
+  }
+  for (size_t i = 0; i < TLS_CACHE_SIZE; i++)
+  {
+    tls_cache_entry &e = cache[i];
+    uint32_t len;
+    if (f.read((uint8_t *)e.host, sizeof(e.host)) != sizeof(e.host) ||
+        f.read((uint8_t *)&e.port, sizeof(e.port)) != sizeof(e.port) ||
+        f.read((uint8_t *)&len, sizeof(len)) != sizeof(len) || len > 4096)
+    {
+      break;
+    }
+    unsigned char *data = (unsigned char *)malloc(len);
+    if (!data)
+    {
+      break;
+    }
+    if (f.read(data, len) == len)
+    {
+      e.host[sizeof(e.host) - 1] = 0;
+      e.session = load_session(data, len);
+    }
+    free(data);
+  }
+  f.close();
+}
+#endif
+
+void tls_cache_begin()
+{
+  cache_mutex = xSemaphoreCreateMutex();
+#if PERSIST_TLS_SESSIONS
+  restore_cache();
+#endif
+}
+
+// a private copy of the cached session for host, so another connection
+// replacing it mid-handshake can't pull it out from under us
+static esp_tls_client_session_t *cache_get(const char *host, uint16_t port)
+{
+  if (!cache_mutex)
+  {
+    return NULL;
+  }
+  xSemaphoreTake(cache_mutex, portMAX_DELAY);
+  tls_cache_entry *e = find_entry(host, port);
+  esp_tls_client_session_t *copy = e ? copy_session(e->session) : NULL;
+  xSemaphoreGive(cache_mutex);
+  return copy;
+}
+
+// takes ownership of session
+static void cache_put(const char *host, uint16_t port, esp_tls_client_session_t *session)
+{
+  if (!cache_mutex || strlen(host) >= sizeof(cache[0].host))
+  {
+    free_session(session);
+    return;
+  }
+  xSemaphoreTake(cache_mutex, portMAX_DELAY);
+  tls_cache_entry *e = find_entry(host, port);
+  if (!e)
+  {
+    e = &cache[0];
+    for (size_t i = 1; i < TLS_CACHE_SIZE && e->session; i++)
+    {
+      if (!cache[i].session || cache[i].used < e->used)
+      {
+        e = &cache[i];
+      }
+    }
+    strcpy(e->host, host);
+    e->port = port;
+  }
+  free_session(e->session);
+  e->session = session;
+  e->used = xTaskGetTickCount();
+#if PERSIST_TLS_SESSIONS
+  persist_cache();
+#endif
+  xSemaphoreGive(cache_mutex);
+}
+
+// every feed worker handshakes at once; returns the stats after this one
+static tls_cache_stats count_handshake(bool offered, bool ok, bool resumed, uint32_t ms)
+{
+  if (cache_mutex)
+  {
+    xSemaphoreTake(cache_mutex, portMAX_DELAY);
+  }
+  tls_stats.handshakes++;
+  tls_stats.last_handshake_ms = ms;
+  if (offered)
+  {
+    tls_stats.offered++;
+  }
+  if (!ok)
+  {
+    tls_stats.failures++;
+  }
+  else if (resumed)
+  {
+    tls_stats.resumed++;
+    tls_stats.resumed_ms += ms;
+  }
+  else
+  {
+    tls_stats.full_ms += ms;
+  }
+  tls_cache_stats stats = tls_stats;
+  if (cache_mutex)
+  {
+    xSemaphoreGive(cache_mutex);
+  }
+  return stats;
+}
+
+tls_cache_stats tls_stats_copy()
+{
+  if (!cache_mutex)
+  {
+    return tls_stats;
+  }
+  xSemaphoreTake(cache_mutex, portMAX_DELAY);
+  tls_cache_stats stats = tls_stats;
+  xSemaphoreGive(cache_mutex);
+  return stats;
+}
+
+TlsClient::TlsClient() : error(ESP_OK), tls(NULL), peeked(-1), closed(false)
+{
+}
+
+TlsClient::~TlsClient()
+{
+  stop();
+}
+
+int TlsClient::connect(IPAddress ip, uint16_t port)
+{
+  return connect(ip.toString().c_str(), port, TLS_TIMEOUT_MS);
+}
+
+int TlsClient::connect(IPAddress ip, uint16_t port, int32_t timeout)
+{
+  return connect(ip.toString().c_str(), port, timeout);
+}
+
+int TlsClient::connect(const char *host, uint16_t port)
+{
+  return connect(host, port, TLS_TIMEOUT_MS);
+}
+
+int TlsClient::connect(const char *host, uint16_t port, int32_t timeout)
+{
+  stop();
+  error = ESP_OK;
+  tls = esp_tls_init();
+  if (!tls)
+  {
+    error = ESP_ERR_NO_MEM;
+    return 0;
+  }
+
+  esp_tls_client_session_t *offered = cache_get(host, port);
+  esp_tls_cfg_t cfg = {};
+  cfg.crt_bundle_attach = esp_crt_bundle_attach;
+  cfg.timeout_ms = timeout > 0 ? timeout : TLS_TIMEOUT_MS;
+  cfg.client_session = offered;
+
+  int64_t started = esp_timer_get_time();
+  int ret = esp_tls_conn_new_sync(host, strlen(host), port, &cfg, tls);
+  uint32_t ms = (esp_timer_get_time() - started) / 1000;
+
+  if (ret != 1)
+  {
+    count_handshake(offered, false, false, ms);
+    error = esp_tls_get_and_clear_last_error(tls->error_handle, NULL, NULL);
+    Serial.printf("tls %s:%u failed after %u ms: %s\n", host, port, ms, esp_err_to_name(error));
+    free_session(offered);
+    stop();
+    return 0;
+  }
+
+  // a server resuming a session echoes its id (RFC 5077 for tickets too)
+  esp_tls_client_session_t *session = esp_tls_get_client_session(tls);
+  bool resumed = offered && session && offered->saved_session.id_len &&
+                 session->saved_session.id_len == offered->saved_session.id_len &&
+                 !memcmp(session->saved_session.id, offered->saved_session.id, offered->saved_session.id_len);
+  tls_cache_stats stats = count_handshake(offered, true, resumed, ms);
+  free_session(offered);
+  if (session)
+  {
+    cache_put(host, port, session);
+  }
+  Serial.printf("tls %s:%u %s handshake %u ms, %u of %u offered sessions resumed\n", host, port,
+                resumed ? "resumed" : "full", ms, stats.resumed, stats.offered);
+  return 1;
+}
+
+size_t TlsClient::write(uint8_t data)
+{
+  return write(&data, 1);
+}
+
+size_t TlsClient::write(const uint8_t *buf, size_t size)
+{
+  size_t written = 0;
+  while (tls && !closed && written < size)
+  {
+    ssize_t ret = esp_tls_conn_write(tls, buf + written, size - written);
+    if (ret > 0)
+    {
+      written += ret;
+    }
+    else if (ret != ESP_TLS_ERR_SSL_WANT_WRITE && ret != ESP_TLS_ERR_SSL_WANT_READ)
+    {
+      closed = true;
+    }
+  }
+  return written;
+}
+
+int TlsClient::available()
+{
+  if (!tls)
+  {
+    return 0;
+  }
+  ssize_t buffered = esp_tls_get_bytes_avail(tls);
+  if (buffered < 0)
+  {
+    buffered = 0;
+  }
+  if (peeked < 0 && !buffered && !closed)
+  {
+    // nothing decrypted yet; only read (which blocks for the whole record)
+    // if the socket has something, and keep the first byte
+    int fd;
+    fd_set set;
+    timeval tv = {0, 0};
+    if (esp_tls_get_conn_sockfd(tls, &fd) == ESP_OK && fd >= 0)
+    {
+      FD_ZERO(&set);
+      FD_SET(fd, &set);
+      if (select(fd + 1, &set, NULL, NULL, &tv) > 0)
+      {
+        uint8_t b;
+        ssize_t ret = esp_tls_conn_read(tls, &b, 1);
+        if (ret == 1)
+        {
+          peeked = b;
+        }
+        else if (ret != ESP_TLS_ERR_SSL_WANT_READ && ret != ESP_TLS_ERR_SSL_WANT_WRITE)
+        {
+          closed = true;
+        }
+        buffered = esp_tls_get_bytes_avail(tls);
+        if (buffered < 0)
+        {
+          buffered = 0;
+        }
+      }
+    }
+  }
+  return buffered + (peeked >= 0);
+}
+
+int TlsClient::read()
+{
+  uint8_t b;
+  return read(&b, 1) == 1 ? b : -1;
+}
+
+int TlsClient::read(uint8_t *buf, size_t size)
+{
+  if (!size || !available())
+  {
+    return -1;
+  }
+  size_t got = 0;
+  if (peeked >= 0)
+  {
+    buf[got++] = peeked;
+    peeked = -1;
+  }
+  ssize_t buffered = esp_tls_get_bytes_avail(tls);
+  if (got < size && buffered > 0)
+  {
+    size_t want = size - got < (size_t)buffered ? size - got : buffered;
+    ssize_t ret = esp_tls_conn_read(tls, buf + got, want);
+    if (ret > 0)
+    {
+      got += ret;
+    }
+  }
+  return got;
+}
+
+int TlsClient::peek()
+{
+  if (peeked < 0 && available())
+  {
+    uint8_t b;
+    if (read(&b, 1) == 1)
+    {
+      peeked = b;
+    }
+  }
+  return peeked;
+}
+
+void TlsClient::flush()
+{
+}
+
+void TlsClient::stop()
+{
+  if (tls)
+  {
+    esp_tls_conn_destroy(tls);
+    tls = NULL;
+  }
+  peeked = -1;
+  closed = false;
+}
+
+uint8_t TlsClient::connected()
+{
+  return tls && (!closed || available());
+}
+
+bool http_begin(HTTPClient &http, TlsClient &tls, const char *url)
+{
+  if (!strncmp(url, "https://", 8))
+  {
+    return http.begin(tls, url);
+  }
+  return http.begin(url);
+}
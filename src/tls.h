@@ -0,0 +1,68 @@
+#pragma once
+
+#include <Arduino.h>
+#include <WiFiClient.h>
+#include <HTTPClient.h>
+#include <esp_tls.h>
+
+// Sessions are kept per host:port across connections, so feed fetches and
+// OTA can resume instead of doing a full handshake every time. Saving them
+// to SPIFFS keeps them across reboots, but puts session secrets in flash.
+#define TLS_CACHE_SIZE 4
+#define PERSIST_TLS_SESSIONS 0
+
+struct tls_cache_stats
+{
+  uint32_t handshakes;
+  uint32_t offered;  // a cached session was offered
+  uint32_t resumed;  // ... and the server took it
+  uint32_t failures;
+  uint32_t last_handshake_ms;
+  uint64_t full_ms;  // total time in handshakes without resumption
+  uint64_t resumed_ms;
+};
+
+// updated under the session cache's mutex, by every connection
+extern tls_cache_stats tls_stats;
+
+// a copy of tls_stats taken under that mutex, for another task to report
+tls_cache_stats tls_stats_copy();
+
+// loads persisted sessions, if any; call once SPIFFS is up
+void tls_cache_begin();
+
+// A WiFiClient doing TLS through esp-tls with the session cache, for
+// HTTPClient::begin(client, url). Certificates are checked against the
+// bundle, like esp_https_ota did.
+class TlsClient : public WiFiClient
+{
+public:
+  TlsClient();
+  ~TlsClient();
+
+  int connect(IPAddress ip, uint16_t port);
+  int connect(IPAddress ip, uint16_t port, int32_t timeout);
+  int connect(const char *host, uint16_t port);
+  int connect(const char *host, uint16_t port, int32_t timeout);
+  size_t write(uint8_t data);
+  size_t write(const uint8_t *buf, size_t size);
+  int available();
+  int read();
+  int read(uint8_t *buf, size_t size);
+  int peek();
+  void flush();
+  void stop();
+  uint8_t connected();
+  operator bool() { return connected(); }
+
+  // why the last connect failed, from esp-tls
+  esp_err_t error;
+
+protected:
+  esp_tls_t *tls;
+  int peeked; // -1 if none
+  bool closed;
+};
+
+// begins http on tls for https:// urls, plain otherwise
+bool http_begin(HTTPClient &http, TlsClient &tls, const char *url);
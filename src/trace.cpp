@@ -0,0 +1,136 @@
+#include "trace.h"
+#include "tasks.h"
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+
+volatile bool trace_on;
+
+static trace_event *ring;
+static uint32_t ring_mask;
+static uint32_t next_slot;
+
+static TaskHandle_t dump_task;
+static Print *volatile dump_out; // set while a dump is going
+static void (*dump_done)(Print *out);
+
+static void dumper(void *)
+{
+  while (1)
+  {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    trace_dump(*dump_out);
+    if (dump_done)
+    {
+      dump_done(dump_out);
+    }
+    dump_out = NULL;
+  }
+}
+
+void trace_setup(bool on)
+{
+  uint32_t size = TRACE_EVENTS;
+  ring = (trace_event *)heap_caps_calloc(size, sizeof(trace_event), MALLOC_CAP_SPIRAM);
+  if (!ring)
+  {
+    size = TRACE_EVENTS / 8;
+    ring = (trace_event *)calloc(size, sizeof(trace_event));
+  }
+  if (!ring)
+  {
+    Serial.println("no memory for trace");
+    return;
+  }
+  ring_mask = size - 1;
+  trace_on = on;
+  dump_task = task_start(TASK_TRACE, dumper);
+}
+
+void trace_start()
+{
+  trace_on = ring != NULL;
+}
+
+void trace_stop()
+{
+  trace_on = false;
+}
+
+void trace_record(const char *name, char phase)
+{
+  uint32_t n = __atomic_fetch_add(&next_slot, 1, __ATOMIC_RELAXED);
+  trace_event &e = ring[n & ring_mask];
+  // a dump skips the slot until it's whole again
+  e.seq = 0;
+  e.ts = esp_timer_get_time();
+  e.name = name;
+  e.task = xTaskGetCurrentTaskHandle();
+  e.phase = phase;
+  __atomic_store_n(&e.seq, n + 1, __ATOMIC_RELEASE);
+}
+
+void trace_dump(Print &out)
+{
+  if (!ring)
+  {
+    out.print("{\"traceEvents\":[]}\n");
+    return;
+  }
+  bool was_on = trace_on;
+  trace_on = false;
+  // let anything already past the check finish its slot
+  vTaskDelay(2);
+
+  uint32_t end = __atomic_load_n(&next_slot, __ATOMIC_ACQUIRE);
+  uint32_t size = ring_mask + 1;
+  uint32_t start = end > size ? end - size : 0;
+
+  TaskHandle_t tasks[TASK_REPORT_MAX];
+  size_t num_tasks = 0;
+  char line[160];
+  const char *sep = "";
+  out.print("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  for (uint32_t n = start; n != end; ++n)
+  {
+    const trace_event &e = ring[n & ring_mask];
+    if (__atomic_load_n(&e.seq, __ATOMIC_ACQUIRE) != n + 1)
+    {
+      continue;
+    }
+    snprintf(line, sizeof(line), "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%lld,\"pid\":1,\"tid\":%u%s}", sep, e.name,
+             e.phase, (long long)e.ts, (unsigned)(uintptr_t)e.task, e.phase == 'i' ? ",\"s\":\"t\"" : "");
+    out.print(line);
+    sep = ",\n";
+
+    size_t t = 0;
+    while (t < num_tasks && tasks[t] != e.task)
+    {
+      ++t;
+    }
+    if (t == num_tasks && num_tasks < TASK_REPORT_MAX)
+    {
+      tasks[num_tasks++] = e.task;
+    }
+  }
+  for (size_t t = 0; t < num_tasks; ++t)
+  {
+    snprintf(line, sizeof(line), "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+             sep, (unsigned)(uintptr_t)tasks[t], pcTaskGetName(tasks[t]));
+    out.print(line);
+    sep = ",\n";
+  }
+  out.print("\n]}\n");
+  trace_on = was_on;
+}
+
+bool trace_dump_async(Print *out, void (*done)(Print *out))
+{
+  if (!dump_task || dump_out)
+  {
+    return false;
+  }
+  dump_done = done;
+  dump_out = out;
+  xTaskNotifyGive(dump_task);
+  return true;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <Arduino.h>
+
+// A ring of begin/end/instant events, timestamped with esp_timer, that
+// dumps as Chrome trace JSON (load it in chrome://tracing or Perfetto).
+// Recording is off until trace_start(); while off, each trace point costs
+// a load and a branch. Any task can record without taking a lock: a slot
+// is claimed with an atomic add and marked complete once written, and the
+// oldest events are overwritten.
+//
+// Names must be string literals, or otherwise live forever.
+
+// build with -DTRACE_AT_BOOT=1 to see startup
+#ifndef TRACE_AT_BOOT
+#define TRACE_AT_BOOT 0
+#endif
+
+// with PSRAM; without, the ring is an eighth of this. A power of two.
+#define TRACE_EVENTS 8192
+
+struct trace_event
+{
+  int64_t ts;
+  const char *name;
+  TaskHandle_t task;
+  char phase; // 'B', 'E' or 'i'
+  volatile uint32_t seq; // slot number + 1 once written
+};
+
+extern volatile bool trace_on;
+
+void trace_record(const char *name, char phase);
+
+static inline void trace_begin(const char *name)
+{
+  if (trace_on)
+    trace_record(name, 'B');
+}
+
+static inline void trace_end(const char *name)
+{
+  if (trace_on)
+    trace_record(name, 'E');
+}
+
+static inline void trace_instant(const char *name)
+{
+  if (trace_on)
+    trace_record(name, 'i');
+}
+
+// begin to end of a block
+struct trace_scope
+{
+  const char *name;
+  trace_scope(const char *name) : name(name)
+  {
+    trace_begin(name);
+  }
+  ~trace_scope()
+  {
+    trace_end(name);
+  }
+};
+
+#define TRACE_CONCAT2(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT2(a, b)
+#define TRACE_SCOPE(name) trace_scope TRACE_CONCAT(trace_scope_, __LINE__)(name)
+
+// allocates the ring; recording starts now if on
+void trace_setup(bool on);
+void trace_start();
+void trace_stop();
+
+// writes what's in the ring as JSON, pausing recording meanwhile
+void trace_dump(Print &out);
+
+// trace_dump() to out from a task of its own, then done(out) there: a full
+// ring is a minute of serial, and loop() has to keep ticking through it.
+// False, and nothing done, if a dump is still going.
+bool trace_dump_async(Print *out, void (*done)(Print *out) = NULL);
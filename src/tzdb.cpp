@@ -0,0 +1,266 @@
+#include "tzdb.h"
+#include <HTTPClient.h>
+#include <SPIFFS.h>
+#include <mbedtls/sha256.h>
+#include "tzpack.h"
+#include "tzhash.h"
+#include "tls.h"
+#include "trace.h"
+
+#define TZDB_FILE "/tz.tzp"
+#define TZDB_NEW_FILE "/tz.new"
+#define TZDB_MAX_SIZE (256 * 1024)
+
+extern const uint8_t fallback_timezones[] asm("_binary_fallback_timezones_tzp_start");
+extern const uint8_t fallback_timezones_end[] asm("_binary_fallback_timezones_tzp_end");
+
+// a pack on SPIFFS, read as each piece is needed
+class tzpack_file : public tzpack_source
+{
+public:
+  File f;
+
+  bool read(uint32_t at, void *buf, size_t len)
+  {
+    return f.seek(at) && f.read((uint8_t *)buf, len) == len;
+  }
+};
+
+static tzpack_memory embedded_source(fallback_timezones, fallback_timezones_end - fallback_timezones);
+static tzpack embedded, downloaded;
+static tzpack_file downloaded_file;
+static const tzpack *zones; // the one in use, NULL if neither opened
+static bool embedded_hashed; // zone numbers from tzhash_find() are the embedded pack's
+// held while a zone is read, and while the downloaded zones are replaced
+static SemaphoreHandle_t tzdb_mutex;
+
+// with tzdb_mutex held
+static void open_downloaded()
+{
+  downloaded.close();
+  if (downloaded_file.f)
+  {
+    downloaded_file.f.close();
+  }
+  zones = embedded.is_open() ? &embedded : NULL;
+  downloaded_file.f = SPIFFS.open(TZDB_FILE, "r");
+  if (!downloaded_file.f)
+  {
+    return;
+  }
+  if (!downloaded.open(&downloaded_file, downloaded_file.f.size()))
+  {
+    Serial.println("downloaded timezones are corrupt");
+    downloaded_file.f.close();
+    return;
+  }
+  if (!zones || strcmp(downloaded.header.release, zones->header.release) > 0)
+  {
+    zones = &downloaded;
+  }
+}
+
+void tzdb_begin()
+{
+  tzdb_mutex = xSemaphoreCreateMutex();
+  if (!embedded.open(&embedded_source, fallback_timezones_end - fallback_timezones))
+  {
+    Serial.println("fallback timezones are corrupt");
+  }
+  embedded_hashed = embedded.is_open() && tzhash_numbers_match(embedded.header.release, embedded.header.num_zones);
+  if (embedded.is_open() && !embedded_hashed)
+  {
+    Serial.println("zone hash doesn't match the fallback timezones");
+  }
+  open_downloaded();
+  Serial.printf("timezones %s from %s\n", tzdb_release(), zones == &downloaded ? "spiffs" : "firmware");
+}
+
+const char *tzdb_release()
+{
+  return zones ? zones->header.release : "";
+}
+
+bool tzdb_load_zone(const char *tzid, uICAL::TZMap_ptr &tzmap)
+{
+  if (!tzdb_mutex)
+  {
+    return false;
+  }
+  bool loaded = false;
+  xSemaphoreTake(tzdb_mutex, portMAX_DELAY);
+  if (zones)
+  {
+    // aliases are loaded under the name they were asked for
+    int known, zone = -1;
+    if (tzhash_find(tzid, &known) < 0)
+    {
+      zone = zones->find(tzid);
+    }
+    else if (zones == &embedded && embedded_hashed)
+    {
+      zone = known;
+    }
+    else
+    {
+      zone = zones->find(tzhash_zone_name(known));
+    }
+    try
+    {
+      loaded = zones->load(zone, tzmap, tzid);
+    }
+    catch (uICAL::Error ex)
+    {
+      Serial.printf("zone %s: %s\n", tzid, ex.message.c_str());
+    }
+  }
+  xSemaphoreGive(tzdb_mutex);
+  return loaded;
+}
+
+// sha256 of a file on SPIFFS, in lowercase hex
+static bool file_sha256(const char *path, char hex[65])
+{
+  File f = SPIFFS.open(path, "r");
+  if (!f)
+  {
+    return false;
+  }
+  mbedtls_sha256_context ctx;
+  mbedtls_sha256_init(&ctx);
+  mbedtls_sha256_starts_ret(&ctx, 0);
+  uint8_t buf[256];
+  size_t n;
+  while ((n = f.read(buf, sizeof(buf))) > 0)
+  {
+    mbedtls_sha256_update_ret(&ctx, buf, n);
+  }
+  f.close();
+  uint8_t digest[32];
+  mbedtls_sha256_finish_ret(&ctx, digest);
+  mbedtls_sha256_free(&ctx);
+  for (int i = 0; i < 32; ++i)
+  {
+    snprintf(hex + 2 * i, 3, "%02x", digest[i]);
+  }
+  return true;
+}
+
+static esp_err_t fetch_hash(const char *url, char hex[65])
+{
+  char hash_url[160];
+  snprintf(hash_url, sizeof(hash_url), "%s.sha256", url);
+  TlsClient tls;
+  HTTPClient http;
+  http.useHTTP10(true);
+  if (!http_begin(http, tls, hash_url))
+  {
+    return ESP_FAIL;
+  }
+  int code = http.GET();
+  if (code != 200)
+  {
+    Serial.printf("tzdb hash http code: %d\n", code);
+    return code < 0 ? ESP_ERR_TIMEOUT : ESP_FAIL;
+  }
+  String body = http.getString();
+  if (body.length() < 64)
+  {
+    return ESP_ERR_INVALID_RESPONSE;
+  }
+  strlcpy(hex, body.c_str(), 65);
+  return ESP_OK;
+}
+
+static esp_err_t fetch_zones(const char *url)
+{
+  TlsClient tls;
+  HTTPClient http;
+  http.useHTTP10(true);
+  if (!http_begin(http, tls, url))
+  {
+    return ESP_FAIL;
+  }
+  int code = http.GET();
+  if (code != 200)
+  {
+    Serial.printf("tzdb http code: %d\n", code);
+    return code < 0 ? ESP_ERR_TIMEOUT : ESP_FAIL;
+  }
+  if (http.getSize() > TZDB_MAX_SIZE)
+  {
+    Serial.printf("tzdb too big: %d\n", http.getSize());
+    return ESP_ERR_INVALID_SIZE;
+  }
+  File f = SPIFFS.open(TZDB_NEW_FILE, "w");
+  if (!f)
+  {
+    return ESP_FAIL;
+  }
+  int written = http.writeToStream(&f);
+  f.close();
+  if (written <= 0 || (http.getSize() > 0 && written != http.getSize()))
+  {
+    Serial.printf("tzdb download failed: %d\n", written);
+    return ESP_ERR_TIMEOUT;
+  }
+  return ESP_OK;
+}
+
+esp_err_t tzdb_update(const char *url)
+{
+  TRACE_SCOPE("tzdb");
+  char want[65], have[65];
+  esp_err_t err = fetch_hash(url, want);
+  if (err != ESP_OK)
+  {
+    return err;
+  }
+  if (file_sha256(TZDB_FILE, have) && strcasecmp(have, want) == 0)
+  {
+    return ESP_OK;
+  }
+
+  err = fetch_zones(url);
+  if (err == ESP_OK && (!file_sha256(TZDB_NEW_FILE, have) || strcasecmp(have, want) != 0))
+  {
+    Serial.printf("tzdb hash mismatch: %s\n", have);
+    err = ESP_ERR_INVALID_CRC;
+  }
+  char release[sizeof(tzpack_header::release)] = "";
+  if (err == ESP_OK)
+  {
+    tzpack_file check;
+    tzpack pack;
+    check.f = SPIFFS.open(TZDB_NEW_FILE, "r");
+    if (!check.f || !pack.open(&check, check.f.size()))
+    {
+      Serial.println("tzdb isn't a valid pack");
+      err = ESP_ERR_INVALID_RESPONSE;
+    }
+    else
+    {
+      strlcpy(release, pack.header.release, sizeof(release));
+    }
+    pack.close();
+    if (check.f)
+    {
+      check.f.close();
+    }
+  }
+  if (err != ESP_OK)
+  {
+    SPIFFS.remove(TZDB_NEW_FILE);
+    return err;
+  }
+
+  xSemaphoreTake(tzdb_mutex, portMAX_DELAY);
+  downloaded.close();
+  downloaded_file.f.close();
+  SPIFFS.remove(TZDB_FILE);
+  SPIFFS.rename(TZDB_NEW_FILE, TZDB_FILE);
+  open_downloaded();
+  xSemaphoreGive(tzdb_mutex);
+  Serial.printf("tzdb %s downloaded, using %s\n", release, tzdb_release());
+  return ESP_OK;
+}
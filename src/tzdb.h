@@ -0,0 +1,28 @@
+#pragma once
+
+#include <Arduino.h>
+#include <esp_err.h>
+#include <uICal.h>
+
+// where the zones are fetched from, a tzpack (src/tzpack.h) with its
+// sha256 in hex at the same url plus ".sha256"; override with
+// -DTZDB_URL=... to test against a local server
+#ifndef TZDB_URL
+#define TZDB_URL "https://time.enslaves.us/tz/zones.tzp"
+#endif
+
+// Opens the embedded fallback zones and the ones last downloaded to SPIFFS,
+// and picks whichever is from the later tz release. Call once SPIFFS is up.
+void tzdb_begin();
+
+// the release of the zones in use, "2022g"
+const char *tzdb_release();
+
+// Adds the zone named tzid to tzmap from the zones in use, reading only
+// that zone; a zone_loader for expand_calendar(). Safe from any task.
+bool tzdb_load_zone(const char *tzid, uICAL::TZMap_ptr &tzmap);
+
+// Fetches the hash at url.sha256, and if it isn't that of the zones on
+// SPIFFS, the zones at url. They replace the old ones only once the hash
+// matches and they open as a valid pack.
+esp_err_t tzdb_update(const char *url);
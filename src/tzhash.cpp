@@ -0,0 +1,52 @@
+#include "tzhash.h"
+#include <string.h>
+
+struct tzhash_slot
+{
+  const char *name;
+  uint16_t zone;
+};
+
+#include "tzhash_table.h"
+
+// FNV-1a, seeded; must match fnv() in lib/gen_tzhash.py
+static uint32_t tzhash(uint32_t seed, const char *key)
+{
+  uint32_t h = 0x811c9dc5 ^ seed;
+  for (const uint8_t *p = (const uint8_t *)key; *p; ++p)
+  {
+    h = (h ^ *p) * 0x01000193;
+  }
+  return h;
+}
+
+int tzhash_find(const char *tzid, int *zone)
+{
+  uint16_t d = tzhash_displace[tzhash(0, tzid) % TZHASH_BUCKETS];
+  int slot = tzhash(d, tzid) % TZHASH_SLOTS;
+  const tzhash_slot &s = tzhash_slots[slot];
+  if (!s.name || strcmp(s.name, tzid) != 0)
+  {
+    return -1;
+  }
+  if (zone)
+  {
+    *zone = s.zone;
+  }
+  return slot;
+}
+
+size_t tzhash_keys()
+{
+  return TZHASH_SLOTS;
+}
+
+const char *tzhash_zone_name(int zone)
+{
+  return zone >= 0 && zone < TZHASH_ZONES ? tzhash_names[zone] : NULL;
+}
+
+bool tzhash_numbers_match(const char *release, uint16_t num_zones)
+{
+  return num_zones == TZHASH_ZONES && strcmp(release, TZHASH_RELEASE) == 0;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// The embedded zones' names and their aliases (Windows names as Outlook
+// writes them, old tz names) in a perfect hash generated by
+// lib/gen_tzhash.py, so looking up a TZID is two hashes and one compare.
+
+// the key number of tzid, below tzhash_keys(), or -1 if it isn't a known
+// name; zone gets the embedded zone it names
+int tzhash_find(const char *tzid, int *zone = NULL);
+
+size_t tzhash_keys();
+
+// the name of embedded zone number zone
+const char *tzhash_zone_name(int zone);
+
+// whether the zone numbers are those of a pack with this release and count
+bool tzhash_numbers_match(const char *release, uint16_t num_zones);
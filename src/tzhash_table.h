@@ -0,0 +1,977 @@
+// generated by lib/gen_tzhash.py from src/fallback_timezones.ics and lib/windows_zones.txt, don't edit
+#define TZHASH_RELEASE "2022g"
+#define TZHASH_ZONES 351
+#define TZHASH_BUCKETS 134
+#define TZHASH_SLOTS 600
+
+static const uint16_t tzhash_displace[TZHASH_BUCKETS] = {
+    15, 104, 12, 16, 3, 9, 21, 2, 1, 77, 2, 1,
+    4, 4, 13, 1, 5, 17, 32, 11, 29, 4, 83, 1,
+    1, 8, 45, 4, 1, 3, 3, 27, 2, 3, 17, 4,
+    26, 19, 30, 0, 2, 9, 18, 1, 74, 46, 2, 0,
+    53, 6, 18, 30, 0, 27, 37, 45, 86, 22, 5, 165,
+    96, 1, 12, 4, 1, 4, 5, 64, 6, 49, 9, 2,
+    1, 4, 206, 2, 6, 61, 20, 33, 22, 130, 85, 6,
+    21, 22, 12, 1, 2, 14, 35, 17, 10, 3, 111, 1,
+    5, 14, 2, 3, 2, 8, 10, 18, 17, 8, 50, 4,
+    73, 58, 2, 26, 42, 13, 109, 47, 1, 164, 5, 22,
+    3, 119, 2, 86, 12, 107, 64, 106, 23, 75, 148, 27,
+    64, 143,
+};
+
+static const tzhash_slot tzhash_slots[TZHASH_SLOTS] = {
+    {"Europe/Malta", 293},
+    {"Israel Standard Time", 177},
+    {"Asia/Almaty", 147},
+    {"FLE Standard Time", 289},
+    {"America/Yellowknife", 139},
+    {NULL, 0},
+    {"W. Australia Standard Time", 239},
+    {"Asia/Singapore", 205},
+    {NULL, 0},
+    {"Tokyo Standard Time", 212},
+    {"Asia/Seoul", 203},
+    {"WET", 350},
+    {"AUS Central Standard Time", 233},
+    {"SA Eastern Standard Time", 47},
+    {NULL, 0},
+    {"GMT", 246},
+    {NULL, 0},
+    {"Asia/Bangkok", 156},
+    {"America/Nome", 104},
+    {"Africa/Johannesburg", 7},
+    {"Asia/Beirut", 158},
+    {"Pacific/Kanton", 333},
+    {"Russia Time Zone 11", 179},
+    {"Atlantic/Bermuda", 223},
+    {"America/Monterrey", 101},
+    {"America/Nuuk", 109},
+    {NULL, 0},
+    {"Asia/Saigon", 171},
+    {"Etc/GMT+4", 253},
+    {"Asia/Aqtobe", 151},
+    {"Asia/Chita", 160},
+    {"Etc/GMT-5", 268},
+    {NULL, 0},
+    {"America/Miquelon", 99},
+    {"Pacific/Honolulu", 332},
+    {"Asia/Dili", 165},
+    {"Europe/Guernsey", 291},
+    {"Asia/Kolkata", 183},
+    {"Europe/Istanbul", 286},
+    {"Middle East Standard Time", 158},
+    {"America/Cambridge_Bay", 43},
+    {"Africa/Casablanca", 4},
+    {"Iran Standard Time", 210},
+    {"Europe/Samara", 300},
+    {NULL, 0},
+    {"South Sudan Standard Time", 8},
+    {"US Eastern Standard Time", 72},
+    {"America/Goose_Bay", 64},
+    {"Australia/Brisbane", 231},
+    {"Asia/Katmandu", 181},
+    {"North Asia Standard Time", 184},
+    {"Eastern Standard Time", 103},
+    {"America/Argentina/Mendoza", 27},
+    {NULL, 0},
+    {"Asia/Kuala_Lumpur", 205},
+    {NULL, 0},
+    {"America/Eirunepe", 59},
+    {"America/Costa_Rica", 51},
+    {"Atlantic/South_Georgia", 228},
+    {"E. South America Standard Time", 126},
+    {"Etc/GMT+1", 247},
+    {"UTC", 273},
+    {"America/Boa_Vista", 40},
+    {"UTC-02", 251},
+    {NULL, 0},
+    {"Europe/Gibraltar", 284},
+    {"America/Whitehorse", 136},
+    {"Argentina Standard Time", 22},
+    {"America/Regina", 120},
+    {"America/New_York", 103},
+    {"Australia/Sydney", 240},
+    {"Asia/Hovd", 173},
+    {"Asia/Khandyga", 182},
+    {"Asia/Srednekolymsk", 206},
+    {"HST", 312},
+    {"MST", 317},
+    {"Europe/Oslo", 278},
+    {NULL, 0},
+    {"Europe/Moscow", 295},
+    {"America/Metlakatla", 97},
+    {"Europe/Isle_of_Man", 291},
+    {NULL, 0},
+    {"Europe/Volgograd", 309},
+    {"America/Ojinaga", 110},
+    {"Etc/GMT-8", 271},
+    {"Volgograd Standard Time", 309},
+    {"Asia/Samarkand", 202},
+    {"Asia/Tbilisi", 209},
+    {"America/Los_Angeles", 88},
+    {"Africa/Tunis", 17},
+    {"Europe/Vienna", 307},
+    {"Pacific/Efate", 325},
+    {"Europe/Bratislava", 297},
+    {"America/Halifax", 69},
+    {"Europe/Riga", 298},
+    {"Europe/Saratov", 301},
+    {"Etc/GMT-9", 272},
+    {"Vladivostok Standard Time", 217},
+    {"Australia/Hobart", 235},
+    {"America/La_Paz", 86},
+    {"Egypt Standard Time", 3},
+    {"America/Punta_Arenas", 117},
+    {"Pacific/Noumea", 341},
+    {"Etc/GMT-12", 262},
+    {NULL, 0},
+    {"Pacific/Guam", 331},
+    {"Asia/Krasnoyarsk", 184},
+    {NULL, 0},
+    {"America/Indianapolis", 72},
+    {"Newfoundland Standard Time", 129},
+    {"Europe/Ljubljana", 277},
+    {"Etc/GMT+2", 251},
+    {"Asia/Baku", 155},
+    {"Pacific/Palau", 343},
+    {NULL, 0},
+    {NULL, 0},
+    {"America/Argentina/Catamarca", 23},
+    {NULL, 0},
+    {"Asia/Bishkek", 159},
+    {"Central Europe Standard Time", 281},
+    {"Caucasus Standard Time", 221},
+    {"America/Godthab", 109},
+    {"America/Chicago", 48},
+    {"Russian Standard Time", 295},
+    {"America/Matamoros", 93},
+    {"Asia/Pontianak", 195},
+    {"America/Argentina/Salta", 29},
+    {NULL, 0},
+    {"Sudan Standard Time", 9},
+    {"America/Kentucky/Monticello", 85},
+    {"America/Menominee", 95},
+    {"America/North_Dakota/Beulah", 106},
+    {"Asia/Vladivostok", 217},
+    {"Asia/Anadyr", 149},
+    {"Europe/Kirov", 288},
+    {"MST7MDT", 318},
+    {"Etc/GMT+5", 254},
+    {"America/Jamaica", 82},
+    {"Alaskan Standard Time", 20},
+    {"Atlantic/Reykjavik", 0},
+    {NULL, 0},
+    {NULL, 0},
+    {"America/Santarem", 123},
+    {"Asia/Nicosia", 190},
+    {"Mountain Standard Time (Mexico)", 94},
+    {"America/Montevideo", 102},
+    {"America/Mazatlan", 94},
+    {"America/Argentina/San_Juan", 30},
+    {NULL, 0},
+    {"AUS Eastern Standard Time", 240},
+    {"PST8PDT", 319},
+    {"Montevideo Standard Time", 102},
+    {"Central Standard Time", 48},
+    {"Antarctica/Casey", 140},
+    {NULL, 0},
+    {"Etc/GMT+3", 252},
+    {"US Mountain Standard Time", 113},
+    {"Australia/Canberra", 240},
+    {"Korea Standard Time", 203},
+    {"Central European Standard Time", 310},
+    {"America/Santiago", 124},
+    {"Asia/Riyadh", 200},
+    {"Africa/Algiers", 1},
+    {"Africa/Juba", 8},
+    {"Cape Verde Standard Time", 225},
+    {"Asia/Famagusta", 168},
+    {"America/Araguaina", 21},
+    {"America/Cancun", 45},
+    {"America/Campo_Grande", 44},
+    {"Etc/GMT-11", 261},
+    {"Africa/Maputo", 11},
+    {"Africa/Monrovia", 12},
+    {"Asia/Thimphu", 211},
+    {"Greenwich Standard Time", 0},
+    {"Pacific SA Standard Time", 124},
+    {"Asia/Pyongyang", 196},
+    {"America/Port-au-Prince", 114},
+    {"America/Tijuana", 133},
+    {"America/Kentucky/Louisville", 84},
+    {"Antarctica/Davis", 141},
+    {"America/Argentina/La_Rioja", 26},
+    {NULL, 0},
+    {"America/Dawson", 54},
+    {NULL, 0},
+    {"America/Guatemala", 66},
+    {NULL, 0},
+    {"Russia Time Zone 10", 206},
+    {"Europe/Amsterdam", 279},
+    {"America/Argentina/Tucuman", 32},
+    {"West Bank Standard Time", 170},
+    {"Tonga Standard Time", 349},
+    {"Europe/Jersey", 291},
+    {"Africa/Nairobi", 13},
+    {"MET", 316},
+    {"Pacific/Fiji", 327},
+    {"America/Recife", 119},
+    {"Europe/Sofia", 303},
+    {"Asia/Makassar", 188},
+    {"Etc/GMT-1", 259},
+    {"Africa/Bissau", 2},
+    {"America/Argentina/Rio_Gallegos", 28},
+    {"America/Guyana", 68},
+    {"America/Fort_Nelson", 61},
+    {"US/Hawaii", 332},
+    {"CST6CDT", 242},
+    {"America/Glace_Bay", 63},
+    {"Syria Standard Time", 163},
+    {"Europe/Brussels", 279},
+    {"Europe/Warsaw", 310},
+    {"Australia/Darwin", 233},
+    {"Bahia Standard Time", 35},
+    {"America/Maceio", 89},
+    {"America/Juneau", 83},
+    {"Asia/Colombo", 162},
+    {"America/Caracas", 46},
+    {"Pacific/Easter", 324},
+    {NULL, 0},
+    {"America/Buenos_Aires", 22},
+    {"Atlantic/Cape_Verde", 225},
+    {"Europe/Rome", 299},
+    {"Asia/Bahrain", 197},
+    {"America/Detroit", 57},
+    {"Tomsk Standard Time", 213},
+    {"Yakutsk Standard Time", 218},
+    {"America/Panama", 111},
+    {"Asia/Damascus", 163},
+    {"Morocco Standard Time", 4},
+    {"Kaliningrad Standard Time", 287},
+    {"Europe/Tallinn", 304},
+    {"Europe/Sarajevo", 277},
+    {"Antarctica/Troll", 146},
+    {"Etc/GMT+10", 248},
+    {"Myanmar Standard Time", 219},
+    {"Ekaterinburg Standard Time", 220},
+    {"Africa/Sao_Tome", 15},
+    {"America/Indiana/Vincennes", 78},
+    {"Asia/Tomsk", 213},
+    {"Jordan Standard Time", 148},
+    {NULL, 0},
+    {"America/St_Johns", 129},
+    {"Samoa Standard Time", 320},
+    {"America/Paramaribo", 112},
+    {"Central Standard Time (Mexico)", 98},
+    {NULL, 0},
+    {"America/Indiana/Vevay", 77},
+    {"Pacific/Nauru", 338},
+    {"America/Bahia_Banderas", 36},
+    {"Arab Standard Time", 200},
+    {"Asia/Calcutta", 183},
+    {NULL, 0},
+    {NULL, 0},
+    {"Tasmania Standard Time", 235},
+    {"Atlantic/Madeira", 227},
+    {"Asia/Yekaterinburg", 220},
+    {"Pacific/Kwajalein", 336},
+    {"Aleutian Standard Time", 19},
+    {"Pacific/Gambier", 329},
+    {"Pacific/Fakaofo", 326},
+    {"Pacific/Pitcairn", 344},
+    {"Asia/Qostanay", 198},
+    {NULL, 0},
+    {"GTB Standard Time", 280},
+    {"West Pacific Standard Time", 345},
+    {"Fiji Standard Time", 327},
+    {"Europe/Astrakhan", 275},
+    {"America/Boise", 42},
+    {"Africa/El_Aaiun", 6},
+    {"Asia/Shanghai", 204},
+    {"Asia/Qatar", 197},
+    {NULL, 0},
+    {"Libya Standard Time", 16},
+    {NULL, 0},
+    {"Pacific/Tongatapu", 349},
+    {"US/Arizona", 113},
+    {"Asia/Manila", 189},
+    {"EST", 244},
+    {"Europe/Kiev", 289},
+    {"America/Argentina/Cordoba", 24},
+    {"Europe/Luxembourg", 279},
+    {"Asia/Dubai", 166},
+    {"Asia/Dhaka", 164},
+    {"Africa/Cairo", 3},
+    {"America/Moncton", 100},
+    {"Tocantins Standard Time", 21},
+    {"Etc/GMT-13", 263},
+    {"Antarctica/Rothera", 145},
+    {"America/Bahia", 35},
+    {"North Asia East Standard Time", 174},
+    {"Asia/Ho_Chi_Minh", 171},
+    {"America/Asuncion", 34},
+    {"Pacific Standard Time (Mexico)", 133},
+    {"Qyzylorda Standard Time", 199},
+    {"Australia/Lindeman", 236},
+    {"Taipei Standard Time", 207},
+    {NULL, 0},
+    {NULL, 0},
+    {"Europe/Belgrade", 277},
+    {"Marquesas Standard Time", 337},
+    {"Altai Standard Time", 157},
+    {NULL, 0},
+    {"Georgian Standard Time", 209},
+    {NULL, 0},
+    {NULL, 0},
+    {"E. Australia Standard Time", 231},
+    {"Asia/Dushanbe", 167},
+    {"Australia/Perth", 239},
+    {"America/Rio_Branco", 122},
+    {"Europe/Zagreb", 277},
+    {NULL, 0},
+    {"Asia/Muscat", 166},
+    {NULL, 0},
+    {"America/Santo_Domingo", 125},
+    {NULL, 0},
+    {"Afghanistan Standard Time", 178},
+    {"Indian/Mauritius", 315},
+    {"US/Mountain", 56},
+    {"Etc/GMT", 246},
+    {"America/Denver", 56},
+    {"Asia/Oral", 194},
+    {"Europe/Monaco", 296},
+    {"America/Guayaquil", 67},
+    {"Antarctica/Mawson", 143},
+    {"America/Danmarkshavn", 53},
+    {"Asia/Novokuznetsk", 191},
+    {"Etc/GMT+9", 258},
+    {"Pakistan Standard Time", 180},
+    {"Etc/UTC", 273},
+    {"W. Europe Standard Time", 278},
+    {"Europe/Madrid", 292},
+    {"Europe/Chisinau", 282},
+    {"Atlantic/Azores", 222},
+    {"America/Sitka", 128},
+    {"Eastern Standard Time (Mexico)", 45},
+    {"Aus Central W. Standard Time", 234},
+    {"W. Central Africa Standard Time", 10},
+    {"America/Montreal", 134},
+    {"Asia/Tashkent", 208},
+    {"America/Vancouver", 135},
+    {"Pacific/Guadalcanal", 330},
+    {"UTC-11", 249},
+    {"Cen. Australia Standard Time", 230},
+    {"Asia/Yangon", 219},
+    {"Saratov Standard Time", 301},
+    {"Pacific/Rarotonga", 346},
+    {"Asia/Omsk", 193},
+    {"Australia/Melbourne", 238},
+    {"America/Winnipeg", 137},
+    {NULL, 0},
+    {"America/Argentina/Ushuaia", 33},
+    {"Etc/GMT-7", 270},
+    {"Asia/Urumqi", 215},
+    {"America/Dawson_Creek", 55},
+    {"America/Chihuahua", 49},
+    {"Europe/Kaliningrad", 287},
+    {"Etc/GMT-10", 260},
+    {"America/Noronha", 105},
+    {"Dateline Standard Time", 250},
+    {NULL, 0},
+    {"Mid-Atlantic Standard Time", 251},
+    {"Canada Central Standard Time", 120},
+    {"Pacific/Port_Moresby", 345},
+    {"Pacific/Galapagos", 328},
+    {"Pacific/Auckland", 321},
+    {"Magadan Standard Time", 187},
+    {"America/Swift_Current", 130},
+    {"America/Argentina/San_Luis", 31},
+    {"Europe/Bucharest", 280},
+    {"Asia/Choibalsan", 161},
+    {"Europe/London", 291},
+    {"Africa/Windhoek", 18},
+    {NULL, 0},
+    {"Asia/Ashgabat", 152},
+    {"Asia/Kuwait", 200},
+    {"Africa/Khartoum", 9},
+    {"Pacific/Apia", 320},
+    {NULL, 0},
+    {"Asia/Tehran", 210},
+    {"Asia/Hebron", 170},
+    {"America/Barbados", 37},
+    {"Europe/Dublin", 283},
+    {"Azerbaijan Standard Time", 155},
+    {"Mountain Standard Time", 56},
+    {"America/Scoresbysund", 127},
+    {"Atlantic/Canary", 224},
+    {"Europe/Tirane", 305},
+    {"Asia/Aqtau", 150},
+    {"North Korea Standard Time", 196},
+    {"Paraguay Standard Time", 34},
+    {"Azores Standard Time", 222},
+    {"Asia/Baghdad", 154},
+    {"GMT Standard Time", 291},
+    {"Asia/Macau", 186},
+    {"Asia/Hong_Kong", 172},
+    {"Europe/Lisbon", 290},
+    {"Pacific/Kiritimati", 334},
+    {"America/Havana", 70},
+    {"America/Indiana/Petersburg", 75},
+    {"Australia/Lord_Howe", 237},
+    {"Europe/Helsinki", 285},
+    {"Asia/Novosibirsk", 192},
+    {"America/North_Dakota/Center", 107},
+    {"America/Merida", 96},
+    {"Etc/GMT+7", 256},
+    {"America/Thule", 132},
+    {"Pacific/Bougainville", 322},
+    {"Haiti Standard Time", 114},
+    {"America/Cayenne", 47},
+    {"Asia/Taipei", 207},
+    {"Europe/Kyiv", 289},
+    {"America/Ciudad_Juarez", 50},
+    {"Europe/Berlin", 278},
+    {"Antarctica/Palmer", 144},
+    {"Etc/GMT+11", 249},
+    {NULL, 0},
+    {"Central Brazilian Standard Time", 52},
+    {"Cuba Standard Time", 70},
+    {NULL, 0},
+    {"Canada/Eastern", 134},
+    {"Pacific/Norfolk", 340},
+    {"Europe/Skopje", 277},
+    {"Lord Howe Standard Time", 237},
+    {"China Standard Time", 204},
+    {"Europe/Ulyanovsk", 306},
+    {"Asia/Kamchatka", 179},
+    {"America/Iqaluit", 81},
+    {NULL, 0},
+    {"Singapore Standard Time", 205},
+    {"Etc/GMT+8", 257},
+    {"UTC+12", 262},
+    {"Hawaiian Standard Time", 332},
+    {NULL, 0},
+    {"SE Asia Standard Time", 156},
+    {"New Zealand Standard Time", 321},
+    {"Greenland Standard Time", 109},
+    {"Europe/Andorra", 274},
+    {"Australia/Broken_Hill", 232},
+    {"America/Managua", 90},
+    {"Venezuela Standard Time", 46},
+    {"America/Phoenix", 113},
+    {"America/Manaus", 91},
+    {"Turks And Caicos Standard Time", 65},
+    {NULL, 0},
+    {"America/Tegucigalpa", 131},
+    {"Asia/Istanbul", 286},
+    {"Etc/GMT-6", 269},
+    {"E. Europe Standard Time", 282},
+    {"America/Rankin_Inlet", 118},
+    {"India Standard Time", 183},
+    {"West Asia Standard Time", 208},
+    {"Bougainville Standard Time", 322},
+    {"Magallanes Standard Time", 117},
+    {"America/Indiana/Indianapolis", 72},
+    {"America/Fortaleza", 62},
+    {"Romance Standard Time", 296},
+    {NULL, 0},
+    {NULL, 0},
+    {"Pacific Standard Time", 88},
+    {"America/Mexico_City", 98},
+    {"Atlantic/Faroe", 226},
+    {"Europe/Prague", 297},
+    {NULL, 0},
+    {NULL, 0},
+    {"Etc/GMT-2", 265},
+    {"Asia/Magadan", 187},
+    {"Pacific/Tahiti", 347},
+    {"Etc/GMT-14", 264},
+    {"Europe/Vatican", 299},
+    {"Europe/Simferopol", 302},
+    {"Africa/Abidjan", 0},
+    {"Sakhalin Standard Time", 201},
+    {"Africa/Tripoli", 16},
+    {"America/Belize", 39},
+    {"America/North_Dakota/New_Salem", 108},
+    {NULL, 0},
+    {NULL, 0},
+    {"America/Edmonton", 58},
+    {"America/Bogota", 41},
+    {"America/Lima", 87},
+    {"Asia/Tokyo", 212},
+    {"Asia/Atyrau", 153},
+    {"Europe/Paris", 296},
+    {"Sao Tome Standard Time", 15},
+    {"Pacific/Tarawa", 348},
+    {"Europe/Mariehamn", 285},
+    {"Europe/Stockholm", 278},
+    {"Atlantic/Stanley", 229},
+    {"America/Anchorage", 20},
+    {"Europe/Vilnius", 308},
+    {"Central Asia Standard Time", 147},
+    {"Africa/Lagos", 10},
+    {"Norfolk Standard Time", 340},
+    {"Europe/Copenhagen", 278},
+    {NULL, 0},
+    {NULL, 0},
+    {"Antarctica/Macquarie", 142},
+    {"Atlantic Standard Time", 69},
+    {"Asia/Kabul", 178},
+    {"America/Yakutat", 138},
+    {"Line Islands Standard Time", 334},
+    {"Asia/Yakutsk", 218},
+    {NULL, 0},
+    {"Arabic Standard Time", 154},
+    {"Asia/Jerusalem", 177},
+    {"Asia/Sakhalin", 201},
+    {"Etc/GMT+6", 255},
+    {"Europe/Vaduz", 311},
+    {"Africa/Ceuta", 5},
+    {"America/Indiana/Winamac", 79},
+    {"America/Toronto", 134},
+    {"W. Mongolia Standard Time", 173},
+    {"UTC-08", 257},
+    {"Africa/Ndjamena", 14},
+    {"Asia/Barnaul", 157},
+    {"Asia/Gaza", 169},
+    {NULL, 0},
+    {"Europe/Minsk", 294},
+    {"SA Western Standard Time", 86},
+    {"Pacific/Pago_Pago", 342},
+    {"Omsk Standard Time", 193},
+    {"America/Porto_Velho", 115},
+    {NULL, 0},
+    {"Turkey Standard Time", 286},
+    {"America/Cuiaba", 52},
+    {"Ulaanbaatar Standard Time", 214},
+    {"America/Indiana/Knox", 73},
+    {"Easter Island Standard Time", 324},
+    {"Canada/Pacific", 135},
+    {"America/Argentina/Jujuy", 25},
+    {"Russia Time Zone 3", 300},
+    {"Pacific/Kosrae", 335},
+    {"Australia/Adelaide", 230},
+    {"Asia/Rangoon", 219},
+    {"US/Central", 48},
+    {"Pacific/Niue", 339},
+    {NULL, 0},
+    {"America/Grand_Turk", 65},
+    {"US/Pacific", 88},
+    {"America/Indiana/Tell_City", 76},
+    {"America/El_Salvador", 60},
+    {"America/Sao_Paulo", 126},
+    {"Central Pacific Standard Time", 330},
+    {"Arabian Standard Time", 166},
+    {NULL, 0},
+    {"America/Inuvik", 80},
+    {"Asia/Jakarta", 175},
+    {"Asia/Ulaanbaatar", 214},
+    {"America/Argentina/Buenos_Aires", 22},
+    {NULL, 0},
+    {"Europe/Budapest", 281},
+    {"Asia/Qyzylorda", 199},
+    {"Asia/Irkutsk", 174},
+    {"Central America Standard Time", 66},
+    {"America/Resolute", 121},
+    {"Saint Pierre Standard Time", 99},
+    {"America/Belem", 38},
+    {"Europe/Zurich", 311},
+    {"Asia/Amman", 148},
+    {"Chatham Islands Standard Time", 323},
+    {"EST5EDT", 245},
+    {"SA Pacific Standard Time", 41},
+    {"Etc/GMT-3", 266},
+    {"Australia/Eucla", 234},
+    {"Etc/GMT-4", 267},
+    {"America/Indiana/Marengo", 74},
+    {"Indian/Chagos", 313},
+    {"Bangladesh Standard Time", 164},
+    {"Europe/Athens", 276},
+    {"Pacific/Marquesas", 337},
+    {"Transbaikal Standard Time", 160},
+    {"Yukon Standard Time", 136},
+    {"Mauritius Standard Time", 315},
+    {"Asia/Jayapura", 176},
+    {"CET", 241},
+    {"America/Puerto_Rico", 116},
+    {"Namibia Standard Time", 18},
+    {"US/Alaska", 20},
+    {"South Africa Standard Time", 7},
+    {"Asia/Yerevan", 221},
+    {"E. Africa Standard Time", 13},
+    {"Asia/Kuching", 185},
+    {"America/Adak", 19},
+    {"EET", 243},
+    {"Asia/Kathmandu", 181},
+    {"N. Central Asia Standard Time", 192},
+    {"UTC+13", 263},
+    {"Nepal Standard Time", 181},
+    {"America/Martinique", 92},
+    {"Astrakhan Standard Time", 275},
+    {"Indian/Maldives", 314},
+    {"Asia/Karachi", 180},
+    {"UTC-09", 258},
+    {"US/Eastern", 103},
+    {"Asia/Ust-Nera", 216},
+    {"America/Hermosillo", 71},
+    {"Etc/GMT+12", 250},
+    {NULL, 0},
+    {"Sri Lanka Standard Time", 162},
+    {"Pacific/Chatham", 323},
+    {"Belarus Standard Time", 294},
+    {NULL, 0},
+};
+
+static const char *const tzhash_names[TZHASH_ZONES] = {
+    "Africa/Abidjan",
+    "Africa/Algiers",
+    "Africa/Bissau",
+    "Africa/Cairo",
+    "Africa/Casablanca",
+    "Africa/Ceuta",
+    "Africa/El_Aaiun",
+    "Africa/Johannesburg",
+    "Africa/Juba",
+    "Africa/Khartoum",
+    "Africa/Lagos",
+    "Africa/Maputo",
+    "Africa/Monrovia",
+    "Africa/Nairobi",
+    "Africa/Ndjamena",
+    "Africa/Sao_Tome",
+    "Africa/Tripoli",
+    "Africa/Tunis",
+    "Africa/Windhoek",
+    "America/Adak",
+    "America/Anchorage",
+    "America/Araguaina",
+    "America/Argentina/Buenos_Aires",
+    "America/Argentina/Catamarca",
+    "America/Argentina/Cordoba",
+    "America/Argentina/Jujuy",
+    "America/Argentina/La_Rioja",
+    "America/Argentina/Mendoza",
+    "America/Argentina/Rio_Gallegos",
+    "America/Argentina/Salta",
+    "America/Argentina/San_Juan",
+    "America/Argentina/San_Luis",
+    "America/Argentina/Tucuman",
+    "America/Argentina/Ushuaia",
+    "America/Asuncion",
+    "America/Bahia",
+    "America/Bahia_Banderas",
+    "America/Barbados",
+    "America/Belem",
+    "America/Belize",
+    "America/Boa_Vista",
+    "America/Bogota",
+    "America/Boise",
+    "America/Cambridge_Bay",
+    "America/Campo_Grande",
+    "America/Cancun",
+    "America/Caracas",
+    "America/Cayenne",
+    "America/Chicago",
+    "America/Chihuahua",
+    "America/Ciudad_Juarez",
+    "America/Costa_Rica",
+    "America/Cuiaba",
+    "America/Danmarkshavn",
+    "America/Dawson",
+    "America/Dawson_Creek",
+    "America/Denver",
+    "America/Detroit",
+    "America/Edmonton",
+    "America/Eirunepe",
+    "America/El_Salvador",
+    "America/Fort_Nelson",
+    "America/Fortaleza",
+    "America/Glace_Bay",
+    "America/Goose_Bay",
+    "America/Grand_Turk",
+    "America/Guatemala",
+    "America/Guayaquil",
+    "America/Guyana",
+    "America/Halifax",
+    "America/Havana",
+    "America/Hermosillo",
+    "America/Indiana/Indianapolis",
+    "America/Indiana/Knox",
+    "America/Indiana/Marengo",
+    "America/Indiana/Petersburg",
+    "America/Indiana/Tell_City",
+    "America/Indiana/Vevay",
+    "America/Indiana/Vincennes",
+    "America/Indiana/Winamac",
+    "America/Inuvik",
+    "America/Iqaluit",
+    "America/Jamaica",
+    "America/Juneau",
+    "America/Kentucky/Louisville",
+    "America/Kentucky/Monticello",
+    "America/La_Paz",
+    "America/Lima",
+    "America/Los_Angeles",
+    "America/Maceio",
+    "America/Managua",
+    "America/Manaus",
+    "America/Martinique",
+    "America/Matamoros",
+    "America/Mazatlan",
+    "America/Menominee",
+    "America/Merida",
+    "America/Metlakatla",
+    "America/Mexico_City",
+    "America/Miquelon",
+    "America/Moncton",
+    "America/Monterrey",
+    "America/Montevideo",
+    "America/New_York",
+    "America/Nome",
+    "America/Noronha",
+    "America/North_Dakota/Beulah",
+    "America/North_Dakota/Center",
+    "America/North_Dakota/New_Salem",
+    "America/Nuuk",
+    "America/Ojinaga",
+    "America/Panama",
+    "America/Paramaribo",
+    "America/Phoenix",
+    "America/Port-au-Prince",
+    "America/Porto_Velho",
+    "America/Puerto_Rico",
+    "America/Punta_Arenas",
+    "America/Rankin_Inlet",
+    "America/Recife",
+    "America/Regina",
+    "America/Resolute",
+    "America/Rio_Branco",
+    "America/Santarem",
+    "America/Santiago",
+    "America/Santo_Domingo",
+    "America/Sao_Paulo",
+    "America/Scoresbysund",
+    "America/Sitka",
+    "America/St_Johns",
+    "America/Swift_Current",
+    "America/Tegucigalpa",
+    "America/Thule",
+    "America/Tijuana",
+    "America/Toronto",
+    "America/Vancouver",
+    "America/Whitehorse",
+    "America/Winnipeg",
+    "America/Yakutat",
+    "America/Yellowknife",
+    "Antarctica/Casey",
+    "Antarctica/Davis",
+    "Antarctica/Macquarie",
+    "Antarctica/Mawson",
+    "Antarctica/Palmer",
+    "Antarctica/Rothera",
+    "Antarctica/Troll",
+    "Asia/Almaty",
+    "Asia/Amman",
+    "Asia/Anadyr",
+    "Asia/Aqtau",
+    "Asia/Aqtobe",
+    "Asia/Ashgabat",
+    "Asia/Atyrau",
+    "Asia/Baghdad",
+    "Asia/Baku",
+    "Asia/Bangkok",
+    "Asia/Barnaul",
+    "Asia/Beirut",
+    "Asia/Bishkek",
+    "Asia/Chita",
+    "Asia/Choibalsan",
+    "Asia/Colombo",
+    "Asia/Damascus",
+    "Asia/Dhaka",
+    "Asia/Dili",
+    "Asia/Dubai",
+    "Asia/Dushanbe",
+    "Asia/Famagusta",
+    "Asia/Gaza",
+    "Asia/Hebron",
+    "Asia/Ho_Chi_Minh",
+    "Asia/Hong_Kong",
+    "Asia/Hovd",
+    "Asia/Irkutsk",
+    "Asia/Jakarta",
+    "Asia/Jayapura",
+    "Asia/Jerusalem",
+    "Asia/Kabul",
+    "Asia/Kamchatka",
+    "Asia/Karachi",
+    "Asia/Kathmandu",
+    "Asia/Khandyga",
+    "Asia/Kolkata",
+    "Asia/Krasnoyarsk",
+    "Asia/Kuching",
+    "Asia/Macau",
+    "Asia/Magadan",
+    "Asia/Makassar",
+    "Asia/Manila",
+    "Asia/Nicosia",
+    "Asia/Novokuznetsk",
+    "Asia/Novosibirsk",
+    "Asia/Omsk",
+    "Asia/Oral",
+    "Asia/Pontianak",
+    "Asia/Pyongyang",
+    "Asia/Qatar",
+    "Asia/Qostanay",
+    "Asia/Qyzylorda",
+    "Asia/Riyadh",
+    "Asia/Sakhalin",
+    "Asia/Samarkand",
+    "Asia/Seoul",
+    "Asia/Shanghai",
+    "Asia/Singapore",
+    "Asia/Srednekolymsk",
+    "Asia/Taipei",
+    "Asia/Tashkent",
+    "Asia/Tbilisi",
+    "Asia/Tehran",
+    "Asia/Thimphu",
+    "Asia/Tokyo",
+    "Asia/Tomsk",
+    "Asia/Ulaanbaatar",
+    "Asia/Urumqi",
+    "Asia/Ust-Nera",
+    "Asia/Vladivostok",
+    "Asia/Yakutsk",
+    "Asia/Yangon",
+    "Asia/Yekaterinburg",
+    "Asia/Yerevan",
+    "Atlantic/Azores",
+    "Atlantic/Bermuda",
+    "Atlantic/Canary",
+    "Atlantic/Cape_Verde",
+    "Atlantic/Faroe",
+    "Atlantic/Madeira",
+    "Atlantic/South_Georgia",
+    "Atlantic/Stanley",
+    "Australia/Adelaide",
+    "Australia/Brisbane",
+    "Australia/Broken_Hill",
+    "Australia/Darwin",
+    "Australia/Eucla",
+    "Australia/Hobart",
+    "Australia/Lindeman",
+    "Australia/Lord_Howe",
+    "Australia/Melbourne",
+    "Australia/Perth",
+    "Australia/Sydney",
+    "CET",
+    "CST6CDT",
+    "EET",
+    "EST",
+    "EST5EDT",
+    "Etc/GMT",
+    "Etc/GMT+1",
+    "Etc/GMT+10",
+    "Etc/GMT+11",
+    "Etc/GMT+12",
+    "Etc/GMT+2",
+    "Etc/GMT+3",
+    "Etc/GMT+4",
+    "Etc/GMT+5",
+    "Etc/GMT+6",
+    "Etc/GMT+7",
+    "Etc/GMT+8",
+    "Etc/GMT+9",
+    "Etc/GMT-1",
+    "Etc/GMT-10",
+    "Etc/GMT-11",
+    "Etc/GMT-12",
+    "Etc/GMT-13",
+    "Etc/GMT-14",
+    "Etc/GMT-2",
+    "Etc/GMT-3",
+    "Etc/GMT-4",
+    "Etc/GMT-5",
+    "Etc/GMT-6",
+    "Etc/GMT-7",
+    "Etc/GMT-8",
+    "Etc/GMT-9",
+    "Etc/UTC",
+    "Europe/Andorra",
+    "Europe/Astrakhan",
+    "Europe/Athens",
+    "Europe/Belgrade",
+    "Europe/Berlin",
+    "Europe/Brussels",
+    "Europe/Bucharest",
+    "Europe/Budapest",
+    "Europe/Chisinau",
+    "Europe/Dublin",
+    "Europe/Gibraltar",
+    "Europe/Helsinki",
+    "Europe/Istanbul",
+    "Europe/Kaliningrad",
+    "Europe/Kirov",
+    "Europe/Kyiv",
+    "Europe/Lisbon",
+    "Europe/London",
+    "Europe/Madrid",
+    "Europe/Malta",
+    "Europe/Minsk",
+    "Europe/Moscow",
+    "Europe/Paris",
+    "Europe/Prague",
+    "Europe/Riga",
+    "Europe/Rome",
+    "Europe/Samara",
+    "Europe/Saratov",
+    "Europe/Simferopol",
+    "Europe/Sofia",
+    "Europe/Tallinn",
+    "Europe/Tirane",
+    "Europe/Ulyanovsk",
+    "Europe/Vienna",
+    "Europe/Vilnius",
+    "Europe/Volgograd",
+    "Europe/Warsaw",
+    "Europe/Zurich",
+    "HST",
+    "Indian/Chagos",
+    "Indian/Maldives",
+    "Indian/Mauritius",
+    "MET",
+    "MST",
+    "MST7MDT",
+    "PST8PDT",
+    "Pacific/Apia",
+    "Pacific/Auckland",
+    "Pacific/Bougainville",
+    "Pacific/Chatham",
+    "Pacific/Easter",
+    "Pacific/Efate",
+    "Pacific/Fakaofo",
+    "Pacific/Fiji",
+    "Pacific/Galapagos",
+    "Pacific/Gambier",
+    "Pacific/Guadalcanal",
+    "Pacific/Guam",
+    "Pacific/Honolulu",
+    "Pacific/Kanton",
+    "Pacific/Kiritimati",
+    "Pacific/Kosrae",
+    "Pacific/Kwajalein",
+    "Pacific/Marquesas",
+    "Pacific/Nauru",
+    "Pacific/Niue",
+    "Pacific/Norfolk",
+    "Pacific/Noumea",
+    "Pacific/Pago_Pago",
+    "Pacific/Palau",
+    "Pacific/Pitcairn",
+    "Pacific/Port_Moresby",
+    "Pacific/Rarotonga",
+    "Pacific/Tahiti",
+    "Pacific/Tarawa",
+    "Pacific/Tongatapu",
+    "WET",
+};
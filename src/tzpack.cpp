@@ -0,0 +1,386 @@
+#include "tzpack.h"
+#include <stdlib.h>
+#include <string.h>
+#include "bundle.h"
+
+enum zone_piece_kind
+{
+  PIECE_TEXT,
+  PIECE_TZID, // the name, or what the zone was asked for by
+  PIECE_NAME,
+  PIECE_EXTRA,
+  PIECE_MODIFIED,
+  PIECE_URL,
+  PIECE_BLOCKS,
+};
+
+struct zone_piece
+{
+  zone_piece_kind kind;
+  const char *text;
+};
+
+// one zone's text; must match ZONE_HEAD in lib/pack_timezones.py
+static const zone_piece zone_pieces[] = {
+    {PIECE_TEXT, "BEGIN:VTIMEZONE\nTZID:"},
+    {PIECE_TZID, NULL},
+    {PIECE_TEXT, "\n"},
+    {PIECE_EXTRA, NULL},
+    {PIECE_TEXT, "LAST-MODIFIED:"},
+    {PIECE_MODIFIED, NULL},
+    {PIECE_TEXT, "\nTZURL:"},
+    {PIECE_URL, NULL},
+    {PIECE_NAME, NULL},
+    {PIECE_TEXT, "\nX-LIC-LOCATION:"},
+    {PIECE_NAME, NULL},
+    {PIECE_TEXT, "\n"},
+    {PIECE_BLOCKS, NULL},
+    {PIECE_TEXT, "END:VTIMEZONE\n"},
+};
+
+#define NUM_ZONE_PIECES (sizeof(zone_pieces) / sizeof(zone_pieces[0]))
+// steps 1 to NUM_ZONE_PIECES are zone_pieces
+#define STEP_PROLOGUE 0
+#define STEP_EPILOGUE (NUM_ZONE_PIECES + 1)
+#define STEP_DONE (NUM_ZONE_PIECES + 2)
+
+static uint16_t read16(const uint8_t *p)
+{
+  return p[0] | (p[1] << 8);
+}
+
+bool tzpack_memory::read(uint32_t at, void *buf, size_t n)
+{
+  if (at > len || n > len - at)
+  {
+    return false;
+  }
+  memcpy(buf, data + at, n);
+  return true;
+}
+
+bool tzpack::open(tzpack_source *from, uint32_t size)
+{
+  close();
+  if (size < sizeof(header) || !from->read(0, &header, sizeof(header)) ||
+      memcmp(header.magic, TZPACK_MAGIC, sizeof(header.magic)) != 0 || header.version != TZPACK_VERSION)
+  {
+    return false;
+  }
+  header.release[sizeof(header.release) - 1] = 0;
+  uint32_t tables_size = header.strings_size + 2 * (header.num_blocks + header.num_zones);
+  if (sizeof(header) + tables_size + header.blocks_size + header.zones_size != size)
+  {
+    return false;
+  }
+  uint8_t buf[256];
+  uint32_t crc = 0;
+  for (uint32_t at = sizeof(header); at < size;)
+  {
+    size_t n = size - at < sizeof(buf) ? size - at : sizeof(buf);
+    if (!from->read(at, buf, n))
+    {
+      return false;
+    }
+    crc = bundle_crc32(crc, buf, n);
+    at += n;
+  }
+  if (crc != header.crc)
+  {
+    return false;
+  }
+
+  tables = (char *)malloc(tables_size);
+  if (!tables || !from->read(sizeof(header), tables, tables_size))
+  {
+    close();
+    return false;
+  }
+  const char *p = tables;
+  for (int i = 0; i < 4; ++i)
+  {
+    strings[i] = p;
+    p += strnlen(p, tables + header.strings_size - p) + 1;
+    if (p > tables + header.strings_size)
+    {
+      close();
+      return false;
+    }
+  }
+  block_offsets = (const uint8_t *)tables + header.strings_size;
+  index = block_offsets + 2 * header.num_blocks;
+  blocks_at = sizeof(header) + tables_size;
+  zones_at = blocks_at + header.blocks_size;
+  source = from;
+  return true;
+}
+
+void tzpack::close()
+{
+  free(tables);
+  tables = NULL;
+  source = NULL;
+}
+
+bool tzpack::read_record(int zone, record &r, uint32_t *at) const
+{
+  uint32_t record_at = zones_at + read16(index + 2 * zone);
+  *at = record_at + sizeof(r);
+  return source->read(record_at, &r, sizeof(r));
+}
+
+uint16_t tzpack::block_offset(uint16_t block) const
+{
+  return block < header.num_blocks ? read16(block_offsets + 2 * block) : header.blocks_size;
+}
+
+int tzpack::find(const char *name) const
+{
+  if (!is_open())
+  {
+    return -1;
+  }
+  int lo = 0, hi = header.num_zones - 1;
+  while (lo <= hi)
+  {
+    int mid = (lo + hi) / 2;
+    record r;
+    uint32_t at;
+    char buf[TZPACK_MAX_NAME];
+    if (!read_record(mid, r, &at) || r.name_len >= sizeof(buf) || !source->read(at, buf, r.name_len))
+    {
+      return -1;
+    }
+    buf[r.name_len] = 0;
+    int cmp = strcmp(name, buf);
+    if (cmp == 0)
+    {
+      return mid;
+    }
+    if (cmp < 0)
+    {
+      hi = mid - 1;
+    }
+    else
+    {
+      lo = mid + 1;
+    }
+  }
+  return -1;
+}
+
+bool tzpack::load(int zone, uICAL::TZMap_ptr &tzmap, const char *tzid) const
+{
+  if (!is_open() || zone < 0 || zone >= header.num_zones)
+  {
+    return false;
+  }
+  tzpack_stream zones(*this, zone, tzid);
+  uICAL::Calendar::load(zones, tzmap);
+  return true;
+}
+
+bool tzpack::load_all(uICAL::TZMap_ptr &tzmap) const
+{
+  if (!is_open())
+  {
+    return false;
+  }
+  tzpack_stream zones(*this);
+  uICAL::Calendar::load(zones, tzmap);
+  return true;
+}
+
+tzpack_stream::tzpack_stream(const tzpack &pack, int zone, const char *tzid)
+    : pack(pack), tzid(tzid), all(zone < 0)
+{
+  refs_left = 0;
+  span_left = 0;
+  if (!pack.is_open() || zone >= pack.header.num_zones || !pack.header.num_zones)
+  {
+    step = STEP_DONE;
+    set_text("");
+    return;
+  }
+  next_at = pack.zones_at + (all ? 0 : read16(pack.index + 2 * zone));
+  step = STEP_PROLOGUE;
+  next_piece();
+}
+
+void tzpack_stream::set_text(const char *text)
+{
+  at = text;
+  end = text + strlen(text);
+  span_left = 0;
+}
+
+// reads the next chunk of a piece in the pack
+void tzpack_stream::set_span(uint32_t from, uint32_t len)
+{
+  size_t n = len < sizeof(chunk) ? len : sizeof(chunk);
+  if (!pack.source->read(from, chunk, n))
+  {
+    n = len = 0;
+  }
+  span_at = from + n;
+  span_left = len - n;
+  at = chunk;
+  end = chunk + n;
+}
+
+// reads the next zone's record
+bool tzpack_stream::next_zone()
+{
+  if (!next_at || !pack.source->read(next_at, &rec, sizeof(rec)))
+  {
+    return false;
+  }
+  name_at = next_at + sizeof(rec);
+  extra_at = name_at + rec.name_len;
+  refs_at = extra_at + rec.extra_len;
+  refs_left = rec.num_refs;
+  next_at = all ? refs_at + 2 * refs_left : 0;
+  if (next_at >= pack.zones_at + pack.header.zones_size)
+  {
+    next_at = 0;
+  }
+  return true;
+}
+
+// moves at to the start of the next piece with anything in it
+bool tzpack_stream::next_piece()
+{
+  while (step != STEP_DONE)
+  {
+    if (step == STEP_PROLOGUE)
+    {
+      set_text(pack.strings[0]);
+      step = 1;
+    }
+    else if (step == STEP_EPILOGUE)
+    {
+      set_text(pack.strings[3]);
+      step = STEP_DONE;
+    }
+    else
+    {
+      if (step == 1 && !next_zone())
+      {
+        step = STEP_EPILOGUE;
+        continue;
+      }
+      const zone_piece &z = zone_pieces[step - 1];
+      bool more_blocks = false;
+      switch (z.kind)
+      {
+      case PIECE_TEXT:
+        set_text(z.text);
+        break;
+      case PIECE_TZID:
+        if (tzid)
+        {
+          set_text(tzid);
+          break;
+        }
+        // fall through
+      case PIECE_NAME:
+        set_span(name_at, rec.name_len);
+        break;
+      case PIECE_EXTRA:
+        set_span(extra_at, rec.extra_len);
+        break;
+      case PIECE_MODIFIED:
+        set_text(pack.strings[1]);
+        break;
+      case PIECE_URL:
+        set_text(pack.strings[2]);
+        break;
+      case PIECE_BLOCKS:
+        set_text("");
+        if (refs_left)
+        {
+          uint8_t ref[2];
+          if (pack.source->read(refs_at, ref, sizeof(ref)))
+          {
+            uint16_t block = read16(ref);
+            uint16_t from = pack.block_offset(block), to = pack.block_offset(block + 1);
+            if (from < to)
+            {
+              set_span(pack.blocks_at + from, to - from);
+            }
+          }
+          refs_at += 2;
+          refs_left--;
+          more_blocks = true;
+        }
+        break;
+      }
+      // stay on the blocks until they run out
+      if (!more_blocks)
+      {
+        step = step == NUM_ZONE_PIECES ? 1 : step + 1;
+      }
+    }
+    if (at < end)
+    {
+      return true;
+    }
+  }
+  set_text("");
+  return false;
+}
+
+char tzpack_stream::peek() const
+{
+  return at < end ? *at : 0;
+}
+
+char tzpack_stream::get()
+{
+  if (at == end)
+  {
+    return 0;
+  }
+  char c = *at++;
+  if (at == end)
+  {
+    if (span_left)
+    {
+      set_span(span_at, span_left);
+    }
+    else
+    {
+      next_piece();
+    }
+  }
+  return c;
+}
+
+bool tzpack_stream::readuntil(uICAL::string &st, char delim)
+{
+  if (at == end)
+  {
+    return false;
+  }
+  char buf[64];
+  size_t n = 0;
+  st = "";
+  while (at < end)
+  {
+    char c = get();
+    if (c == delim)
+    {
+      break;
+    }
+    buf[n++] = c;
+    if (n == sizeof(buf) - 1)
+    {
+      buf[n] = 0;
+      st += buf;
+      n = 0;
+    }
+  }
+  buf[n] = 0;
+  st += buf;
+  return true;
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <uICal.h>
+
+// The fallback zones, packed by lib/pack_timezones.py. Zones share most
+// of their STANDARD/DAYLIGHT blocks, and their header lines only differ
+// by name, so each distinct block is kept once and each zone is a name and
+// a list of blocks: about a fifth of the text.
+//
+// Layout, little-endian: a tzpack_header, then
+//   four NUL-terminated strings: the text before the first zone, every
+//     zone's LAST-MODIFIED, the TZURL before the name, the text after the
+//     last zone
+//   num_blocks uint16 offsets into the blocks
+//   num_zones uint16 offsets into the zones, in name order
+//   blocks_size bytes of blocks, back to back
+//   zones_size bytes of zones: name length, length of the lines before
+//     LAST-MODIFIED, a count, all bytes; the name and those lines; then
+//     count uint16 block numbers
+// crc is CRC-32 (bundle_crc32) of everything after the header. The strings
+// and offsets are read once; a zone is read, a piece at a time, only when
+// it's asked for, so the pack can stay in flash or on SPIFFS.
+#define TZPACK_MAGIC "TZP1"
+#define TZPACK_VERSION 2
+#define TZPACK_MAX_NAME 64
+
+struct tzpack_header
+{
+  char magic[4];
+  uint16_t version;
+  uint16_t num_zones;
+  uint16_t num_blocks;
+  uint16_t strings_size;
+  uint32_t blocks_size;
+  uint32_t zones_size;
+  uint32_t crc;
+  char release[8]; // of the tz database, "2022g"
+};
+
+static_assert(sizeof(tzpack_header) == 32, "tzpack header layout");
+
+// where a pack's bytes come from
+class tzpack_source
+{
+public:
+  virtual ~tzpack_source() {}
+  virtual bool read(uint32_t at, void *buf, size_t len) = 0;
+};
+
+class tzpack_memory : public tzpack_source
+{
+public:
+  tzpack_memory(const uint8_t *data, size_t len) : data(data), len(len) {}
+  bool read(uint32_t at, void *buf, size_t n);
+
+protected:
+  const uint8_t *data;
+  size_t len;
+};
+
+class tzpack
+{
+public:
+  tzpack() : source(NULL), tables(NULL) {}
+  ~tzpack() { close(); }
+
+  // checks the pack's header and crc and reads its tables; false if
+  // source doesn't hold a valid pack of size bytes
+  bool open(tzpack_source *source, uint32_t size);
+  void close();
+  bool is_open() const { return tables != NULL; }
+
+  // zone number of name, or -1
+  int find(const char *name) const;
+  // adds the zone to tzmap, under its own name or tzid if given
+  bool load(int zone, uICAL::TZMap_ptr &tzmap, const char *tzid = NULL) const;
+  // adds every zone to tzmap
+  bool load_all(uICAL::TZMap_ptr &tzmap) const;
+
+  tzpack_header header;
+
+protected:
+  friend class tzpack_stream;
+
+  struct record
+  {
+    uint8_t name_len, extra_len, num_refs;
+  };
+
+  bool read_record(int zone, record &r, uint32_t *at) const;
+  uint16_t block_offset(uint16_t block) const;
+
+  tzpack_source *source;
+  char *tables;                // the strings, block offsets and zone index
+  const char *strings[4];      // in tables
+  const uint8_t *block_offsets; // in tables
+  const uint8_t *index;        // in tables
+  uint32_t blocks_at, zones_at; // in source
+};
+
+// Expands zones of an open pack back into VTIMEZONE text as uICAL reads
+// it, a piece at a time, so none of it is ever all in RAM: one zone, or
+// all of them for zone -1. A zone can be given another TZID, for aliases.
+class tzpack_stream : public uICAL::istream
+{
+public:
+  tzpack_stream(const tzpack &pack, int zone = -1, const char *tzid = NULL);
+
+  char peek() const;
+  char get();
+  bool readuntil(uICAL::string &st, char delim);
+
+protected:
+  bool next_piece();
+  bool next_zone();
+  void set_text(const char *text);
+  void set_span(uint32_t from, uint32_t len);
+
+  const tzpack &pack;
+  const char *tzid;
+  bool all;
+  uint32_t next_at; // the next zone's record, 0 after the last
+  tzpack::record rec;
+  uint32_t name_at, extra_at, refs_at; // in the pack, of the current zone
+  uint8_t refs_left;
+  uint8_t step;
+  uint32_t span_at, span_left; // what's left of a piece read from the pack
+  char chunk[64];
+  const char *at, *end; // in the current piece, or the chunk of it
+};
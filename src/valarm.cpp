@@ -0,0 +1,414 @@
+#include "valarm.h"
+#include <uICAL/veventiter.h>
+
+static int parse_digits(const char *&p, int n)
+{
+  int v = 0;
+  while (n--)
+  {
+    if (*p < '0' || *p > '9')
+    {
+      return -1;
+    }
+    v = v * 10 + (*p++ - '0');
+  }
+  return v;
+}
+
+// days since 1970-01-01 for a proleptic gregorian date
+static time_t days_from_civil(int y, int m, int d)
+{
+  y -= m <= 2;
+  int era = (y >= 0 ? y : y - 399) / 400;
+  int yoe = y - era * 400;
+  int doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return (time_t)era * 146097 + doe - 719468;
+}
+
+static bool parse_duration(const char *p, time_t *out)
+{
+  int sign = 1;
+  if (*p == '+' || *p == '-')
+  {
+    sign = (*p++ == '-') ? -1 : 1;
+  }
+  if (*p++ != 'P')
+  {
+    return false;
+  }
+  time_t total = 0;
+  int in_time = 0;
+  int any = 0;
+  while (*p && *p != '\r' && *p != '\n')
+  {
+    if (*p == 'T')
+    {
+      in_time = 1;
+      ++p;
+      continue;
+    }
+    long n = 0;
+    const char *digits = p;
+    while (*p >= '0' && *p <= '9')
+    {
+      n = n * 10 + (*p++ - '0');
+    }
+    if (p == digits)
+    {
+      return false;
+    }
+    switch (*p++)
+    {
+    case 'W':
+      total += n * 7 * 86400;
+      break;
+    case 'D':
+      total += n * 86400;
+      break;
+    case 'H':
+      total += n * 3600;
+      break;
+    case 'M':
+      if (!in_time)
+      {
+        return false; // months aren't allowed in a duration
+      }
+      total += n * 60;
+      break;
+    case 'S':
+      total += n;
+      break;
+    default:
+      return false;
+    }
+    any = 1;
+  }
+  *out = sign * total;
+  return any;
+}
+
+static bool parse_utc(const char *p, time_t *out)
+{
+  int y = parse_digits(p, 4), mo = parse_digits(p, 2), d = parse_digits(p, 2);
+  if (y < 0 || mo < 1 || d < 1 || *p++ != 'T')
+  {
+    return false;
+  }
+  int h = parse_digits(p, 2), mi = parse_digits(p, 2), s = parse_digits(p, 2);
+  if (h < 0 || mi < 0 || s < 0 || *p != 'Z')
+  {
+    return false; // absolute triggers must be UTC
+  }
+  *out = days_from_civil(y, mo, d) * 86400 + h * 3600 + mi * 60 + s;
+  return true;
+}
+
+bool parse_trigger(const char *line, alarm_trigger *out)
+{
+  const char *value = strchr(line, ':');
+  if (!value)
+  {
+    return false;
+  }
+  int absolute = 0;
+  out->related = TRIGGER_START;
+  for (const char *p = line; p < value; ++p)
+  {
+    if (*p != ';')
+    {
+      continue;
+    }
+    if (strncmp(p + 1, "RELATED=END", 11) == 0)
+    {
+      out->related = TRIGGER_END;
+    }
+    else if (strncmp(p + 1, "VALUE=DATE-TIME", 15) == 0)
+    {
+      absolute = 1;
+    }
+  }
+  ++value;
+  if (absolute || (value[0] >= '0' && value[0] <= '9'))
+  {
+    out->related = TRIGGER_ABSOLUTE;
+    return parse_utc(value, &out->value);
+  }
+  return parse_duration(value, &out->value);
+}
+
+ValarmSniffer::ValarmSniffer(uICAL::istream &inner)
+    : num_triggers(0), inner(inner), in_event(0), in_alarm(0), folded(NULL)
+{
+}
+
+char ValarmSniffer::peek() const
+{
+  return inner.peek();
+}
+
+char ValarmSniffer::get()
+{
+  return inner.get();
+}
+
+bool ValarmSniffer::readuntil(uICAL::string &st, char delim)
+{
+  bool ret = inner.readuntil(st, delim);
+  line(st.c_str());
+  return ret;
+}
+
+// appends text to out, dropping the \ of text escapes; escaped says the
+// last line ended on a \, and the result whether this one does
+static bool append_text(const char *p, char *out, size_t len, bool escaped)
+{
+  size_t n = strlen(out);
+  for (; *p && *p != '\r' && *p != '\n' && n < len - 1; ++p)
+  {
+    if (*p == '\\' && !escaped)
+    {
+      escaped = true;
+      continue;
+    }
+    escaped = false;
+    out[n++] = *p;
+  }
+  out[n] = 0;
+  return escaped;
+}
+
+// appends a property value to out, after a comma if out has one already
+static bool copy_text(const char *l, char *out, size_t len)
+{
+  const char *p = strchr(l, ':');
+  size_t n = strlen(out);
+  if (!p)
+  {
+    return false;
+  }
+  if (n > 0 && n < len - 1)
+  {
+    out[n++] = ',';
+    out[n] = 0;
+  }
+  return append_text(p + 1, out, len, false);
+}
+
+#define STARTS_WITH(l, s) (strncmp((l), (s), sizeof(s) - 1) == 0)
+
+void ValarmSniffer::line(const char *l)
+{
+  // a folded line goes on the end of the property before it
+  if (*l == ' ' || *l == '\t')
+  {
+    if (folded)
+    {
+      folded_escape = append_text(l + 1, folded, folded_len, folded_escape);
+    }
+    return;
+  }
+  folded = NULL;
+  if (STARTS_WITH(l, "BEGIN:VEVENT"))
+  {
+    in_event = 1;
+    in_alarm = 0;
+    num_triggers = 0;
+    summary[0] = categories[0] = 0;
+    strcpy(transp, "OPAQUE");
+  }
+  else if (STARTS_WITH(l, "END:VEVENT"))
+  {
+    in_event = 0;
+  }
+  else if (!in_event)
+  {
+    return;
+  }
+  else if (!in_alarm && STARTS_WITH(l, "SUMMARY"))
+  {
+    summary[0] = 0;
+    folded_escape = copy_text(l, summary, sizeof(summary));
+    folded = summary;
+    folded_len = sizeof(summary);
+  }
+  else if (!in_alarm && STARTS_WITH(l, "CATEGORIES"))
+  {
+    folded_escape = copy_text(l, categories, sizeof(categories));
+    folded = categories;
+    folded_len = sizeof(categories);
+  }
+  else if (!in_alarm && STARTS_WITH(l, "TRANSP"))
+  {
+    transp[0] = 0;
+    folded_escape = copy_text(l, transp, sizeof(transp));
+    folded = transp;
+    folded_len = sizeof(transp);
+  }
+  else if (STARTS_WITH(l, "BEGIN:VALARM"))
+  {
+    in_alarm = 1;
+    alarm_has_trigger = 0;
+    alarm_is_email = 0;
+  }
+  else if (!in_alarm)
+  {
+    return;
+  }
+  else if (STARTS_WITH(l, "END:VALARM"))
+  {
+    in_alarm = 0;
+    // a clock can't send email; those alarms don't ring
+    if (alarm_has_trigger && !alarm_is_email && num_triggers < MAX_TRIGGERS)
+    {
+      triggers[num_triggers++] = alarm;
+    }
+  }
+  else if (STARTS_WITH(l, "TRIGGER"))
+  {
+    alarm_has_trigger = parse_trigger(l, &alarm);
+    if (!alarm_has_trigger)
+    {
+      Serial.printf("unparsed alarm %s\n", l);
+    }
+  }
+  else if (STARTS_WITH(l, "ACTION:EMAIL"))
+  {
+    alarm_is_email = 1;
+  }
+}
+
+void alarm_collector::add(time_t start, const char *name)
+{
+  if (horizon && start >= horizon)
+  {
+    if (start < beyond)
+    {
+      beyond = start;
+    }
+    return;
+  }
+  if (horizon && start > latest)
+  {
+    latest = start;
+  }
+  size_t pos = count;
+  while (pos > 0 && alarms[pos - 1].start > start)
+  {
+    --pos;
+  }
+  if (pos >= MAX_ALARMS)
+  {
+    return;
+  }
+  size_t tail = (count < MAX_ALARMS ? count : MAX_ALARMS - 1) - pos;
+  memmove(&alarms[pos + 1], &alarms[pos], tail * sizeof(alarms[0]));
+  alarms[pos].start = start;
+  strncpy((char *)alarms[pos].name, name, sizeof(alarms[pos].name) - 1);
+  alarms[pos].name[sizeof(alarms[pos].name) - 1] = 0;
+  if (count < MAX_ALARMS)
+  {
+    ++count;
+  }
+}
+
+void alarm_collector::drop_before(time_t t)
+{
+  size_t n = 0;
+  while (n < count && alarms[n].start < t)
+  {
+    ++n;
+  }
+  memmove(&alarms[0], &alarms[n], (count - n) * sizeof(alarms[0]));
+  count -= n;
+}
+
+void expand_event_alarms(const uICAL::VEvent &event, const ValarmSniffer &sniffer,
+                         time_t begin, time_t end, alarm_collector &out)
+{
+  static const alarm_trigger at_start = {TRIGGER_START, 0};
+  const alarm_trigger *triggers = sniffer.triggers;
+  size_t num_triggers = sniffer.num_triggers;
+  if (num_triggers == 0)
+  {
+    triggers = &at_start;
+    num_triggers = 1;
+  }
+
+  // widen the expansion so occurrences whose alarm lands in the window are
+  // seen even though the occurrence itself doesn't; RELATED=END by how long
+  // the event is, which every occurrence shares
+  time_t length = event.end.seconds() - event.start.seconds();
+  time_t earliest = 0, latest = 0;
+  int relative = 0;
+  for (size_t i = 0; i < num_triggers; ++i)
+  {
+    const alarm_trigger &tr = triggers[i];
+    if (tr.related == TRIGGER_ABSOLUTE)
+    {
+      continue;
+    }
+    time_t shift = tr.value;
+    time_t shift_max = shift + (tr.related == TRIGGER_END && length > 0 ? length : 0);
+    if (!relative || shift < earliest)
+    {
+      earliest = shift;
+    }
+    if (!relative || shift_max > latest)
+    {
+      latest = shift_max;
+    }
+    relative = 1;
+  }
+
+  // a series being followed goes on to its next alarm past end, so a sparse
+  // one is found up to ALARM_FOLLOW off, and one that's run out is seen to
+  bool to_next = out.horizon != 0;
+  time_t follow = end < ALARM_NEVER - ALARM_FOLLOW ? end + ALARM_FOLLOW : ALARM_NEVER;
+  if (relative)
+  {
+    auto ev = uICAL::new_ptr<uICAL::VEvent>(event);
+    auto evIt = uICAL::new_ptr<uICAL::VEventIter>(ev, uICAL::DateTime(begin - latest),
+                                                  uICAL::DateTime((to_next ? follow : end) - earliest));
+    while (evIt->next())
+    {
+      uICAL::CalendarEntry_ptr entry = evIt->entry();
+      time_t start = entry->start().seconds();
+      time_t finish = entry->end().seconds();
+      bool past = true;
+      for (size_t i = 0; i < num_triggers; ++i)
+      {
+        const alarm_trigger &tr = triggers[i];
+        if (tr.related == TRIGGER_ABSOLUTE)
+        {
+          continue;
+        }
+        time_t at = (tr.related == TRIGGER_END ? finish : start) + tr.value;
+        if (at >= begin && (at < end || (to_next && at < follow)))
+        {
+          out.add(at, sniffer.summary);
+        }
+        past &= at >= end;
+      }
+      if (to_next && past)
+      {
+        break; // every later occurrence's alarms are later still
+      }
+    }
+  }
+
+  // absolute triggers fire once, however the event recurs
+  for (size_t i = 0; i < num_triggers; ++i)
+  {
+    const alarm_trigger &tr = triggers[i];
+    if (tr.related == TRIGGER_ABSOLUTE && tr.value >= begin && (tr.value < end || (to_next && tr.value < follow)))
+    {
+      out.add(tr.value, sniffer.summary);
+    }
+  }
+  // nothing found up to follow is only known not to be before it
+  if (to_next && follow < out.beyond)
+  {
+    out.beyond = follow;
+  }
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <Arduino.h>
+#include <uICal.h>
+#include <limits>
+#include "state.h"
+
+#define MAX_TRIGGERS 4
+
+// as far on as a time_t goes, with room for a trigger's shift; beyond for
+// a series with no alarm left
+#define ALARM_NEVER (std::numeric_limits<time_t>::max() - 86400 * 366)
+
+// how far past the window a followed series is looked through for its next
+// alarm; one with none in that is looked at again when the window gets there
+#define ALARM_FOLLOW (86400 * 3653)
+
+enum trigger_related
+{
+  TRIGGER_START,
+  TRIGGER_END,
+  TRIGGER_ABSOLUTE,
+};
+
+struct alarm_trigger
+{
+  trigger_related related;
+  time_t value; // seconds relative to start/end, or UTC seconds if absolute
+};
+
+// parses the value part of a TRIGGER line ("TRIGGER;RELATED=END:-PT5M"),
+// returns false for anything we can't turn into an instant
+bool parse_trigger(const char *line, alarm_trigger *out);
+
+// Passes the feed through to uICAL unchanged, while watching the raw lines
+// for VALARM components. uICAL drops VALARMs before building the VEvent, so
+// this is the only place to see them without reading the stream twice. The
+// triggers, SUMMARY, CATEGORIES and TRANSP seen belong to the VEVENT most recently closed, which
+// is the one handed to the Calendar::load callback.
+class ValarmSniffer : public uICAL::istream
+{
+public:
+  ValarmSniffer(uICAL::istream &inner);
+
+  char peek() const;
+  char get();
+  bool readuntil(uICAL::string &st, char delim);
+
+  size_t num_triggers;
+  alarm_trigger triggers[MAX_TRIGGERS];
+  char summary[64];
+  char categories[64];
+  char transp[16];
+
+protected:
+  void line(const char *l);
+
+  uICAL::istream &inner;
+  int in_event;
+  int in_alarm;
+  int alarm_has_trigger;
+  int alarm_is_email;
+  alarm_trigger alarm;
+  // the text a folded line continues, if any
+  char *folded;
+  size_t folded_len;
+  bool folded_escape;
+};
+
+// Keeps the earliest MAX_ALARMS alarm instants, sorted, so events can be
+// expanded and discarded one at a time instead of held for CalendarIter.
+struct alarm_collector
+{
+  size_t count;
+  alarm_entry alarms[MAX_ALARMS];
+  // if set, alarms from horizon on aren't kept, and expand_event_alarms()
+  // goes on past its end to the first of them; the earliest is noted in
+  // beyond, if before it, and the latest kept in latest. Both are for the
+  // caller to reset, a series at a time (src/feedcache.cpp).
+  time_t horizon;
+  time_t beyond, latest;
+
+  void clear() { count = 0; horizon = 0; }
+  void add(time_t start, const char *name);
+  // drops the alarms before t, as the window moves on
+  void drop_before(time_t t);
+};
+
+// emits every alarm instant of event within [begin, end) into out, using the
+// triggers the sniffer saw for it (or the event start if it had none); with
+// out.horizon set, also the first past end, however far on
+void expand_event_alarms(const uICAL::VEvent &event, const ValarmSniffer &sniffer,
+                         time_t begin, time_t end, alarm_collector &out);
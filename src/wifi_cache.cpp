@@ -0,0 +1,70 @@
+#include "wifi_cache.h"
+#include <WiFi.h>
+#include <esp_wifi.h>
+#include <esp_timer.h>
+
+#define FAST_CONNECT_MS 4000
+
+static bool pinned;
+
+bool wifi_fast_connect(Preferences &prefs, const char *ssid, const char *pass)
+{
+  wifi_cache c;
+  if (!ssid[0] || prefs.getBytes("w", &c, sizeof(c)) != sizeof(c) || strncmp(c.ssid, ssid, sizeof(c.ssid)))
+  {
+    return false;
+  }
+  // the pinned config only lives in RAM, so flash keeps the plain one
+  // WiFiManager falls back on
+  esp_wifi_set_storage(WIFI_STORAGE_RAM);
+  WiFi.begin(ssid, pass, c.channel, c.bssid);
+  esp_wifi_set_storage(WIFI_STORAGE_FLASH);
+  pinned = true;
+
+  int64_t started = esp_timer_get_time();
+  while (WiFi.status() != WL_CONNECTED && esp_timer_get_time() - started < FAST_CONNECT_MS * 1000LL)
+  {
+    delay(10);
+  }
+  uint32_t ms = (esp_timer_get_time() - started) / 1000;
+  if (WiFi.status() == WL_CONNECTED)
+  {
+    Serial.printf("fast connect to channel %u in %u ms\n", c.channel, ms);
+    return true;
+  }
+  Serial.printf("fast connect failed after %u ms\n", ms);
+  WiFi.disconnect();
+  wifi_unpin();
+  return false;
+}
+
+void wifi_remember_ap(Preferences &prefs)
+{
+  wifi_cache c, saved;
+  bzero(&c, sizeof(c));
+  strlcpy(c.ssid, WiFi.SSID().c_str(), sizeof(c.ssid));
+  memcpy(c.bssid, WiFi.BSSID(), sizeof(c.bssid));
+  c.channel = WiFi.channel();
+  if (prefs.getBytes("w", &saved, sizeof(saved)) != sizeof(saved) || memcmp(&c, &saved, sizeof(c)))
+  {
+    prefs.putBytes("w", &c, sizeof(c));
+  }
+}
+
+void wifi_unpin()
+{
+  if (!pinned)
+  {
+    return;
+  }
+  wifi_config_t conf;
+  if (esp_wifi_get_config(WIFI_IF_STA, &conf) == ESP_OK)
+  {
+    conf.sta.bssid_set = 0;
+    conf.sta.channel = 0;
+    esp_wifi_set_storage(WIFI_STORAGE_RAM);
+    esp_wifi_set_config(WIFI_IF_STA, &conf);
+    esp_wifi_set_storage(WIFI_STORAGE_FLASH);
+  }
+  pinned = false;
+}
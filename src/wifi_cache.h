@@ -0,0 +1,25 @@
+#pragma once
+
+#include <Arduino.h>
+#include <Preferences.h>
+
+// The clock always joins the same AP, so its BSSID and channel are kept
+// (Preferences key "w") and the next boot connects straight to them instead
+// of scanning every channel. DHCP asks for the last address back
+// (CONFIG_LWIP_DHCP_RESTORE_LAST_IP), which skips the discover/offer round.
+struct wifi_cache
+{
+  char ssid[33];
+  uint8_t bssid[6];
+  uint8_t channel;
+};
+
+// tries the cached AP for a few seconds; on false the caller goes on to
+// WiFiManager's usual scan
+bool wifi_fast_connect(Preferences &prefs, const char *ssid, const char *pass);
+
+// call once connected, stores the AP if it changed
+void wifi_remember_ap(Preferences &prefs);
+
+// after a disconnect, reconnects are left to scan again in case the AP moved
+void wifi_unpin();
@@ -0,0 +1,252 @@
+// The delta patcher (src/delta.cpp) on small patches made here by hand, fed
+// whole and a byte at a time: pio test -e deltatest
+#include <Arduino.h>
+#include <unity.h>
+#include <algorithm>
+#include <vector>
+#include "bundle.h"
+#include "delta.h"
+
+typedef std::vector<uint8_t> bytes;
+
+// a source image in memory, and a target slot that takes at most slot bytes
+struct memory_io : delta_io
+{
+  bytes source, target;
+  size_t slot;
+
+  memory_io(const bytes &source, size_t slot) : source(source), slot(slot) {}
+  bool read_source(uint32_t offset, uint8_t *buf, size_t len)
+  {
+    if (offset + len > source.size())
+    {
+      return false;
+    }
+    memcpy(buf, source.data() + offset, len);
+    return true;
+  }
+  bool write_target(const uint8_t *buf, size_t len)
+  {
+    if (target.size() + len > slot)
+    {
+      return false;
+    }
+    target.insert(target.end(), buf, buf + len);
+    return true;
+  }
+};
+
+static void put_varint(bytes &out, uint32_t v)
+{
+  while (v >= 0x80)
+  {
+    out.push_back((v & 0x7f) | 0x80);
+    v >>= 7;
+  }
+  out.push_back(v);
+}
+
+static bytes image(size_t len, uint32_t seed)
+{
+  bytes out(len);
+  for (size_t i = 0; i < len; ++i)
+  {
+    seed = seed * 1103515245 + 12345;
+    out[i] = seed >> 16;
+  }
+  return out;
+}
+
+static bytes header(const bytes &source, const bytes &target)
+{
+  delta_header h;
+  memcpy(h.magic, DELTA_MAGIC, sizeof(h.magic));
+  h.version = DELTA_VERSION;
+  h.source_size = source.size();
+  h.source_crc = bundle_crc32(0, source.data(), source.size());
+  h.target_size = target.size();
+  h.target_crc = bundle_crc32(0, target.data(), target.size());
+  return bytes((uint8_t *)&h, (uint8_t *)&h + sizeof(h));
+}
+
+// the whole source unchanged, as one DIFF of nothing but zeros
+static bytes copy_patch(const bytes &source)
+{
+  bytes p = header(source, source);
+  p.push_back(DELTA_DIFF);
+  put_varint(p, source.size());
+  put_varint(p, 0);
+  put_varint(p, source.size());
+  p.push_back(DELTA_END);
+  return p;
+}
+
+// the whole target as one EXTRA
+static bytes extra_patch(const bytes &source, const bytes &target)
+{
+  bytes p = header(source, target);
+  p.push_back(DELTA_EXTRA);
+  put_varint(p, target.size());
+  p.insert(p.end(), target.begin(), target.end());
+  p.push_back(DELTA_END);
+  return p;
+}
+
+static delta_result apply(memory_io &io, const bytes &patch, bool bytewise)
+{
+  delta_patcher patcher(io);
+  if (!bytewise)
+  {
+    return patcher.feed(patch.data(), patch.size());
+  }
+  delta_result r = DELTA_MORE;
+  for (size_t i = 0; i < patch.size() && r == DELTA_MORE; ++i)
+  {
+    r = patcher.feed(&patch[i], 1);
+  }
+  return r;
+}
+
+static void test_identical()
+{
+  bytes source = image(1000, 1);
+  for (bool bytewise : {false, true})
+  {
+    memory_io io(source, source.size());
+    TEST_ASSERT_EQUAL(DELTA_DONE, apply(io, copy_patch(source), bytewise));
+    TEST_ASSERT_TRUE(io.target == source);
+  }
+}
+
+static void test_diff_runs()
+{
+  // every other byte one more, then the last 100 bytes new
+  bytes source = image(600, 2), target = source;
+  for (size_t i = 1; i < 500; i += 2)
+  {
+    target[i]++;
+  }
+  bytes tail = image(100, 3);
+  std::copy(tail.begin(), tail.end(), target.begin() + 500);
+
+  bytes p = header(source, target);
+  p.push_back(DELTA_DIFF);
+  put_varint(p, 500);
+  put_varint(p, 0);
+  for (size_t i = 0; i < 250; ++i)
+  {
+    put_varint(p, 1);
+    put_varint(p, 1);
+    p.push_back(1);
+  }
+  p.push_back(DELTA_EXTRA);
+  put_varint(p, tail.size());
+  p.insert(p.end(), tail.begin(), tail.end());
+  p.push_back(DELTA_END);
+
+  memory_io io(source, target.size());
+  TEST_ASSERT_EQUAL(DELTA_DONE, apply(io, p, false));
+  TEST_ASSERT_TRUE(io.target == target);
+}
+
+static void test_empty_source()
+{
+  bytes source, target = image(700, 4);
+  for (bool bytewise : {false, true})
+  {
+    memory_io io(source, target.size());
+    TEST_ASSERT_EQUAL(DELTA_DONE, apply(io, extra_patch(source, target), bytewise));
+    TEST_ASSERT_TRUE(io.target == target);
+  }
+
+  // a DIFF has nothing to read from
+  bytes p = header(source, target);
+  p.push_back(DELTA_DIFF);
+  put_varint(p, 1);
+  put_varint(p, 0);
+  put_varint(p, 1);
+  p.push_back(DELTA_END);
+  memory_io io(source, target.size());
+  TEST_ASSERT_EQUAL(DELTA_CORRUPT, apply(io, p, false));
+}
+
+static void test_truncated()
+{
+  bytes source = image(300, 5), target = image(300, 6);
+  bytes p = extra_patch(source, target);
+  // anywhere short of the end it only wants more
+  for (size_t len : {(size_t)0, sizeof(delta_header) - 1, sizeof(delta_header), sizeof(delta_header) + 2,
+                     p.size() - 1})
+  {
+    memory_io io(source, target.size());
+    TEST_ASSERT_EQUAL(DELTA_MORE, apply(io, bytes(p.begin(), p.begin() + len), false));
+  }
+  // an END before the target is all there
+  bytes shortened = header(source, target);
+  shortened.push_back(DELTA_EXTRA);
+  put_varint(shortened, 10);
+  shortened.insert(shortened.end(), target.begin(), target.begin() + 10);
+  shortened.push_back(DELTA_END);
+  memory_io io(source, target.size());
+  TEST_ASSERT_EQUAL(DELTA_CORRUPT, apply(io, shortened, false));
+}
+
+static void test_bad_crc()
+{
+  bytes source = image(400, 7), target = image(400, 8);
+
+  bytes p = extra_patch(source, target);
+  ((delta_header *)p.data())->target_crc ^= 1;
+  memory_io io(source, target.size());
+  TEST_ASSERT_EQUAL(DELTA_CORRUPT, apply(io, p, false));
+
+  // a patch from some other image
+  p = extra_patch(source, target);
+  ((delta_header *)p.data())->source_crc ^= 1;
+  memory_io other(source, target.size());
+  TEST_ASSERT_EQUAL(DELTA_WRONG_SOURCE, apply(other, p, false));
+  TEST_ASSERT_EQUAL(0, other.target.size());
+
+  p = extra_patch(source, target);
+  p[0] = 'X';
+  memory_io magic(source, target.size());
+  TEST_ASSERT_EQUAL(DELTA_BAD_HEADER, apply(magic, p, false));
+}
+
+static void test_larger_than_slot()
+{
+  bytes source = image(200, 9), target = image(3 * DELTA_OUT_BUFFER, 10);
+  for (bool bytewise : {false, true})
+  {
+    memory_io io(source, 2 * DELTA_OUT_BUFFER);
+    TEST_ASSERT_EQUAL(DELTA_IO_ERROR, apply(io, extra_patch(source, target), bytewise));
+    TEST_ASSERT_TRUE(io.target.size() <= io.slot);
+  }
+
+  // ops past the header's target size are the patch's fault
+  bytes p = header(source, bytes(10));
+  p.push_back(DELTA_EXTRA);
+  put_varint(p, 11);
+  memory_io io(source, target.size());
+  TEST_ASSERT_EQUAL(DELTA_CORRUPT, apply(io, p, false));
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_identical);
+  RUN_TEST(test_diff_runs);
+  RUN_TEST(test_empty_source);
+  RUN_TEST(test_truncated);
+  RUN_TEST(test_bad_crc);
+  RUN_TEST(test_larger_than_slot);
+  return UNITY_END();
+}
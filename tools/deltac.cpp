@@ -0,0 +1,302 @@
+// Makes a delta OTA patch (see src/delta.h) from the image a clock is
+// running to a new one, and applies it again with the clock's own patcher
+// to check the round trip before writing anything.
+//
+//   deltac old.bin new.bin out.patch
+//   deltac --apply old.bin in.patch out.bin
+//
+// Serve the patch with Content-Type application/vnd.clockthing.delta from
+// /ota/from/<old elf sha256>.img.
+#include <Arduino.h>
+#include <vector>
+#include "bundle.h"
+#include "delta.h"
+
+// exact matches shorter than this aren't worth an op
+#define MIN_MATCH 16
+#define HASH_BITS 20
+#define MAX_CHAIN 64
+// forward extension gives up after this long without the match improving
+#define EXTEND_SLACK 64
+
+typedef std::vector<uint8_t> bytes;
+
+static bool read_file(const char *path, bytes &out)
+{
+  FILE *f = fopen(path, "rb");
+  if (!f)
+  {
+    fprintf(stderr, "can't open %s\n", path);
+    return false;
+  }
+  uint8_t buf[65536];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+  {
+    out.insert(out.end(), buf, buf + n);
+  }
+  fclose(f);
+  return true;
+}
+
+static bool write_file(const char *path, const bytes &data)
+{
+  FILE *f = fopen(path, "wb");
+  if (!f || fwrite(data.data(), 1, data.size(), f) != data.size())
+  {
+    fprintf(stderr, "can't write %s\n", path);
+    return false;
+  }
+  fclose(f);
+  return true;
+}
+
+static void put_varint(bytes &out, uint32_t v)
+{
+  while (v >= 0x80)
+  {
+    out.push_back((v & 0x7f) | 0x80);
+    v >>= 7;
+  }
+  out.push_back(v);
+}
+
+static uint32_t hash8(const uint8_t *p)
+{
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return (v * 0x9e3779b97f4a7c15ull) >> (64 - HASH_BITS);
+}
+
+struct patch_writer
+{
+  const bytes &source, &target;
+  bytes out;
+  uint32_t source_pos; // where the last diff left the source
+
+  patch_writer(const bytes &source, const bytes &target) : source(source), target(target), source_pos(0)
+  {
+  }
+
+  void extra(uint32_t from, uint32_t len)
+  {
+    if (!len)
+    {
+      return;
+    }
+    out.push_back(DELTA_EXTRA);
+    put_varint(out, len);
+    out.insert(out.end(), target.begin() + from, target.begin() + from + len);
+  }
+
+  void diff(uint32_t from, uint32_t src, uint32_t len)
+  {
+    out.push_back(DELTA_DIFF);
+    put_varint(out, len);
+    int32_t skip = (int32_t)(src - source_pos);
+    put_varint(out, ((uint32_t)skip << 1) ^ (uint32_t)(skip >> 31));
+    source_pos = src + len;
+
+    uint32_t i = 0;
+    while (i < len)
+    {
+      uint32_t zeros = 0;
+      while (i + zeros < len && target[from + i + zeros] == source[src + i + zeros])
+      {
+        zeros++;
+      }
+      put_varint(out, zeros);
+      i += zeros;
+      if (i == len)
+      {
+        break;
+      }
+      // literals run on until three equal bytes, which are cheaper as zeros
+      uint32_t n = 0;
+      while (i + n < len)
+      {
+        uint32_t same = 0;
+        while (same < 3 && i + n + same < len && target[from + i + n + same] == source[src + i + n + same])
+        {
+          same++;
+        }
+        if (same == 3 || i + n + same == len)
+        {
+          break;
+        }
+        n += same + 1;
+      }
+      put_varint(out, n);
+      for (uint32_t k = 0; k < n; ++k)
+      {
+        out.push_back(target[from + i + k] - source[src + i + k]);
+      }
+      i += n;
+    }
+  }
+};
+
+// Greedy, bsdiff-like: find an exact match through a hash of 8 byte
+// windows, grow it backwards exactly and forwards while more bytes match
+// than don't, and diff the lot. Everything between matches is extra.
+static bytes make_patch(const bytes &source, const bytes &target)
+{
+  std::vector<int32_t> head(1 << HASH_BITS, -1), chain(source.size(), -1);
+  for (uint32_t i = 0; i + 8 <= source.size(); ++i)
+  {
+    uint32_t h = hash8(&source[i]);
+    chain[i] = head[h];
+    head[h] = i;
+  }
+
+  delta_header h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, DELTA_MAGIC, sizeof(h.magic));
+  h.version = DELTA_VERSION;
+  h.source_size = source.size();
+  h.source_crc = bundle_crc32(0, source.data(), source.size());
+  h.target_size = target.size();
+  h.target_crc = bundle_crc32(0, target.data(), target.size());
+
+  patch_writer w(source, target);
+  w.out.insert(w.out.end(), (uint8_t *)&h, (uint8_t *)&h + sizeof(h));
+
+  uint32_t pos = 0, extra_from = 0;
+  while (pos + 8 <= target.size())
+  {
+    uint32_t best_len = 0, best_src = 0;
+    int steps = 0;
+    for (int32_t c = head[hash8(&target[pos])]; c >= 0 && steps < MAX_CHAIN; c = chain[c], ++steps)
+    {
+      uint32_t len = 0;
+      while (c + len < source.size() && pos + len < target.size() && source[c + len] == target[pos + len])
+      {
+        len++;
+      }
+      if (len > best_len)
+      {
+        best_len = len;
+        best_src = c;
+      }
+    }
+    if (best_len < MIN_MATCH)
+    {
+      pos++;
+      continue;
+    }
+    while (pos > extra_from && best_src > 0 && source[best_src - 1] == target[pos - 1])
+    {
+      pos--;
+      best_src--;
+      best_len++;
+    }
+    int score = 0, best_score = 0;
+    uint32_t len = best_len;
+    for (uint32_t i = best_len; best_src + i < source.size() && pos + i < target.size() && i - len < EXTEND_SLACK; ++i)
+    {
+      score += source[best_src + i] == target[pos + i] ? 1 : -1;
+      if (score > best_score)
+      {
+        best_score = score;
+        len = i + 1;
+      }
+    }
+    w.extra(extra_from, pos - extra_from);
+    w.diff(pos, best_src, len);
+    pos += len;
+    extra_from = pos;
+  }
+  w.extra(extra_from, target.size() - extra_from);
+  w.out.push_back(DELTA_END);
+  return w.out;
+}
+
+struct memory_io : delta_io
+{
+  const bytes &source;
+  bytes target;
+
+  memory_io(const bytes &source) : source(source)
+  {
+  }
+  bool read_source(uint32_t offset, uint8_t *buf, size_t len)
+  {
+    if (offset + len > source.size())
+    {
+      return false;
+    }
+    memcpy(buf, &source[offset], len);
+    return true;
+  }
+  bool write_target(const uint8_t *buf, size_t len)
+  {
+    target.insert(target.end(), buf, buf + len);
+    return true;
+  }
+};
+
+// in odd sized pieces, the way it comes off the network
+static delta_result apply_patch(const bytes &source, const bytes &patch, bytes &target)
+{
+  memory_io io(source);
+  delta_patcher patcher(io);
+  delta_result result = DELTA_MORE;
+  for (size_t i = 0; i < patch.size() && result == DELTA_MORE; i += 1357)
+  {
+    result = patcher.feed(&patch[i], patch.size() - i < 1357 ? patch.size() - i : 1357);
+  }
+  target.swap(io.target);
+  return result;
+}
+
+static int usage()
+{
+  fprintf(stderr, "usage: deltac old.bin new.bin out.patch\n"
+                  "       deltac --apply old.bin in.patch out.bin\n");
+  return 2;
+}
+
+int main(int argc, char **argv)
+{
+  if (argc == 5 && strcmp(argv[1], "--apply") == 0)
+  {
+    bytes source, patch, target;
+    if (!read_file(argv[2], source) || !read_file(argv[3], patch))
+    {
+      return 1;
+    }
+    delta_result result = apply_patch(source, patch, target);
+    if (result != DELTA_DONE)
+    {
+      fprintf(stderr, "patch failed: %d\n", result);
+      return 1;
+    }
+    return write_file(argv[4], target) ? 0 : 1;
+  }
+  if (argc != 4)
+  {
+    return usage();
+  }
+
+  bytes source, target;
+  if (!read_file(argv[1], source) || !read_file(argv[2], target))
+  {
+    return 1;
+  }
+  bytes patch = make_patch(source, target);
+
+  bytes check;
+  delta_result result = apply_patch(source, patch, check);
+  if (result != DELTA_DONE || check != target)
+  {
+    fprintf(stderr, "round trip failed: %d\n", result);
+    return 1;
+  }
+  if (!write_file(argv[3], patch))
+  {
+    return 1;
+  }
+  fprintf(stderr, "%zu -> %zu bytes, patch %zu bytes (%.1f%%)\n", source.size(), target.size(), patch.size(),
+          100.0 * patch.size() / (target.size() ? target.size() : 1));
+  return 0;
+}
@@ -0,0 +1,120 @@
+// Runs src/discipline.cpp against simulated clocks with known drift, to
+// check the estimates converge and see what error to expect between syncs.
+//
+//   driftsim [--sys-ppm P] [--rtc-ppm P] [--jitter-ms J] [--days D] [--reboot-days R] [--off-hours H] [--seed S]
+//
+// The system clock runs at the esp_timer's rate and slews are applied at
+// once; NTP samples are off by up to the jitter either way. Every few days
+// the clock is off for a while (only the RTC runs) and boots again,
+// reading the RTC as its seconds turn over, like setup() does.
+#include <Arduino.h>
+#include <random>
+#include "discipline.h"
+
+#define US 1000000LL
+#define DAY (86400 * US)
+
+static int usage()
+{
+  fprintf(stderr, "usage: driftsim [--sys-ppm P] [--rtc-ppm P] [--jitter-ms J] [--days D] [--reboot-days R] "
+                  "[--off-hours H] [--seed S]\n");
+  return 2;
+}
+
+int main(int argc, char **argv)
+{
+  double sys_ppm = 17.3, rtc_ppm = -31.0, jitter_ms = 20, off_hours = 12;
+  int days = 30, reboot_days = 3;
+  unsigned seed = 1;
+  for (int i = 1; i < argc; i += 2)
+  {
+    if (i + 1 >= argc)
+      return usage();
+    else if (strcmp(argv[i], "--sys-ppm") == 0)
+      sys_ppm = atof(argv[i + 1]);
+    else if (strcmp(argv[i], "--rtc-ppm") == 0)
+      rtc_ppm = atof(argv[i + 1]);
+    else if (strcmp(argv[i], "--jitter-ms") == 0)
+      jitter_ms = atof(argv[i + 1]);
+    else if (strcmp(argv[i], "--days") == 0)
+      days = atoi(argv[i + 1]);
+    else if (strcmp(argv[i], "--reboot-days") == 0)
+      reboot_days = atoi(argv[i + 1]);
+    else if (strcmp(argv[i], "--off-hours") == 0)
+      off_hours = atof(argv[i + 1]);
+    else if (strcmp(argv[i], "--seed") == 0)
+      seed = atoi(argv[i + 1]);
+    else
+      return usage();
+  }
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<double> jitter(-jitter_ms * 1000, jitter_ms * 1000);
+
+  discipline_saved saved;
+  memset(&saved, 0, sizeof(saved));
+  clock_discipline d;
+
+  // the RTC starts out right
+  const int64_t start = 1700000000 * US;
+  int64_t t = start;
+  int64_t rtc_set_true = t, rtc_set_value = t;
+  double rtc_rate = 1 + rtc_ppm / 1e6, sys_rate = 1 + sys_ppm / 1e6;
+
+  printf("day  sys ppb (est)      rtc ppb (est)      worst error  boot error (raw)\n");
+  for (int boot = 0; t < start + days * DAY; ++boot)
+  {
+    if (boot)
+    {
+      t += off_hours * 3600 * US;
+    }
+    // boot: wait for the RTC to tick over, at true time edge
+    double rtc_now = rtc_set_value + (t - rtc_set_true) * rtc_rate;
+    int64_t next_second = ((int64_t)(rtc_now / US) + 1) * US;
+    int64_t edge = rtc_set_true + (int64_t)((next_second - rtc_set_value) / rtc_rate);
+    t = edge;
+    int64_t mono_base = t; // esp_timer counts from here at sys_rate
+    auto mono = [&](int64_t at) { return (int64_t)((at - mono_base) * sys_rate); };
+
+    d.begin(saved, mono(t));
+    int64_t boot_time = d.rtc_boot(next_second, mono(t));
+    int64_t boot_error = boot_time - t, raw_error = next_second - t;
+    // system clock = esp_timer + adjust
+    int64_t adjust = boot_time - mono(t);
+
+    int64_t boot_end = t + reboot_days * DAY;
+    if (boot_end > start + days * DAY)
+    {
+      boot_end = start + days * DAY;
+    }
+    int64_t next_ntp = t + 5 * US, next_rate = t + 60 * US, worst = 0;
+    while (t < boot_end)
+    {
+      t = next_ntp < next_rate ? next_ntp : next_rate;
+      int64_t sys = mono(t) + adjust;
+      int64_t err = sys - t;
+      if (err < 0)
+        err = -err;
+      if (d.synced && err > worst)
+        worst = err;
+
+      if (t == next_rate)
+      {
+        adjust += d.rate_correction(mono(t));
+        next_rate += 60 * US;
+        continue;
+      }
+      bool step;
+      adjust += d.sample(mono(t), t + (int64_t)jitter(rng), sys, &step);
+      next_ntp = t + d.interval_ms() * 1000LL;
+
+      // the RTC gets the new time at the next second edge
+      rtc_set_true = t;
+      rtc_set_value = mono(t) + adjust;
+      d.rtc_written(rtc_set_value);
+    }
+    saved = d.saved;
+    printf("%3lld  %6.0f (%7d)  %6.0f (%7d)  %8.1f ms  %6.1f ms (%.1f ms)\n", (long long)((t - start) / DAY), sys_ppm * 1000,
+           saved.sys_ppb, rtc_ppm * 1000, saved.rtc_ppb, worst / 1000.0, boot_error / 1000.0, raw_error / 1000.0);
+  }
+  return 0;
+}
@@ -0,0 +1,272 @@
+// Renders the clock face (src/face.cpp) with LVGL into a framebuffer on
+// the host, and measures what each kind of change costs to draw: how many
+// pixels and flushes, and how long lv_task_handler() takes.
+//
+//   facebench [--iterations N] [--png DIR]
+//
+// Each scenario shows the face at one second, then ticks to the next and
+// measures that frame only. --png writes the measured frame of each
+// scenario as DIR/<scenario>.png.
+#include <Arduino.h>
+#include <string>
+#include "bundle.h"
+#include "clock.h"
+#include "face.h"
+#include "host_hal.h"
+
+// a partial buffer, so big changes take several flushes as on the panel
+#define BENCH_BUFFER_LINES 40
+#define BENCH_WIDTH LV_HOR_RES_MAX
+#define BENCH_HEIGHT LV_VER_RES_MAX
+
+clock_state state;
+
+struct bench_face : lvgl_face
+{
+  uint8_t backlight = 255;
+  void set_backlight(uint8_t level)
+  {
+    backlight = level;
+  }
+};
+
+static host_clock hw_clock;
+static host_rtc hw_rtc;
+static bench_face face;
+static host_network network;
+static host_storage storage;
+static host_buzzer buzzer;
+static clock_hal hal = {&hw_clock, &hw_rtc, &face, &network, &storage, &buzzer};
+
+static lv_color_t framebuffer[BENCH_WIDTH * BENCH_HEIGHT];
+static uint32_t flushes, pixels;
+
+static void bench_flush(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color)
+{
+  int32_t w = lv_area_get_width(area);
+  for (int32_t y = area->y1; y <= area->y2; ++y)
+  {
+    memcpy(&framebuffer[y * BENCH_WIDTH + area->x1], color, w * sizeof(lv_color_t));
+    color += w;
+  }
+  flushes++;
+  pixels += lv_area_get_size(area);
+  lv_disp_flush_ready(drv);
+}
+
+static void bench_setup()
+{
+  static lv_disp_buf_t disp_buf;
+  static lv_color_t buf[BENCH_WIDTH * BENCH_BUFFER_LINES];
+  lv_init();
+  lv_disp_buf_init(&disp_buf, buf, NULL, BENCH_WIDTH * BENCH_BUFFER_LINES);
+  lv_disp_drv_t drv;
+  lv_disp_drv_init(&drv);
+  drv.hor_res = BENCH_WIDTH;
+  drv.ver_res = BENCH_HEIGHT;
+  drv.flush_cb = bench_flush;
+  drv.buffer = &disp_buf;
+  lv_disp_drv_register(&drv);
+  face.create();
+}
+
+// one pass of the refresh task; returns how long it took in us
+static int64_t bench_frame()
+{
+  lv_tick_inc(LV_DISP_DEF_REFR_PERIOD);
+  int64_t started = hw_clock.mono_us();
+  lv_task_handler();
+  return hw_clock.mono_us() - started;
+}
+
+static void append32(std::string &out, uint32_t v)
+{
+  for (int shift = 24; shift >= 0; shift -= 8)
+  {
+    out += (char)(v >> shift);
+  }
+}
+
+static void chunk(FILE *f, const char *type, const std::string &data)
+{
+  std::string c;
+  append32(c, data.size());
+  c += type;
+  c += data;
+  std::string crc;
+  append32(crc, bundle_crc32(0, c.data() + 4, c.size() - 4));
+  fwrite(c.data(), 1, c.size(), f);
+  fwrite(crc.data(), 1, crc.size(), f);
+}
+
+// an RGB PNG of the framebuffer, deflated with stored blocks only, so it
+// needs no zlib
+static bool write_png(const std::string &path)
+{
+  std::string raw;
+  raw.reserve(BENCH_HEIGHT * (1 + BENCH_WIDTH * 3));
+  for (int y = 0; y < BENCH_HEIGHT; ++y)
+  {
+    raw += (char)0; // no filter
+    for (int x = 0; x < BENCH_WIDTH; ++x)
+    {
+      uint32_t c = lv_color_to32(framebuffer[y * BENCH_WIDTH + x]);
+      raw += (char)(c >> 16);
+      raw += (char)(c >> 8);
+      raw += (char)c;
+    }
+  }
+
+  std::string z = "\x78\x01";
+  uint32_t a = 1, b = 0;
+  for (unsigned char ch : raw)
+  {
+    a = (a + ch) % 65521;
+    b = (b + a) % 65521;
+  }
+  for (size_t at = 0; at < raw.size(); at += 65535)
+  {
+    uint16_t len = raw.size() - at < 65535 ? raw.size() - at : 65535;
+    z += (char)(at + len == raw.size());
+    z += (char)len;
+    z += (char)(len >> 8);
+    z += (char)~len;
+    z += (char)(~len >> 8);
+    z.append(raw, at, len);
+  }
+  append32(z, (b << 16) | a);
+
+  std::string ihdr;
+  append32(ihdr, BENCH_WIDTH);
+  append32(ihdr, BENCH_HEIGHT);
+  ihdr += std::string("\x08\x02\x00\x00\x00", 5); // 8 bit RGB
+
+  FILE *f = fopen(path.c_str(), "wb");
+  if (!f)
+  {
+    return false;
+  }
+  fwrite("\x89PNG\r\n\x1a\n", 1, 8, f);
+  chunk(f, "IHDR", ihdr);
+  chunk(f, "IDAT", z);
+  chunk(f, "IEND", "");
+  return fclose(f) == 0;
+}
+
+struct scenario
+{
+  const char *name;
+  const char *from; // UTC, shown before the measured frame
+  const char *to;
+  void (*prepare)();
+};
+
+static time_t parse(const char *when)
+{
+  struct tm t;
+  bzero(&t, sizeof(t));
+  strptime(when, "%F %T", &t);
+  return timegm(&t);
+}
+
+// fresh syncs, no warnings, no alarms
+static void calm()
+{
+  bzero(&state, sizeof(state));
+  beeping = 0;
+  want_stop = 0;
+  ota_ready = 0;
+  last_alarm = next_alarm = 0;
+  network.up = true;
+  network.web_portal = network.config_portal = false;
+}
+
+static void with_alarm()
+{
+  calm();
+  state.num_alarms = 1;
+  state.alarms[0].start = parse("2026-03-14 10:16:00");
+  strlcpy((char *)state.alarms[0].name, "Standup", sizeof(state.alarms[0].name));
+}
+
+static void with_portal()
+{
+  calm();
+  network.web_portal = true;
+}
+
+static const scenario scenarios[] = {
+    {"second", "2026-03-14 10:15:20", "2026-03-14 10:15:21", calm},
+    {"minute", "2026-03-14 10:15:59", "2026-03-14 10:16:00", calm},
+    {"date", "2026-03-14 23:59:59", "2026-03-15 00:00:00", calm},
+    {"alarm", "2026-03-14 10:15:59", "2026-03-14 10:16:00", with_alarm},
+    {"portal", "2026-03-14 10:15:19", "2026-03-14 10:15:20", with_portal},
+};
+
+static int usage()
+{
+  fprintf(stderr, "usage: facebench [--iterations N] [--png DIR]\n");
+  return 2;
+}
+
+int main(int argc, char **argv)
+{
+  int iterations = 50;
+  const char *png_dir = NULL;
+  for (int i = 1; i < argc; ++i)
+  {
+    if (i + 1 >= argc)
+      return usage();
+    else if (strcmp(argv[i], "--iterations") == 0)
+      iterations = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--png") == 0)
+      png_dir = argv[++i];
+    else
+      return usage();
+  }
+  if (iterations < 1)
+  {
+    return usage();
+  }
+  setenv("TZ", "UTC0", 1);
+  tzset();
+  bench_setup();
+
+  // the whole screen, as after boot
+  flushes = pixels = 0;
+  lv_obj_invalidate(lv_scr_act());
+  int64_t full_us = bench_frame();
+  printf("%-8s %8s %8s %10s %10s %10s\n", "scenario", "frames", "flushes", "pixels", "avg us", "max us");
+  printf("%-8s %8d %8u %10u %10lld %10lld\n", "full", 1, flushes, pixels, (long long)full_us, (long long)full_us);
+
+  for (const scenario &s : scenarios)
+  {
+    time_t from = parse(s.from), to = parse(s.to);
+    uint32_t frame_flushes = 0, frame_pixels = 0;
+    int64_t total_us = 0, max_us = 0;
+    for (int i = 0; i < iterations; ++i)
+    {
+      s.prepare();
+      last_synced = last_success = last_ota_attempt = from;
+      clock_tick(hal, from, 0);
+      lv_obj_invalidate(lv_scr_act());
+      bench_frame();
+
+      flushes = pixels = 0;
+      clock_tick(hal, to, 0);
+      int64_t us = bench_frame();
+      total_us += us;
+      max_us = us > max_us ? us : max_us;
+      frame_flushes = flushes;
+      frame_pixels = pixels;
+    }
+    printf("%-8s %8d %8u %10u %10lld %10lld\n", s.name, iterations, frame_flushes, frame_pixels,
+           (long long)(total_us / iterations), (long long)max_us);
+    if (png_dir && !write_png(std::string(png_dir) + "/" + s.name + ".png"))
+    {
+      fprintf(stderr, "can't write %s/%s.png\n", png_dir, s.name);
+      return 1;
+    }
+  }
+  return 0;
+}
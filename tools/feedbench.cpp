@@ -0,0 +1,490 @@
+// Times the feed parse path from fetch_feed() (src/feeds.cpp) on synthetic
+// feeds of growing size: expand_calendar() loading zones from the packed
+// fallback zones as they're named, and record_offsets(), with the time
+// taken, the peak heap above what was in use before, the number of
+// allocations and of zone lookups.
+//
+//   feedbench [--baseline FILE] [--write-baseline FILE] [--runs N] [--dump DIR] [--only lookups]
+//
+// Each scale point sets how many events there are, what share of them
+// recur, how many EXDATEs each series has, how many zones are used, whether
+// the feed defines them or only names them by their Windows names, and
+// whether long lines are folded. Events spread over the past years like an
+// old calendar's do. First, the ways of finding a zone by name are timed
+// over every zone name and alias. --baseline compares against an earlier
+// --write-baseline and exits 1 if the peak or the allocations grew by more
+// than 10%, or a time by more than 50%; points it doesn't have are only
+// reported. --dump writes each feed to DIR. --only lookups stops after the
+// lookups, which don't need uICAL to get anything right.
+#include <Arduino.h>
+#include <malloc.h>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <uICal.h>
+#include "expand.h"
+#include "tzhash.h"
+#include "tzpack.h"
+
+#define BENCH_NOW 1773057600 // 2026-03-09 12:00 UTC
+#define BENCH_YEARS 5 // of history
+
+static size_t heap_live, heap_peak, heap_allocs;
+
+void *operator new(size_t size)
+{
+  void *p = malloc(size ? size : 1);
+  if (!p)
+  {
+    throw std::bad_alloc();
+  }
+  heap_allocs++;
+  heap_live += malloc_usable_size(p);
+  heap_peak = heap_live > heap_peak ? heap_live : heap_peak;
+  return p;
+}
+
+void *operator new[](size_t size)
+{
+  return operator new(size);
+}
+
+void operator delete(void *p) noexcept
+{
+  if (p)
+  {
+    heap_live -= malloc_usable_size(p);
+    free(p);
+  }
+}
+
+void operator delete[](void *p) noexcept
+{
+  operator delete(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+  operator delete(p);
+}
+
+void operator delete[](void *p, size_t) noexcept
+{
+  operator delete(p);
+}
+
+static alarm_collector alarms;
+
+struct scale_point
+{
+  const char *name;
+  int events;
+  int recurring_percent;
+  int exdates; // per recurring event
+  int zones;
+  bool windows; // names the zones by their Windows names, without defining them
+  bool fold;
+};
+
+static const scale_point points[] = {
+    {"100", 100, 10, 0, 1, false, false},
+    {"1k", 1000, 20, 2, 2, false, true},
+    {"10k", 10000, 20, 2, 4, false, true},
+    {"10k-rrule", 10000, 80, 10, 4, false, true},
+    {"10k-zones", 10000, 20, 2, 8, false, true},
+    {"10k-windows", 10000, 20, 2, 8, true, true},
+    {"30k", 30000, 20, 4, 8, false, true},
+};
+
+static const char *const zones[] = {
+    "America/Los_Angeles", "America/New_York", "Europe/London", "Europe/Berlin",
+    "Asia/Tokyo", "Australia/Sydney", "Asia/Kolkata", "America/Sao_Paulo",
+};
+
+static const char *const windows_zones[] = {
+    "Pacific Standard Time", "Eastern Standard Time", "GMT Standard Time", "W. Europe Standard Time",
+    "Tokyo Standard Time", "AUS Eastern Standard Time", "India Standard Time", "E. South America Standard Time",
+};
+
+struct result
+{
+  double ms;
+  size_t peak;
+  size_t allocs;
+  size_t alarms;
+  size_t lookups;
+};
+
+static tzpack pack;
+
+// tzdb_load_zone() (src/tzdb.cpp) on the embedded pack
+static bool load_zone(const char *tzid, uICAL::TZMap_ptr &tzmap)
+{
+  int zone;
+  if (tzhash_find(tzid, &zone) < 0)
+  {
+    zone = pack.find(tzid);
+  }
+  return pack.load(zone, tzmap, tzid);
+}
+
+// a content line, folded at 75 octets as RFC 5545 has it if fold
+static void line(std::string &out, const std::string &l, bool fold)
+{
+  size_t at = 0, width = 75;
+  while (fold && l.size() - at > width)
+  {
+    out.append(l, at, width);
+    out += "\r\n ";
+    at += width;
+    width = 74;
+  }
+  out.append(l, at, std::string::npos);
+  out += "\r\n";
+}
+
+static std::string stamp(time_t t, bool utc)
+{
+  char buf[20];
+  strftime(buf, sizeof(buf), utc ? "%Y%m%dT%H%M%SZ" : "%Y%m%dT%H%M%S", gmtime(&t));
+  return buf;
+}
+
+// the zones' definitions, as a feed carries them
+static std::map<std::string, std::string> read_vtimezones(const char *path)
+{
+  std::map<std::string, std::string> out;
+  std::ifstream in(path);
+  std::string l, block, tzid;
+  bool inside = false;
+  while (getline(in, l))
+  {
+    if (!l.empty() && l.back() == '\r')
+      l.pop_back();
+    if (l == "BEGIN:VTIMEZONE")
+      inside = true, block.clear();
+    if (inside)
+      block += l + "\r\n";
+    if (inside && l.compare(0, 5, "TZID:") == 0)
+      tzid = l.substr(5);
+    if (l == "END:VTIMEZONE")
+      inside = false, out[tzid] = block;
+  }
+  return out;
+}
+
+static std::string make_feed(const scale_point &p, std::map<std::string, std::string> &vtimezones)
+{
+  std::mt19937 rng(p.events);
+  std::string out;
+  out.reserve(p.events * (p.fold ? 700 : 600));
+  line(out, "BEGIN:VCALENDAR", p.fold);
+  line(out, "VERSION:2.0", p.fold);
+  line(out, "PRODID:-//clockthing//feedbench//EN", p.fold);
+  for (int z = 0; z < p.zones && !p.windows; ++z)
+  {
+    out += vtimezones[zones[z]];
+  }
+  const time_t first = BENCH_NOW - BENCH_YEARS * 365 * 86400L;
+  const time_t span = BENCH_NOW + 30 * 86400L - first;
+  for (int i = 0; i < p.events; ++i)
+  {
+    // a quarter hour, mostly in the past
+    time_t start = first + (time_t)(rng() % (span / 900)) * 900;
+    int z = rng() % p.zones;
+    const char *zone = p.windows ? windows_zones[z] : zones[z];
+    bool recurs = (int)(rng() % 100) < p.recurring_percent;
+    line(out, "BEGIN:VEVENT", p.fold);
+    line(out, "UID:" + std::to_string(i) + "-feedbench@clockthing", p.fold);
+    line(out, "DTSTAMP:" + stamp(BENCH_NOW, true), p.fold);
+    line(out, std::string("DTSTART;TZID=") + zone + ":" + stamp(start, false), p.fold);
+    line(out, std::string("DTEND;TZID=") + zone + ":" + stamp(start + 1800, false), p.fold);
+    line(out, "SUMMARY:Event " + std::to_string(i), p.fold);
+    line(out, "DESCRIPTION:" + std::string(200 + rng() % 200, 'x'), p.fold);
+    if (recurs)
+    {
+      static const char *const rules[] = {
+          "FREQ=WEEKLY;BYDAY=MO,WE,FR",
+          "FREQ=DAILY;INTERVAL=2",
+          "FREQ=MONTHLY;BYMONTHDAY=15",
+          "FREQ=WEEKLY;COUNT=52",
+      };
+      line(out, std::string("RRULE:") + rules[rng() % 4], p.fold);
+      for (int x = 0; x < p.exdates; ++x)
+      {
+        line(out, std::string("EXDATE;TZID=") + zone + ":" + stamp(start + (x + 1) * 7 * 86400L, false), p.fold);
+      }
+    }
+    line(out, "BEGIN:VALARM", p.fold);
+    line(out, "ACTION:DISPLAY", p.fold);
+    line(out, "TRIGGER:-PT10M", p.fold);
+    line(out, "END:VALARM", p.fold);
+    line(out, "END:VEVENT", p.fold);
+  }
+  line(out, "END:VCALENDAR", p.fold);
+  return out;
+}
+
+// fetch_feed()'s parse step, on feed
+static bool run(const std::string &feed, result &r)
+{
+  size_t live_before = heap_live, allocs_before = heap_allocs;
+  heap_peak = heap_live;
+  auto started = std::chrono::steady_clock::now();
+  try
+  {
+    uICAL::TZMap_ptr tzmap = uICAL::new_ptr<uICAL::TZMap>();
+    zone_lookup lookup(load_zone);
+    std::istringstream feedstream(feed);
+    uICAL::istream_stl istm(feedstream);
+    event_filter filter;
+    filter_stats stats = {0, 0, 0};
+    tz_offset offsets[MAX_OFFSETS];
+    alarms.clear();
+    uICAL::Calendar_ptr cal =
+        expand_calendar(istm, tzmap, BENCH_NOW, BENCH_NOW + 86400 * EXPAND_DAYS, filter, alarms, stats, &lookup);
+    record_offsets(cal, BENCH_NOW, offsets, MAX_OFFSETS);
+    r.lookups = lookup.lookups;
+  }
+  catch (uICAL::Error ex)
+  {
+    fprintf(stderr, "%s: failed loading calendar\n", ex.message.c_str());
+    return false;
+  }
+  r.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+  r.peak = heap_peak - live_before;
+  r.allocs = heap_allocs - allocs_before;
+  r.alarms = alarms.count;
+  return true;
+}
+
+// ns per lookup of every zone name and alias, through the zone hash, by a
+// search of the pack, and by comparing against each name in turn; into ns
+// by "hash", "pack" and "scan"
+static void time_lookups(const std::map<std::string, std::string> &vtimezones, std::map<std::string, double> &ns)
+{
+  std::vector<std::string> names, keys;
+  for (auto &z : vtimezones)
+  {
+    names.push_back(z.first);
+    keys.push_back(z.first);
+  }
+  std::ifstream aliases("lib/windows_zones.txt");
+  for (std::string l; getline(aliases, l);)
+  {
+    if (!l.empty() && l[0] != '#')
+    {
+      keys.push_back(l.substr(0, l.find('\t')));
+    }
+  }
+  const int rounds = 200;
+  long found = 0;
+  auto time = [&](const std::vector<std::string> &of, std::function<int(const char *)> find) {
+    auto started = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; ++i)
+    {
+      for (const std::string &k : of)
+      {
+        found += find(k.c_str()) >= 0;
+      }
+    }
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - started).count() /
+           (rounds * of.size());
+  };
+  double hashed = time(keys, [](const char *k) { return tzhash_find(k); });
+  double searched = time(names, [](const char *k) { return pack.find(k); });
+  double scanned = time(names, [&](const char *k) {
+    for (size_t i = 0; i < names.size(); ++i)
+    {
+      if (names[i] == k)
+      {
+        return (int)i;
+      }
+    }
+    return -1;
+  });
+  ns["hash"] = hashed;
+  ns["pack"] = searched;
+  ns["scan"] = scanned;
+  printf("%ld found\n", found);
+}
+
+static int usage()
+{
+  fprintf(stderr, "usage: feedbench [--baseline FILE] [--write-baseline FILE] [--runs N] [--dump DIR] [--only lookups]\n");
+  return 2;
+}
+
+int main(int argc, char **argv)
+{
+  const char *baseline = NULL, *write_baseline = NULL, *dump = NULL;
+  const char *timezones = "src/fallback_timezones.ics";
+  const char *tzpack_path = "src/fallback_timezones.tzp";
+  int runs = 3;
+  bool points_too = true;
+  for (int i = 1; i < argc; i += 2)
+  {
+    if (i + 1 >= argc)
+      return usage();
+    else if (strcmp(argv[i], "--baseline") == 0)
+      baseline = argv[i + 1];
+    else if (strcmp(argv[i], "--write-baseline") == 0)
+      write_baseline = argv[i + 1];
+    else if (strcmp(argv[i], "--runs") == 0)
+      runs = atoi(argv[i + 1]);
+    else if (strcmp(argv[i], "--dump") == 0)
+      dump = argv[i + 1];
+    else if (strcmp(argv[i], "--only") == 0 && strcmp(argv[i + 1], "lookups") == 0)
+      points_too = false;
+    else
+      return usage();
+  }
+  if (runs < 1)
+  {
+    return usage();
+  }
+  setenv("TZ", "UTC0", 1);
+  tzset();
+
+  std::map<std::string, result> base;
+  std::map<std::string, double> base_ns; // "lookup NAME NS" lines
+  if (baseline)
+  {
+    std::ifstream in(baseline);
+    if (!in)
+    {
+      fprintf(stderr, "can't open %s\n", baseline);
+      return 2;
+    }
+    std::string l;
+    while (getline(in, l))
+    {
+      std::istringstream words(l);
+      std::string name;
+      result r;
+      double ns;
+      if (l.compare(0, 7, "lookup ") == 0)
+      {
+        words >> name >> name;
+        if (words >> ns)
+        {
+          base_ns[name] = ns;
+        }
+      }
+      else if (l[0] != '#' && words >> name >> r.ms >> r.peak >> r.allocs >> r.alarms)
+      {
+        base[name] = r;
+      }
+    }
+  }
+  FILE *out = NULL;
+  if (write_baseline && !(out = fopen(write_baseline, "w")))
+  {
+    fprintf(stderr, "can't write %s\n", write_baseline);
+    return 2;
+  }
+  if (out)
+  {
+    fprintf(out, "# feedbench: lookup name ns_each, then point ms peak_bytes allocations alarms\n");
+  }
+
+  std::map<std::string, std::string> vtimezones = read_vtimezones(timezones);
+  if (vtimezones.empty())
+  {
+    fprintf(stderr, "can't read zones from %s\n", timezones);
+    return 2;
+  }
+
+  std::ifstream packfile(tzpack_path, std::ios::binary);
+  std::vector<uint8_t> packed((std::istreambuf_iterator<char>(packfile)), std::istreambuf_iterator<char>());
+  tzpack_memory source(packed.data(), packed.size());
+  if (!pack.open(&source, packed.size()))
+  {
+    fprintf(stderr, "can't open the zones in %s\n", tzpack_path);
+    return 2;
+  }
+  if (!tzhash_numbers_match(pack.header.release, pack.header.num_zones))
+  {
+    fprintf(stderr, "src/tzhash_table.h is out of date, run lib/gen_tzhash.py\n");
+    return 2;
+  }
+  int regressed = 0;
+  std::map<std::string, double> ns;
+  time_lookups(vtimezones, ns);
+  printf("%-11s %10s\n", "lookup", "ns each");
+  for (const char *name : {"hash", "pack", "scan"})
+  {
+    printf("%-11s %10.1f", name, ns[name]);
+    auto was = base_ns.find(name);
+    if (was != base_ns.end())
+    {
+      bool worse = ns[name] > was->second * 1.5;
+      printf("  %s (%+.0f%%)", worse ? "REGRESSED" : "ok", 100.0 * (ns[name] - was->second) / was->second);
+      regressed += worse;
+    }
+    printf("\n");
+    if (out)
+    {
+      fprintf(out, "lookup %s %.1f\n", name, ns[name]);
+    }
+  }
+  printf("\n");
+  if (!points_too)
+  {
+    if (out)
+    {
+      fclose(out);
+    }
+    return regressed ? 1 : 0;
+  }
+
+  printf("%-11s %6s %4s %4s %5s %9s %9s %10s %10s %7s %7s\n", "point", "events", "rec%", "exd", "zones", "feed KB",
+         "ms", "peak KB", "allocs", "alarms", "lookups");
+
+  for (const scale_point &p : points)
+  {
+    std::string feed = make_feed(p, vtimezones);
+    if (dump)
+    {
+      std::ofstream(std::string(dump) + "/" + p.name + ".ics", std::ios::binary) << feed;
+    }
+    result best = {0, 0, 0, 0, 0};
+    for (int i = 0; i < runs; ++i)
+    {
+      result r;
+      if (!run(feed, r))
+      {
+        return 1;
+      }
+      best = i == 0 || r.ms < best.ms ? r : best;
+    }
+    printf("%-11s %6d %4d %4d %5d %9zu %9.1f %10zu %10zu %7zu %7zu", p.name, p.events, p.recurring_percent,
+           p.exdates, p.zones, feed.size() / 1024, best.ms, best.peak / 1024, best.allocs, best.alarms, best.lookups);
+    auto was = base.find(p.name);
+    if (was != base.end())
+    {
+      const result &b = was->second;
+      bool worse = best.peak > b.peak * 1.1 || best.allocs > b.allocs * 1.1 || best.ms > b.ms * 1.5;
+      printf("  %s (%+.0f%% ms, %+.0f%% peak, %+.0f%% allocs)", worse ? "REGRESSED" : "ok",
+             100.0 * (best.ms - b.ms) / b.ms, 100.0 * ((double)best.peak - b.peak) / b.peak,
+             100.0 * ((double)best.allocs - b.allocs) / b.allocs);
+      regressed += worse;
+    }
+    printf("\n");
+    if (out)
+    {
+      fprintf(out, "%s %.1f %zu %zu %zu\n", p.name, best.ms, best.peak, best.allocs, best.alarms);
+    }
+  }
+  if (out)
+  {
+    fclose(out);
+  }
+  return regressed ? 1 : 0;
+}
@@ -0,0 +1,155 @@
+// Compiles an ics feed into a pre-expanded alarm bundle (see src/bundle.h),
+// with the same expansion code the clock runs in fetch(), zones and all:
+// each is loaded from a timezone pack (src/tzpack.h) the first time the
+// feed names it.
+//
+//   feedc [--now UNIX] [--days N] [--filter RULES] [--timezones FILE.tzp] feed.ics out.ctab
+//
+// Serve the output with Content-Type application/vnd.clockthing.alarms from
+// a feed url, and regenerate it more often than the clock fetches.
+#include <Arduino.h>
+#include <fstream>
+#include <vector>
+#include <uICal.h>
+#include "bundle.h"
+#include "expand.h"
+#include "tzhash.h"
+#include "tzpack.h"
+
+static alarm_collector alarms;
+static tzpack pack;
+
+// tzdb_load_zone() (src/tzdb.cpp) on the pack given
+static bool load_zone(const char *tzid, uICAL::TZMap_ptr &tzmap)
+{
+  int zone;
+  if (tzhash_find(tzid, &zone) < 0)
+  {
+    zone = pack.find(tzid);
+  }
+  return pack.load(zone, tzmap, tzid);
+}
+
+static int usage()
+{
+  fprintf(stderr, "usage: feedc [--now UNIX] [--days N] [--filter RULES] [--timezones FILE.tzp] feed.ics out.ctab\n");
+  return 2;
+}
+
+int main(int argc, char **argv)
+{
+  time_t now = time(NULL);
+  int days = EXPAND_DAYS;
+  const char *rules = "";
+  const char *timezones = "src/fallback_timezones.tzp";
+  int i = 1;
+  for (; i + 1 < argc && strncmp(argv[i], "--", 2) == 0; i += 2)
+  {
+    if (strcmp(argv[i], "--now") == 0)
+      now = atoll(argv[i + 1]);
+    else if (strcmp(argv[i], "--days") == 0)
+      days = atoi(argv[i + 1]);
+    else if (strcmp(argv[i], "--filter") == 0)
+      rules = argv[i + 1];
+    else if (strcmp(argv[i], "--timezones") == 0)
+      timezones = argv[i + 1];
+    else
+      return usage();
+  }
+  if (argc - i != 2)
+  {
+    return usage();
+  }
+
+  event_filter filter;
+  if (!filter.parse(rules))
+  {
+    fprintf(stderr, "ignoring part of filter %s\n", rules);
+  }
+
+  std::ifstream packfile(timezones, std::ios::binary);
+  std::vector<uint8_t> packed((std::istreambuf_iterator<char>(packfile)), std::istreambuf_iterator<char>());
+  tzpack_memory source(packed.data(), packed.size());
+  if (!pack.open(&source, packed.size()))
+  {
+    fprintf(stderr, "can't open the zones in %s\n", timezones);
+    return 1;
+  }
+  if (!tzhash_numbers_match(pack.header.release, pack.header.num_zones))
+  {
+    fprintf(stderr, "src/tzhash_table.h is out of date, run lib/gen_tzhash.py\n");
+    return 1;
+  }
+
+  tz_offset offsets[BUNDLE_MAX_OFFSETS];
+  size_t num_offsets;
+  filter_stats stats = {0, 0, 0};
+  alarms.clear();
+  try
+  {
+    uICAL::TZMap_ptr tzmap = uICAL::new_ptr<uICAL::TZMap>();
+    zone_lookup zones(load_zone);
+    std::ifstream feedfile(argv[i]);
+    if (!feedfile)
+    {
+      fprintf(stderr, "can't open %s\n", argv[i]);
+      return 1;
+    }
+    uICAL::istream_stl feed(feedfile);
+    uICAL::Calendar_ptr cal = expand_calendar(feed, tzmap, now, now + 86400 * days, filter, alarms, stats, &zones);
+    num_offsets = record_offsets(cal, now, offsets, BUNDLE_MAX_OFFSETS);
+  }
+  catch (uICAL::Error ex)
+  {
+    fprintf(stderr, "%s: failed loading calendar\n", ex.message.c_str());
+    return 1;
+  }
+
+  static bundle_offset out_offsets[BUNDLE_MAX_OFFSETS];
+  static bundle_alarm out_alarms[MAX_ALARMS];
+  memset(out_offsets, 0, sizeof(out_offsets));
+  memset(out_alarms, 0, sizeof(out_alarms));
+  for (size_t j = 0; j < num_offsets; ++j)
+  {
+    out_offsets[j].start = offsets[j].start;
+    out_offsets[j].offset = (int32_t)offsets[j].offset;
+    memcpy(out_offsets[j].name, offsets[j].buffer, sizeof(out_offsets[j].name));
+  }
+  for (size_t j = 0; j < alarms.count; ++j)
+  {
+    out_alarms[j].start = alarms.alarms[j].start;
+    memcpy(out_alarms[j].name, alarms.alarms[j].name, sizeof(out_alarms[j].name));
+  }
+
+  bundle_header h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, BUNDLE_MAGIC, sizeof(h.magic));
+  h.version = BUNDLE_VERSION;
+  h.header_size = sizeof(h);
+  h.window_start = now;
+  h.window_end = now + 86400 * days;
+  h.num_offsets = num_offsets;
+  h.num_alarms = alarms.count;
+  h.crc = bundle_crc32(0, out_offsets, num_offsets * sizeof(out_offsets[0]));
+  h.crc = bundle_crc32(h.crc, out_alarms, alarms.count * sizeof(out_alarms[0]));
+
+  FILE *out = fopen(argv[i + 1], "wb");
+  if (!out)
+  {
+    fprintf(stderr, "can't write %s\n", argv[i + 1]);
+    return 1;
+  }
+  fwrite(&h, sizeof(h), 1, out);
+  fwrite(out_offsets, sizeof(out_offsets[0]), num_offsets, out);
+  fwrite(out_alarms, sizeof(out_alarms[0]), alarms.count, out);
+  fclose(out);
+
+  fprintf(stderr, "events seen %u kept %u dropped %u; %zu offsets, %zu alarms, %zu bytes\n",
+          stats.seen, stats.kept, stats.dropped, num_offsets, alarms.count,
+          sizeof(h) + num_offsets * sizeof(bundle_offset) + alarms.count * sizeof(bundle_alarm));
+  if (alarms.count == MAX_ALARMS)
+  {
+    fprintf(stderr, "alarm store full, the last alarm is before the end of the window\n");
+  }
+  return 0;
+}
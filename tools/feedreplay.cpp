@@ -0,0 +1,364 @@
+// Fetches recordings from lib/feed_standin.py under each network profile
+// and times how long until the alarms are ready, going through the parse
+// fetch_feed() does (src/feeds.cpp) as the body streams in.
+//
+//   feedreplay [--host H] [--port P] [--profiles lan,wifi,...] [--runs N] [--http11] name...
+//
+// Each run is a full fetch, then a conditional one with the ETag and
+// Last-Modified it got, as the next fetch on the clock would be. Requests
+// are HTTP/1.0 like the clock's unless --http11, which takes chunked
+// bodies. Redirects aren't followed, as on the clock. Plain http only; the
+// stand-in's https is for the watch.
+#include <Arduino.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <chrono>
+#include <fstream>
+#include <istream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <uICal.h>
+#include "bundle.h"
+#include "expand.h"
+
+typedef std::chrono::steady_clock replay_clock;
+
+static alarm_collector alarms;
+
+// a socket as a std::streambuf, taking chunked bodies apart if asked
+class socket_buf : public std::streambuf
+{
+public:
+  socket_buf(int fd) : fd(fd)
+  {
+    setg(buf, buf, buf);
+  }
+
+  bool chunked = false;
+  size_t received = 0;
+  replay_clock::time_point first_byte;
+
+  // a status or header line, read before the body so none of it is
+  // buffered yet when chunked is set
+  bool header_line(std::string &line)
+  {
+    return raw_line(line);
+  }
+
+protected:
+  int underflow()
+  {
+    if (gptr() < egptr())
+    {
+      return traits_type::to_int_type(*gptr());
+    }
+    size_t want = sizeof(buf);
+    if (chunked)
+    {
+      if (chunk_left == 0 && !next_chunk())
+      {
+        return traits_type::eof();
+      }
+      want = chunk_left < want ? chunk_left : want;
+    }
+    ssize_t n = raw_read(buf, want);
+    if (n <= 0)
+    {
+      return traits_type::eof();
+    }
+    if (chunked)
+    {
+      chunk_left -= n;
+    }
+    setg(buf, buf, buf + n);
+    return traits_type::to_int_type(*gptr());
+  }
+
+private:
+  int fd;
+  char buf[1460];
+  char raw[1460];
+  size_t raw_at = 0, raw_end = 0;
+  size_t chunk_left = 0;
+  bool chunk_started = false, chunks_done = false;
+
+  ssize_t raw_read(char *out, size_t len)
+  {
+    if (raw_at == raw_end)
+    {
+      ssize_t n = recv(fd, raw, sizeof(raw), 0);
+      if (n <= 0)
+      {
+        return n;
+      }
+      if (received == 0)
+      {
+        first_byte = replay_clock::now();
+      }
+      received += n;
+      raw_at = 0;
+      raw_end = n;
+    }
+    size_t n = raw_end - raw_at < len ? raw_end - raw_at : len;
+    memcpy(out, raw + raw_at, n);
+    raw_at += n;
+    return n;
+  }
+
+  bool raw_line(std::string &line)
+  {
+    line.clear();
+    char c;
+    while (raw_read(&c, 1) == 1)
+    {
+      if (c == '\n')
+      {
+        if (!line.empty() && line.back() == '\r')
+        {
+          line.pop_back();
+        }
+        return true;
+      }
+      line += c;
+    }
+    return false;
+  }
+
+  // reads the next chunk's size line; false at the last chunk
+  bool next_chunk()
+  {
+    std::string line;
+    if (chunks_done || (chunk_started && !raw_line(line)) || !raw_line(line))
+    {
+      return false;
+    }
+    chunk_started = true;
+    chunk_left = strtoul(line.c_str(), NULL, 16);
+    chunks_done = chunk_left == 0;
+    return !chunks_done;
+  }
+};
+
+struct replay_result
+{
+  int status = -1;
+  std::string etag, last_modified, location;
+  size_t bytes = 0;
+  size_t alarms = 0;
+  size_t offsets = 0;
+  double connect_ms = 0, first_byte_ms = 0, published_ms = 0;
+  const char *outcome = "";
+};
+
+static double ms_since(replay_clock::time_point start, replay_clock::time_point t)
+{
+  return std::chrono::duration<double, std::milli>(t - start).count();
+}
+
+static int connect_to(const char *host, int port)
+{
+  addrinfo hints, *res;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_socktype = SOCK_STREAM;
+  if (getaddrinfo(host, std::to_string(port).c_str(), &hints, &res) != 0)
+  {
+    return -1;
+  }
+  int fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+  if (fd >= 0 && connect(fd, res->ai_addr, res->ai_addrlen) != 0)
+  {
+    close(fd);
+    fd = -1;
+  }
+  freeaddrinfo(res);
+  return fd;
+}
+
+// the bundle half of fetch_feed(): header, payload, crc
+static bool read_bundle(std::istream &in, replay_result &r)
+{
+  bundle_header h;
+  static bundle_offset offsets[BUNDLE_MAX_OFFSETS];
+  static bundle_alarm bundle_alarms[BUNDLE_MAX_ALARMS];
+  if (!in.read((char *)&h, sizeof(h)) || !bundle_header_valid(h) ||
+      !in.read((char *)offsets, h.num_offsets * sizeof(offsets[0])) ||
+      !in.read((char *)bundle_alarms, h.num_alarms * sizeof(bundle_alarms[0])))
+  {
+    return false;
+  }
+  uint32_t crc = bundle_crc32(0, offsets, h.num_offsets * sizeof(offsets[0]));
+  r.alarms = h.num_alarms;
+  r.offsets = h.num_offsets;
+  return bundle_crc32(crc, bundle_alarms, h.num_alarms * sizeof(bundle_alarms[0])) == h.crc;
+}
+
+static replay_result fetch(const char *host, int port, const std::string &path, bool http11,
+                           const replay_result *previous, time_t now)
+{
+  replay_result r;
+  auto started = replay_clock::now();
+  int fd = connect_to(host, port);
+  r.connect_ms = ms_since(started, replay_clock::now());
+  if (fd < 0)
+  {
+    r.outcome = "connect failed";
+    return r;
+  }
+  std::string request = "GET " + path + (http11 ? " HTTP/1.1\r\n" : " HTTP/1.0\r\n") + "Host: " + host +
+                        "\r\nUser-Agent: ESP32HTTPClient\r\nConnection: close\r\n";
+  if (previous && !previous->etag.empty())
+  {
+    request += "If-None-Match: " + previous->etag + "\r\n";
+  }
+  if (previous && !previous->last_modified.empty())
+  {
+    request += "If-Modified-Since: " + previous->last_modified + "\r\n";
+  }
+  request += "\r\n";
+  send(fd, request.data(), request.size(), 0);
+
+  socket_buf sb(fd);
+  std::istream in(&sb);
+  std::string line, content_type;
+  if (sb.header_line(line) && line.size() > 9)
+  {
+    r.status = atoi(line.c_str() + 9);
+  }
+  while (sb.header_line(line) && !line.empty())
+  {
+    size_t colon = line.find(':');
+    std::string key = line.substr(0, colon), value = colon == std::string::npos ? "" : line.substr(colon + 1);
+    value.erase(0, value.find_first_not_of(' '));
+    if (strcasecmp(key.c_str(), "ETag") == 0)
+      r.etag = value;
+    else if (strcasecmp(key.c_str(), "Last-Modified") == 0)
+      r.last_modified = value;
+    else if (strcasecmp(key.c_str(), "Content-Type") == 0)
+      content_type = value;
+    else if (strcasecmp(key.c_str(), "Location") == 0)
+      r.location = value;
+    else if (strcasecmp(key.c_str(), "Transfer-Encoding") == 0)
+      sb.chunked = value == "chunked";
+  }
+  r.first_byte_ms = ms_since(started, sb.first_byte);
+
+  if (r.status == 304)
+  {
+    r.outcome = "unchanged";
+  }
+  else if (r.status <= 0)
+  {
+    r.outcome = "no response";
+  }
+  else if (r.status >= 300)
+  {
+    r.outcome = r.status < 400 ? "redirect, not followed" : "http error";
+  }
+  else if (content_type.compare(0, strlen(BUNDLE_CONTENT_TYPE), BUNDLE_CONTENT_TYPE) == 0)
+  {
+    r.outcome = read_bundle(in, r) ? "bundle" : "bad bundle";
+  }
+  else
+  {
+    try
+    {
+      uICAL::TZMap_ptr tzmap = uICAL::new_ptr<uICAL::TZMap>();
+      std::ifstream tzfile("src/fallback_timezones.ics");
+      uICAL::istream_stl tzstream(tzfile);
+      uICAL::Calendar::load(tzstream, tzmap);
+
+      uICAL::istream_stl istm(in);
+      event_filter filter;
+      filter_stats stats = {0, 0, 0};
+      tz_offset offsets[MAX_OFFSETS];
+      alarms.clear();
+      uICAL::Calendar_ptr cal = expand_calendar(istm, tzmap, now, now + 86400 * EXPAND_DAYS, filter, alarms, stats);
+      r.offsets = record_offsets(cal, now, offsets, MAX_OFFSETS);
+      r.alarms = alarms.count;
+      r.outcome = "parsed";
+    }
+    catch (uICAL::Error ex)
+    {
+      r.outcome = "parse error";
+    }
+  }
+  // drain what's left, so bytes counts the whole response
+  while (in.get() != EOF)
+    ;
+  r.bytes = sb.received;
+  r.published_ms = ms_since(started, replay_clock::now());
+  close(fd);
+  return r;
+}
+
+static int usage()
+{
+  fprintf(stderr, "usage: feedreplay [--host H] [--port P] [--profiles lan,wifi,...] [--runs N] [--http11] name...\n");
+  return 2;
+}
+
+int main(int argc, char **argv)
+{
+  const char *host = "127.0.0.1";
+  int port = 8090, runs = 1;
+  bool http11 = false;
+  std::string profiles = "lan,wifi,dsl,mobile,drip,stall";
+  int i = 1;
+  for (; i < argc && strncmp(argv[i], "--", 2) == 0; ++i)
+  {
+    if (strcmp(argv[i], "--http11") == 0)
+      http11 = true;
+    else if (i + 1 >= argc)
+      return usage();
+    else if (strcmp(argv[i], "--host") == 0)
+      host = argv[++i];
+    else if (strcmp(argv[i], "--port") == 0)
+      port = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--profiles") == 0)
+      profiles = argv[++i];
+    else if (strcmp(argv[i], "--runs") == 0)
+      runs = atoi(argv[++i]);
+    else
+      return usage();
+  }
+  if (i == argc || runs < 1)
+  {
+    return usage();
+  }
+  setenv("TZ", "UTC0", 1);
+  tzset();
+  time_t now = time(NULL);
+
+  printf("%-8s %-16s %-5s %4s %9s %9s %9s %11s %7s  %s\n", "profile", "feed", "fetch", "code", "bytes", "conn ms",
+         "ttfb ms", "alarms ms", "alarms", "outcome");
+  int failed = 0;
+  std::istringstream list(profiles);
+  for (std::string profile; getline(list, profile, ',');)
+  {
+    for (int n = i; n < argc; ++n)
+    {
+      std::string path = "/" + profile + "/" + argv[n];
+      for (int run = 0; run < runs; ++run)
+      {
+        replay_result full = fetch(host, port, path, http11, NULL, now);
+        replay_result again = fetch(host, port, path, http11, &full, now);
+        for (const replay_result *r : {&full, &again})
+        {
+          printf("%-8s %-16s %-5s %4d %9zu %9.1f %9.1f %11.1f %7zu  %s", profile.c_str(), argv[n],
+                 r == &full ? "full" : "cond", r->status, r->bytes, r->connect_ms, r->first_byte_ms, r->published_ms,
+                 r->alarms, r->outcome);
+          if (!r->location.empty())
+          {
+            printf(" to %s", r->location.c_str());
+          }
+          printf("\n");
+        }
+        failed += full.status <= 0;
+      }
+    }
+  }
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+// Just enough of the Arduino core for the feed code in src/ to build on the
+// host, for the tools in tools/. uICAL builds in its std:: mode.
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+struct HostSerial
+{
+  template <typename... Args>
+  void printf(const char *fmt, Args... args)
+  {
+    fprintf(stderr, fmt, args...);
+  }
+  void println(const char *s)
+  {
+    fprintf(stderr, "%s\n", s);
+  }
+};
+
+inline HostSerial Serial;
+
+#if defined(__GLIBC__) && !__GLIBC_PREREQ(2, 38)
+// newlib has these; glibc only lately
+static inline size_t strlcpy(char *dst, const char *src, size_t size)
+{
+  size_t len = strlen(src);
+  if (size)
+  {
+    size_t n = len < size - 1 ? len : size - 1;
+    memcpy(dst, src, n);
+    dst[n] = 0;
+  }
+  return len;
+}
+
+static inline size_t strlcat(char *dst, const char *src, size_t size)
+{
+  size_t used = strnlen(dst, size);
+  return used == size ? size + strlen(src) : used + strlcpy(dst + used, src, size - used);
+}
+#endif
+
+static inline void vTaskDelay(uint32_t)
+{
+}
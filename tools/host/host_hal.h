@@ -0,0 +1,182 @@
+#pragma once
+
+// Linux stand-ins for src/hal.h, for running the clock logic off the watch.
+#include <chrono>
+#include <string>
+#include <thread>
+#include "clock.h"
+#include "hal.h"
+
+struct host_clock : hal_clock
+{
+  std::chrono::steady_clock::time_point booted = std::chrono::steady_clock::now();
+
+  int64_t mono_us()
+  {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - booted).count();
+  }
+  void sleep_ms(uint32_t ms)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+  }
+};
+
+// the system clock, plus whatever was last written
+struct host_rtc : hal_rtc
+{
+  time_t offset = 0;
+
+  bool present()
+  {
+    return true;
+  }
+  void read(struct tm &t)
+  {
+    time_t now = time(NULL) + offset;
+    gmtime_r(&now, &t);
+  }
+  void write(const struct tm &t)
+  {
+    struct tm copy = t;
+    offset = timegm(&copy) - time(NULL);
+  }
+};
+
+static const char *const face_label_names[NUM_FACE_LABELS] = {"time", "tz", "am", "pm", "date", "alarm", "warning"};
+
+// Prints the labels that changed at each refresh, with LVGL's symbols
+// spelled out.
+struct host_display : hal_display
+{
+  std::string text[NUM_FACE_LABELS];
+  bool changed[NUM_FACE_LABELS] = {};
+  face_color color = FACE_WHITE;
+  uint8_t backlight = 255;
+  bool quiet = false;
+  uint32_t refreshes = 0, label_changes = 0;
+
+  static std::string readable(const std::string &s)
+  {
+    static const char *const symbols[][2] = {
+        {FACE_SYMBOL_SETTINGS, "[settings]"}, {FACE_SYMBOL_DOWNLOAD, "[download]"}, {FACE_SYMBOL_REFRESH, "[refresh]"},
+        {FACE_SYMBOL_PAUSE, "[pause]"}, {FACE_SYMBOL_EYE_OPEN, "[eye]"}, {FACE_SYMBOL_WARNING, "[warning]"},
+        {FACE_SYMBOL_BELL, "[bell]"}, {FACE_SYMBOL_WIFI, "[wifi]"},
+    };
+    std::string out = s;
+    for (auto &sym : symbols)
+    {
+      for (size_t at; (at = out.find(sym[0])) != std::string::npos;)
+      {
+        out.replace(at, strlen(sym[0]), sym[1]);
+      }
+    }
+    return out;
+  }
+
+  void set_text(face_label label, const char *t)
+  {
+    if (text[label] != t)
+    {
+      text[label] = t;
+      changed[label] = true;
+    }
+  }
+  void set_color(face_color c)
+  {
+    color = c;
+  }
+  void set_backlight(uint8_t level)
+  {
+    backlight = level;
+  }
+  void refresh()
+  {
+    refreshes++;
+    for (int i = 0; i < NUM_FACE_LABELS; ++i)
+    {
+      if (changed[i])
+      {
+        label_changes++;
+        if (!quiet)
+        {
+          printf("  %-8s %s\n", face_label_names[i], readable(text[i]).c_str());
+        }
+      }
+      changed[i] = false;
+    }
+  }
+};
+
+struct host_network : hal_network
+{
+  bool up = true;
+  bool web_portal = false, config_portal = false;
+  uint32_t interval_ms = 3600 * 1000;
+
+  bool connected()
+  {
+    return up;
+  }
+  uint32_t ntp_interval_ms()
+  {
+    return interval_ms;
+  }
+  bool web_portal_active()
+  {
+    return web_portal;
+  }
+  bool config_portal_active()
+  {
+    return config_portal;
+  }
+  void stop_web_portal()
+  {
+    web_portal = false;
+  }
+  void portal_info(bool config, char *ssid, size_t ssid_len, char *url, size_t url_len)
+  {
+    // the config portal is the soft AP's, at its default address
+    strlcpy(ssid, config ? "host-setup" : "host", ssid_len);
+    strlcpy(url, config ? "http://192.168.4.1" : "http://127.0.0.1", url_len);
+  }
+};
+
+// one file per key in a directory
+struct host_storage : hal_storage
+{
+  std::string dir = ".";
+  uint32_t loads = 0, stores = 0;
+
+  size_t load(const char *key, void *buf, size_t len)
+  {
+    loads++;
+    FILE *f = fopen((dir + "/" + key + ".bin").c_str(), "rb");
+    if (!f)
+    {
+      return 0;
+    }
+    size_t n = fread(buf, 1, len, f);
+    fclose(f);
+    return n;
+  }
+  void store(const char *key, const void *buf, size_t len)
+  {
+    stores++;
+    FILE *f = fopen((dir + "/" + key + ".bin").c_str(), "wb");
+    if (f)
+    {
+      fwrite(buf, 1, len, f);
+      fclose(f);
+    }
+  }
+};
+
+struct host_buzzer : hal_buzzer
+{
+  uint32_t tones = 0;
+
+  void tone(uint8_t duty)
+  {
+    tones += duty != 0;
+  }
+};
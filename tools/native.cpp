@@ -0,0 +1,187 @@
+// Runs the clock's logic (src/clock.cpp) on Linux against the stand-ins in
+// tools/host/host_hal.h, in real time, printing what the face shows.
+//
+//   native [--seconds N] [--storage DIR] [--offline] [bundle.ctab ...]
+//
+// Feeds come from alarm bundles made by tools/feedc, re-read whenever the
+// fetch schedule says a fetch is due. State persists in DIR/s.bin as it
+// does in NVS. --offline leaves the network down, so no fetches happen.
+#include <Arduino.h>
+#include <algorithm>
+#include <thread>
+#include "bundle.h"
+#include "clock.h"
+#include "host_hal.h"
+
+clock_state state;
+
+static host_clock hw_clock;
+static host_rtc hw_rtc;
+static host_display face;
+static host_network network;
+static host_storage storage;
+static host_buzzer buzzer;
+static clock_hal hal = {&hw_clock, &hw_rtc, &face, &network, &storage, &buzzer};
+
+// adds a bundle's alarms to state, and takes its offsets if it has any
+static bool load_bundle_file(const char *path, time_t now)
+{
+  FILE *f = fopen(path, "rb");
+  if (!f)
+  {
+    fprintf(stderr, "can't open %s\n", path);
+    return false;
+  }
+  bundle_header h;
+  static bundle_offset offsets[BUNDLE_MAX_OFFSETS];
+  static bundle_alarm alarms[BUNDLE_MAX_ALARMS];
+  bool ok = fread(&h, sizeof(h), 1, f) == 1 && bundle_header_valid(h) &&
+            fread(offsets, sizeof(offsets[0]), h.num_offsets, f) == h.num_offsets &&
+            fread(alarms, sizeof(alarms[0]), h.num_alarms, f) == h.num_alarms;
+  fclose(f);
+  if (!ok || bundle_crc32(bundle_crc32(0, offsets, h.num_offsets * sizeof(offsets[0])), alarms,
+                          h.num_alarms * sizeof(alarms[0])) != h.crc)
+  {
+    fprintf(stderr, "bad bundle %s\n", path);
+    return false;
+  }
+  for (size_t i = 0; i < h.num_alarms && state.num_alarms < MAX_ALARMS; ++i)
+  {
+    alarm_entry &a = state.alarms[state.num_alarms++];
+    a.start = alarms[i].start;
+    memcpy(a.name, alarms[i].name, sizeof(a.name));
+    a.name[sizeof(a.name) - 1] = 0;
+  }
+  if (h.num_offsets)
+  {
+    size_t first = 0;
+    while (first + 1 < h.num_offsets && offsets[first + 1].start <= now)
+    {
+      ++first;
+    }
+    state.num_offsets = 0;
+    for (size_t i = first; i < h.num_offsets && state.num_offsets < MAX_OFFSETS; ++i)
+    {
+      tz_offset &o = state.offsets[state.num_offsets++];
+      o.start = i == first ? now : offsets[i].start;
+      o.offset = offsets[i].offset;
+      memcpy(o.buffer, offsets[i].name, sizeof(o.buffer));
+      o.buffer[sizeof(o.buffer) - 1] = 0;
+    }
+  }
+  return true;
+}
+
+static void fetch(char **bundles, int num_bundles, time_t now)
+{
+  state.num_alarms = 0;
+  bool ok = num_bundles > 0;
+  for (int i = 0; i < num_bundles; ++i)
+  {
+    ok &= load_bundle_file(bundles[i], now);
+  }
+  std::sort(state.alarms, state.alarms + state.num_alarms,
+            [](const alarm_entry &a, const alarm_entry &b) { return a.start < b.start; });
+  if (ok || !num_bundles)
+  {
+    last_success = now;
+    fetch_plan.success(now, ok, rand());
+  }
+  else
+  {
+    fetch_plan.failure(now, FAIL_PARSE, 0, rand());
+  }
+  printf("fetched %zu alarms, next fetch in %ld s\n", state.num_alarms, (long)(fetch_plan.next - now));
+}
+
+static int usage()
+{
+  fprintf(stderr, "usage: native [--seconds N] [--storage DIR] [--offline] [bundle.ctab ...]\n");
+  return 2;
+}
+
+int main(int argc, char **argv)
+{
+  long seconds = 0; // forever
+  int i = 1;
+  for (; i < argc && strncmp(argv[i], "--", 2) == 0; ++i)
+  {
+    if (strcmp(argv[i], "--offline") == 0)
+      network.up = false;
+    else if (i + 1 >= argc)
+      return usage();
+    else if (strcmp(argv[i], "--seconds") == 0)
+      seconds = atol(argv[++i]);
+    else if (strcmp(argv[i], "--storage") == 0)
+      storage.dir = argv[++i];
+    else
+      return usage();
+  }
+  setenv("TZ", "UTC0", 1);
+  tzset();
+
+  if (storage.load("s", &state, sizeof(state)) != sizeof(state))
+  {
+    bzero(&state, sizeof(state));
+  }
+  time_t booted = clock_read_rtc(hw_rtc, hw_clock);
+  // the host's clock is already kept by NTP
+  last_synced = booted;
+  fetch_plan.reset();
+
+  std::thread beeper;
+  time_t lasttime = 0;
+  while (!seconds || lasttime < booted + seconds)
+  {
+    time_t now = time(NULL) + hw_rtc.offset;
+    if (now != lasttime)
+    {
+      if (network.up)
+      {
+        last_synced = now;
+      }
+      char stamp[32];
+      strftime(stamp, sizeof(stamp), "%F %T", gmtime(&now));
+      if (!face.quiet)
+      {
+        printf("%s\n", stamp);
+      }
+      int todo = clock_tick(hal, now, hw_clock.mono_us());
+      if (todo & CLOCK_SAVE)
+      {
+        printf("save data loop%s\n", clock_save(storage, state) ? " saved" : " unchanged");
+      }
+      if (todo & CLOCK_ALARM)
+      {
+        printf("alarm!\n");
+        if (beeper.joinable())
+        {
+          beeper.join();
+        }
+        beeper = std::thread([] { clock_beep(hal); });
+      }
+      if (todo & CLOCK_OTA)
+      {
+        printf("ota due\n");
+        last_ota_attempt = now;
+      }
+      if (todo & CLOCK_FETCH)
+      {
+        fetch(argv + i, argc - i, now);
+        if (clock_save(storage, state))
+        {
+          printf("save data try fetch saved\n");
+        }
+      }
+      face.refresh();
+      lasttime = now;
+    }
+    hw_clock.sleep_ms(5);
+  }
+  touched = 1;
+  if (beeper.joinable())
+  {
+    beeper.join();
+  }
+  return 0;
+}
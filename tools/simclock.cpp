@@ -0,0 +1,450 @@
+// Runs the clock's logic (src/clock.cpp) and the fetch schedule through
+// days of simulated time in a moment, following a script of feed contents,
+// fetch failures, Wi-Fi outages and button presses, then checks which
+// alarms went off against which were expected.
+//
+//   simclock [--seed S] [--verbose] script
+//
+// The script has one command per line; # starts a comment. Times are UTC,
+// as "YYYY-MM-DD HH:MM:SS". Anything but start, days and expect can be put
+// off with a leading "at <time>"; otherwise it holds from the start.
+//
+//   start <time>                 when the clock boots (default 2026-03-07 00:00:00)
+//   days <n>                     how long to run (default 7)
+//   offset <time> <secs> <name>  the feed's zone takes this offset from then
+//   alarm <time> <name>          the feed has an alarm
+//   daily <time> <n> <name>      n alarms a day apart
+//   cancel <time>                the feed drops the alarm at that time
+//   fail dns|connect|tls|parse   fetches fail like this
+//   fail http <code>
+//   ok                           fetches work again
+//   wifi down|up
+//   click                        the button is pressed
+//   expect <time>                an alarm should go off then
+//
+// Without expect lines, every alarm the feed has at its start time is
+// expected, once the first fetch could have happened. A beep stops after a
+// click or 299 s, like clock_beep(). Exits 1 if the alarms don't match.
+#include <Arduino.h>
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "clock.h"
+#include "host_hal.h"
+
+#define SIM_BEEP_SECONDS 299
+// clock_tick() leaves fetches until 30 s after boot, and then the fetch
+// task takes a moment
+#define SIM_FIRST_FETCH 60
+
+clock_state state;
+
+// in simulated time, which only moves when the loop says so
+struct sim_clock : hal_clock
+{
+  int64_t now_us = 0;
+  int64_t mono_us()
+  {
+    return now_us;
+  }
+  void sleep_ms(uint32_t ms)
+  {
+    now_us += ms * 1000LL;
+  }
+};
+
+struct sim_storage : hal_storage
+{
+  std::map<std::string, std::string> keys;
+  uint32_t stores = 0;
+
+  size_t load(const char *key, void *buf, size_t len)
+  {
+    auto it = keys.find(key);
+    if (it == keys.end())
+    {
+      return 0;
+    }
+    size_t n = std::min(len, it->second.size());
+    memcpy(buf, it->second.data(), n);
+    return n;
+  }
+  void store(const char *key, const void *buf, size_t len)
+  {
+    stores++;
+    keys[key].assign((const char *)buf, len);
+  }
+};
+
+static sim_clock hw_clock;
+static host_rtc hw_rtc;
+static host_display face;
+static host_network network;
+static sim_storage storage;
+static host_buzzer buzzer;
+static clock_hal hal = {&hw_clock, &hw_rtc, &face, &network, &storage, &buzzer};
+
+struct command
+{
+  time_t at;
+  std::string verb;
+  time_t when;
+  long number;
+  std::string name;
+};
+
+// what the feed server answers right now
+struct sim_feed
+{
+  std::vector<tz_offset> offsets;
+  std::vector<alarm_entry> alarms;
+  fetch_failure failing = FAIL_NONE;
+  int http_code = 0;
+};
+
+static bool parse_time(std::istringstream &in, time_t &t)
+{
+  std::string date, clock;
+  struct tm tm;
+  bzero(&tm, sizeof(tm));
+  if (!(in >> date >> clock) || !strptime((date + " " + clock).c_str(), "%F %T", &tm))
+  {
+    return false;
+  }
+  t = timegm(&tm);
+  return true;
+}
+
+static std::string rest(std::istringstream &in)
+{
+  std::string s;
+  getline(in >> std::ws, s);
+  return s;
+}
+
+static alarm_entry make_alarm(time_t when, const std::string &name)
+{
+  alarm_entry a;
+  bzero(&a, sizeof(a));
+  a.start = when;
+  strlcpy((char *)a.name, name.c_str(), sizeof(a.name));
+  return a;
+}
+
+static void apply(const command &c, sim_feed &feed)
+{
+  if (c.verb == "offset")
+  {
+    tz_offset o;
+    bzero(&o, sizeof(o));
+    o.start = c.when;
+    o.offset = c.number;
+    strlcpy((char *)o.buffer, c.name.c_str(), sizeof(o.buffer));
+    feed.offsets.push_back(o);
+    std::sort(feed.offsets.begin(), feed.offsets.end(),
+              [](const tz_offset &a, const tz_offset &b) { return a.start < b.start; });
+  }
+  else if (c.verb == "alarm" || c.verb == "daily")
+  {
+    for (long i = 0; i < (c.verb == "daily" ? c.number : 1); ++i)
+    {
+      feed.alarms.push_back(make_alarm(c.when + i * 86400, c.name));
+    }
+    std::sort(feed.alarms.begin(), feed.alarms.end(),
+              [](const alarm_entry &a, const alarm_entry &b) { return a.start < b.start; });
+  }
+  else if (c.verb == "cancel")
+  {
+    feed.alarms.erase(std::remove_if(feed.alarms.begin(), feed.alarms.end(),
+                                     [&](const alarm_entry &a) { return a.start == c.when; }),
+                      feed.alarms.end());
+  }
+  else if (c.verb == "fail")
+  {
+    feed.failing = (fetch_failure)c.number;
+    feed.http_code = atoi(c.name.c_str());
+  }
+  else if (c.verb == "ok")
+  {
+    feed.failing = FAIL_NONE;
+  }
+  else if (c.verb == "wifi")
+  {
+    network.up = c.name == "up";
+  }
+  else if (c.verb == "click")
+  {
+    if (clock_click(c.at) & CLOCK_SAVE)
+    {
+      clock_save(storage, state);
+    }
+  }
+}
+
+// like the fetch task after a fetch: offsets from the feed, from the one
+// in effect now, and alarms from this minute on
+static bool fetch(const sim_feed &feed, time_t now, std::mt19937 &rng)
+{
+  if (feed.failing != FAIL_NONE)
+  {
+    fetch_plan.failure(now, feed.failing, feed.http_code, rng());
+    return false;
+  }
+  clock_state before = state;
+  size_t first = 0;
+  while (first + 1 < feed.offsets.size() && feed.offsets[first + 1].start <= now)
+  {
+    ++first;
+  }
+  state.num_offsets = 0;
+  for (size_t i = first; i < feed.offsets.size() && state.num_offsets < MAX_OFFSETS; ++i)
+  {
+    state.offsets[state.num_offsets] = feed.offsets[i];
+    if (i == first)
+    {
+      state.offsets[state.num_offsets].start = now;
+    }
+    state.num_offsets++;
+  }
+  state.num_alarms = 0;
+  for (const alarm_entry &a : feed.alarms)
+  {
+    if (a.start >= now - (now % 60) && state.num_alarms < MAX_ALARMS)
+    {
+      state.alarms[state.num_alarms++] = a;
+    }
+  }
+  bool changed = before.num_alarms != state.num_alarms ||
+                 memcmp(before.alarms, state.alarms, state.num_alarms * sizeof(state.alarms[0])) != 0;
+  fetch_plan.success(now, changed, rng());
+  last_success = now;
+  clock_save(storage, state);
+  return true;
+}
+
+static int usage()
+{
+  fprintf(stderr, "usage: simclock [--seed S] [--verbose] script\n");
+  return 2;
+}
+
+int main(int argc, char **argv)
+{
+  unsigned seed = 1;
+  const char *script = NULL;
+  bool verbose = false;
+  for (int i = 1; i < argc; ++i)
+  {
+    if (strcmp(argv[i], "--verbose") == 0)
+      verbose = true;
+    else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+      seed = atoi(argv[++i]);
+    else if (argv[i][0] != '-' && !script)
+      script = argv[i];
+    else
+      return usage();
+  }
+  if (!script)
+  {
+    return usage();
+  }
+  setenv("TZ", "UTC0", 1);
+  tzset();
+
+  static const char *const failures[] = {"", "dns", "connect", "tls", "http", "parse"};
+  time_t start = 1772841600; // 2026-03-07
+  long days = 7;
+  std::vector<command> commands;
+  std::vector<time_t> expected;
+  bool expect_given = false;
+  std::ifstream in(script);
+  if (!in)
+  {
+    fprintf(stderr, "can't open %s\n", script);
+    return 2;
+  }
+  std::string line;
+  for (int n = 1; getline(in, line); ++n)
+  {
+    line = line.substr(0, line.find('#'));
+    std::istringstream words(line);
+    command c = {0, "", 0, 0, ""};
+    if (!(words >> c.verb))
+    {
+      continue;
+    }
+    bool ok = true;
+    if (c.verb == "at")
+    {
+      ok = parse_time(words, c.at) && (words >> c.verb);
+    }
+    if (!ok)
+      ;
+    else if (c.verb == "start")
+      ok = parse_time(words, start);
+    else if (c.verb == "days")
+      ok = !!(words >> days);
+    else if (c.verb == "expect")
+    {
+      ok = parse_time(words, c.when);
+      expected.push_back(c.when);
+      expect_given = true;
+      continue;
+    }
+    else if (c.verb == "offset")
+      ok = parse_time(words, c.when) && (words >> c.number) && (words >> c.name);
+    else if (c.verb == "alarm")
+      ok = parse_time(words, c.when) && !(c.name = rest(words)).empty();
+    else if (c.verb == "daily")
+      ok = parse_time(words, c.when) && (words >> c.number) && !(c.name = rest(words)).empty();
+    else if (c.verb == "cancel")
+      ok = parse_time(words, c.when);
+    else if (c.verb == "fail")
+    {
+      std::string why;
+      ok = !!(words >> why);
+      for (c.number = 1; c.number < 6 && why != failures[c.number]; ++c.number)
+        ;
+      ok = ok && c.number < 6 && (c.number != FAIL_HTTP || (words >> c.name));
+    }
+    else if (c.verb == "wifi")
+      ok = (words >> c.name) && (c.name == "up" || c.name == "down");
+    else if (c.verb != "ok" && c.verb != "click")
+      ok = false;
+    if (!ok)
+    {
+      fprintf(stderr, "%s:%d: can't read \"%s\"\n", script, n, line.c_str());
+      return 2;
+    }
+    if (c.verb != "start" && c.verb != "days")
+    {
+      commands.push_back(c);
+    }
+  }
+  for (command &c : commands)
+  {
+    c.at = c.at ? c.at : start;
+  }
+  std::stable_sort(commands.begin(), commands.end(), [](const command &a, const command &b) { return a.at < b.at; });
+
+  std::mt19937 rng(seed);
+  sim_feed feed;
+  face.quiet = !verbose;
+  bzero(&state, sizeof(state));
+  last_synced = start;
+  fetch_plan.reset();
+
+  struct fired_alarm
+  {
+    time_t at;
+    std::string name;
+  };
+  std::vector<fired_alarm> fired;
+  time_t end = start + days * 86400, beep_until = 0;
+  size_t next_command = 0;
+  uint32_t fetches = 0, fetch_failures = 0, otas = 0;
+  timespec cpu_started;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu_started);
+  double worst_day_ms = 0, day_started_ms = 0;
+  for (time_t now = start; now < end; ++now)
+  {
+    hw_clock.now_us = (now - start) * 1000000LL;
+    for (; next_command < commands.size() && commands[next_command].at <= now; ++next_command)
+    {
+      if (verbose)
+      {
+        printf("%ld %s %s\n", (long)now, commands[next_command].verb.c_str(), commands[next_command].name.c_str());
+      }
+      apply(commands[next_command], feed);
+    }
+    if (!expect_given && now % 60 == 0 && now >= start + SIM_FIRST_FETCH &&
+        std::any_of(feed.alarms.begin(), feed.alarms.end(), [&](const alarm_entry &a) { return a.start == now; }))
+    {
+      expected.push_back(now);
+    }
+    if (beeping && (touched || now >= beep_until))
+    {
+      beeping = 0;
+    }
+    if (network.up)
+    {
+      last_synced = now;
+    }
+
+    int todo = clock_tick(hal, now, hw_clock.now_us);
+    if (todo & CLOCK_SAVE)
+    {
+      clock_save(storage, state);
+    }
+    if (todo & CLOCK_ALARM)
+    {
+      fired.push_back({now, (const char *)state.alarms[0].name});
+      for (size_t al = 0; al < state.num_alarms; ++al)
+      {
+        if (state.alarms[al].start == now)
+        {
+          fired.back().name = (const char *)state.alarms[al].name;
+        }
+      }
+      touched = 0;
+      beep_until = now + SIM_BEEP_SECONDS;
+      if (verbose)
+      {
+        printf("%ld alarm %s\n", (long)now, fired.back().name.c_str());
+      }
+    }
+    if (todo & CLOCK_OTA)
+    {
+      otas++;
+      last_ota_attempt = now;
+    }
+    if (todo & CLOCK_FETCH)
+    {
+      fetches++;
+      fetch_failures += !fetch(feed, now, rng);
+    }
+    face.refresh();
+
+    if ((now - start) % 86400 == 86399)
+    {
+      timespec t;
+      clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t);
+      double ms = (t.tv_sec - cpu_started.tv_sec) * 1e3 + (t.tv_nsec - cpu_started.tv_nsec) / 1e6;
+      worst_day_ms = std::max(worst_day_ms, ms - day_started_ms);
+      day_started_ms = ms;
+    }
+  }
+
+  timespec cpu_ended;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu_ended);
+  double cpu_ms = (cpu_ended.tv_sec - cpu_started.tv_sec) * 1e3 + (cpu_ended.tv_nsec - cpu_started.tv_nsec) / 1e6;
+
+  std::sort(expected.begin(), expected.end());
+  expected.erase(std::unique(expected.begin(), expected.end()), expected.end());
+  int missed = 0, unexpected = 0;
+  size_t e = 0, f = 0;
+  printf("alarms:\n");
+  while (e < expected.size() || f < fired.size())
+  {
+    time_t t = f == fired.size() || (e < expected.size() && expected[e] < fired[f].at) ? expected[e] : fired[f].at;
+    bool was_expected = e < expected.size() && expected[e] == t;
+    bool went_off = f < fired.size() && fired[f].at == t;
+    char stamp[32];
+    strftime(stamp, sizeof(stamp), "%F %T", gmtime(&t));
+    printf("  %s %-10s %s\n", stamp, went_off ? (was_expected ? "fired" : "UNEXPECTED") : "MISSED",
+           went_off ? fired[f].name.c_str() : "");
+    missed += !went_off;
+    unexpected += went_off && !was_expected;
+    e += was_expected;
+    f += went_off;
+  }
+  printf("%zu fired, %zu expected, %d missed, %d unexpected\n", fired.size(), expected.size(), missed, unexpected);
+  printf("%ld days: %u fetches (%u failed), %u ota checks, %u saves, %u label changes\n", days, fetches,
+         fetch_failures, otas, storage.stores, face.label_changes);
+  printf("cpu: %.1f ms, %.2f ms per virtual day, worst day %.2f ms\n", cpu_ms, cpu_ms / days, worst_day_ms);
+  return missed || unexpected ? 1 : 0;
+}